@@ -0,0 +1,516 @@
+#include "trace_analyzer.h"
+#include "trace_reader.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <getopt.h>
+#include <iomanip>
+
+// the trace reader is shared with the simulator, only the record format knob is needed
+uint8_t knob_cloudsuite = 0;
+
+void ANALYZER_MIX::add(const ANALYZER_MIX &other)
+{
+    instructions += other.instructions;
+    branches += other.branches;
+    taken += other.taken;
+    loads += other.loads;
+    stores += other.stores;
+    load_ops += other.load_ops;
+    store_ops += other.store_ops;
+    memory_instructions += other.memory_instructions;
+    others += other.others;
+}
+
+void REUSE_TREE::reset(uint64_t size)
+{
+    count.assign(size + 1, 0);
+    marks = 0;
+}
+
+void REUSE_TREE::add(uint64_t position, int32_t delta)
+{
+    marks += delta;
+    for (uint64_t i=position+1; i<count.size(); i+=i&(~i+1))
+        count[i] += delta;
+}
+
+uint64_t REUSE_TREE::after(uint64_t position)
+{
+    uint64_t before = 0;
+    for (uint64_t i=position+1; i>0; i-=i&(~i+1))
+        before += count[i];
+
+    return marks - before;
+}
+
+static inline uint32_t reuse_bin(uint64_t distance)
+{
+    uint32_t bin = 0;
+    while (distance) {
+        bin++;
+        distance >>= 1;
+    }
+
+    return min(bin, (uint32_t)ANALYZER_REUSE_BINS - 1);
+}
+
+// same bins as CACHE::get_stride_bin
+static inline uint32_t stride_bin(uint64_t stride)
+{
+    if (stride == 0)
+        return 0;
+    else if (stride == 1)
+        return 1;
+    else if (stride < 4)
+        return 2;
+    else if (stride < 32)
+        return 3;
+    else if (stride < 128)
+        return 4;
+    else if (stride < 1024)
+        return 5;
+    else if (stride < 4096)
+        return 6;
+
+    return 7;
+}
+
+static inline uint64_t line_distance(uint64_t a, uint64_t b)
+{
+    return (a > b) ? a - b : b - a;
+}
+
+static inline void access_line(uint64_t ip, uint64_t address, uint64_t &access, CHUNK_RESULT *result,
+                               unordered_map <uint64_t, uint64_t> &local_line, REUSE_TREE &local_tree)
+{
+    uint64_t line = address >> LOG2_BLOCK_SIZE;
+
+    unordered_map <uint64_t, uint64_t>::iterator it = local_line.find(line);
+    if (it != local_line.end()) {
+        LINE_REUSE &reused = result->lines[it->second];
+        result->reuse[reuse_bin(local_tree.after(reused.last))]++;
+        local_tree.add(reused.last, -1);
+        reused.last = access;
+    }
+    else {
+        local_line[line] = result->lines.size();
+        result->lines.push_back({line, access, access});
+        result->data_pages.insert(address >> LOG2_PAGE_SIZE);
+    }
+    local_tree.add(access, 1);
+    access++;
+
+    IP_STRIDE &stride = result->strides[ip];
+    if (stride.accesses)
+        stride.bin[stride_bin(line_distance(line, stride.last_line))]++;
+    else
+        stride.first_line = line;
+    stride.last_line = line;
+    stride.accesses++;
+}
+
+template <class INSTR> void analyze_chunk(const INSTR *record, uint64_t num_records, CHUNK_RESULT *result,
+                                          unordered_map <uint64_t, uint64_t> &local_line, REUSE_TREE &local_tree)
+{
+    const uint32_t num_destinations = sizeof(record->destination_memory) / sizeof(record->destination_memory[0]);
+
+    result->num_accesses = 0;
+    for (uint64_t r=0; r<num_records; r++) {
+        for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++)
+            result->num_accesses += (record[r].source_memory[i] != 0);
+        for (uint32_t i=0; i<num_destinations; i++)
+            result->num_accesses += (record[r].destination_memory[i] != 0);
+    }
+
+    local_line.clear();
+    local_tree.reset(result->num_accesses);
+    for (uint32_t i=0; i<ANALYZER_REUSE_BINS; i++)
+        result->reuse[i] = 0;
+
+    uint64_t access = 0, last_code_line = 0;
+    for (uint64_t r=0; r<num_records; r++) {
+        const INSTR &instr = record[r];
+        ANALYZER_MIX &mix = result->mix;
+
+        mix.instructions++;
+        if ((instr.ip >> LOG2_BLOCK_SIZE) != last_code_line) {
+            last_code_line = instr.ip >> LOG2_BLOCK_SIZE;
+            result->code_lines.insert(last_code_line);
+            result->code_pages.insert(instr.ip >> LOG2_PAGE_SIZE);
+        }
+
+        if (instr.is_branch) {
+            BRANCH_BIAS &bias = result->branches[instr.ip];
+            bias.executed++;
+            mix.branches++;
+            if (instr.branch_taken) {
+                bias.taken++;
+                mix.taken++;
+            }
+        }
+
+        // loads before stores, as the core issues them
+        uint32_t load_ops = 0, store_ops = 0;
+        for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++) {
+            if (instr.source_memory[i]) {
+                access_line(instr.ip, instr.source_memory[i], access, result, local_line, local_tree);
+                load_ops++;
+            }
+        }
+        for (uint32_t i=0; i<num_destinations; i++) {
+            if (instr.destination_memory[i]) {
+                access_line(instr.ip, instr.destination_memory[i], access, result, local_line, local_tree);
+                store_ops++;
+            }
+        }
+
+        mix.load_ops += load_ops;
+        mix.store_ops += store_ops;
+        mix.loads += (load_ops > 0);
+        mix.stores += (store_ops > 0);
+        mix.memory_instructions += (load_ops + store_ops > 0);
+        mix.others += (load_ops + store_ops == 0) && !instr.is_branch;
+    }
+}
+
+template void analyze_chunk<input_instr>(const input_instr *, uint64_t, CHUNK_RESULT *, unordered_map <uint64_t, uint64_t> &, REUSE_TREE &);
+template void analyze_chunk<cloudsuite_instr>(const cloudsuite_instr *, uint64_t, CHUNK_RESULT *, unordered_map <uint64_t, uint64_t> &, REUSE_TREE &);
+
+TRACE_ANALYZER::TRACE_ANALYZER()
+{
+    next_access = 0;
+    capacity = 1 << 22;
+    tree.reset(capacity);
+    cold = 0;
+    for (uint32_t i=0; i<ANALYZER_REUSE_BINS; i++)
+        reuse[i] = 0;
+}
+
+// renumbers the last accesses 0, 1, ... in their order, so that room more accesses fit in the tree
+void TRACE_ANALYZER::compact(uint64_t room)
+{
+    vector <pair <uint64_t, uint64_t> > order;
+    order.reserve(last_access.size());
+    for (unordered_map <uint64_t, uint64_t>::iterator it = last_access.begin(); it != last_access.end(); it++)
+        order.push_back(make_pair(it->second, it->first));
+    sort(order.begin(), order.end());
+
+    capacity = max(capacity, 2 * (order.size() + room));
+    tree.reset(capacity);
+    for (uint64_t i=0; i<order.size(); i++) {
+        last_access[order[i].second] = i;
+        tree.add(i, 1);
+    }
+    next_access = order.size();
+}
+
+// chunks are merged in trace order
+void TRACE_ANALYZER::merge(CHUNK_RESULT *chunk)
+{
+    mix.add(chunk->mix);
+
+    // a line's first access in the chunk is a reuse of its last access in an earlier chunk, the distinct lines
+    // in between are those accessed since then, in earlier chunks or before it in this chunk, so the marks of
+    // the lines of this chunk move to their first access, in order, and to their last access afterwards
+    if (next_access + chunk->num_accesses > capacity)
+        compact(chunk->num_accesses);
+
+    uint64_t base = next_access;
+    for (uint64_t i=0; i<chunk->lines.size(); i++) {
+        LINE_REUSE &line = chunk->lines[i];
+        unordered_map <uint64_t, uint64_t>::iterator it = last_access.find(line.line);
+        if (it != last_access.end()) {
+            reuse[reuse_bin(tree.after(it->second))]++;
+            tree.add(it->second, -1);
+        }
+        else
+            cold++;
+        tree.add(base + line.first, 1);
+    }
+    for (uint64_t i=0; i<chunk->lines.size(); i++) {
+        LINE_REUSE &line = chunk->lines[i];
+        if (line.last != line.first) {
+            tree.add(base + line.first, -1);
+            tree.add(base + line.last, 1);
+        }
+        last_access[line.line] = base + line.last;
+    }
+    next_access = base + chunk->num_accesses;
+
+    for (uint32_t i=0; i<ANALYZER_REUSE_BINS; i++)
+        reuse[i] += chunk->reuse[i];
+
+    // the first stride of an IP in the chunk starts at its last line in an earlier chunk
+    for (unordered_map <uint64_t, IP_STRIDE>::iterator it = chunk->strides.begin(); it != chunk->strides.end(); it++) {
+        IP_STRIDE &stride = strides[it->first];
+        if (stride.accesses)
+            stride.bin[stride_bin(line_distance(it->second.first_line, stride.last_line))]++;
+        for (uint32_t i=0; i<ANALYZER_STRIDE_BINS; i++)
+            stride.bin[i] += it->second.bin[i];
+        stride.last_line = it->second.last_line;
+        stride.accesses += it->second.accesses;
+    }
+
+    for (unordered_map <uint64_t, BRANCH_BIAS>::iterator it = chunk->branches.begin(); it != chunk->branches.end(); it++) {
+        BRANCH_BIAS &bias = branches[it->first];
+        bias.executed += it->second.executed;
+        bias.taken += it->second.taken;
+    }
+
+    data_pages.insert(chunk->data_pages.begin(), chunk->data_pages.end());
+    code_lines.insert(chunk->code_lines.begin(), chunk->code_lines.end());
+    code_pages.insert(chunk->code_pages.begin(), chunk->code_pages.end());
+}
+
+static inline double percent(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0;
+}
+
+void TRACE_ANALYZER::print(const char *trace_name, uint32_t top_ips)
+{
+    cout << endl << "Trace: " << trace_name << endl;
+
+    cout << "INSTRUCTION MIX" << endl;
+    cout << "  INSTRUCTIONS: " << setw(12) << mix.instructions << endl;
+    cout << "  BRANCH:       " << setw(12) << mix.branches << " (" << percent(mix.branches, mix.instructions) << "%)  TAKEN: " << mix.taken << " (" << percent(mix.taken, mix.branches) << "%)" << endl;
+    cout << "  LOAD:         " << setw(12) << mix.loads << " (" << percent(mix.loads, mix.instructions) << "%)  OPS: " << mix.load_ops << endl;
+    cout << "  STORE:        " << setw(12) << mix.stores << " (" << percent(mix.stores, mix.instructions) << "%)  OPS: " << mix.store_ops << endl;
+    cout << "  MEMORY:       " << setw(12) << mix.memory_instructions << " (" << percent(mix.memory_instructions, mix.instructions) << "%)" << endl;
+    cout << "  OTHER:        " << setw(12) << mix.others << " (" << percent(mix.others, mix.instructions) << "%)" << endl;
+
+    cout << "FOOTPRINT" << endl;
+    cout << "  DATA LINES: " << setw(12) << last_access.size() << " (" << (last_access.size() << LOG2_BLOCK_SIZE) / (1024.0 * 1024) << " MB)  PAGES: " << setw(10) << data_pages.size() << endl;
+    cout << "  CODE LINES: " << setw(12) << code_lines.size() << " (" << (code_lines.size() << LOG2_BLOCK_SIZE) / (1024.0 * 1024) << " MB)  PAGES: " << setw(10) << code_pages.size() << endl;
+
+    // the hit rate of a fully associative LRU cache of BIN lines
+    uint64_t accesses = cold, hits = 0;
+    uint32_t last_bin = 0;
+    for (uint32_t i=0; i<ANALYZER_REUSE_BINS; i++) {
+        accesses += reuse[i];
+        if (reuse[i])
+            last_bin = i;
+    }
+    cout << "REUSE DISTANCE BINS" << endl;
+    for (uint32_t i=0; i<=last_bin; i++) {
+        hits += reuse[i];
+        cout << "  BIN " << setw(12) << (1ULL << i) << " : " << setw(12) << reuse[i] << "  LRU HIT RATE: " << percent(hits, accesses) << "%" << endl;
+    }
+    cout << "  COLD             : " << setw(12) << cold << endl;
+
+    uint64_t global[ANALYZER_STRIDE_BINS] = {};
+    vector <pair <uint64_t, uint64_t> > by_accesses;
+    for (unordered_map <uint64_t, IP_STRIDE>::iterator it = strides.begin(); it != strides.end(); it++) {
+        for (uint32_t i=0; i<ANALYZER_STRIDE_BINS; i++)
+            global[i] += it->second.bin[i];
+        by_accesses.push_back(make_pair(it->second.accesses, it->first));
+    }
+    sort(by_accesses.rbegin(), by_accesses.rend());
+
+    cout << "STRIDE DISTRIBUTION" << endl;
+    for (uint32_t i=0; i<ANALYZER_STRIDE_BINS; i++)
+        cout << "  LOCAL STRIDE BIN " << i << " : " << global[i] << endl;
+    cout << "  MEMORY IPS : " << strides.size() << endl;
+    for (uint32_t n=0; (n<top_ips) && (n<by_accesses.size()); n++) {
+        IP_STRIDE &stride = strides[by_accesses[n].second];
+        cout << "  IP: " << hex << setw(16) << by_accesses[n].second << dec << " ACCESSES: " << setw(10) << stride.accesses << " BINS:";
+        for (uint32_t i=0; i<ANALYZER_STRIDE_BINS; i++)
+            cout << " " << stride.bin[i];
+        cout << endl;
+    }
+
+    // static and dynamic branches per bias bin
+    const double bias_limit[ANALYZER_BIAS_BINS] = {0.6, 0.7, 0.8, 0.9, 0.99, 1.01};
+    const char *bias_name[ANALYZER_BIAS_BINS] = {"50-60%", "60-70%", "70-80%", "80-90%", "90-99%", "99-100%"};
+    uint64_t static_branches[ANALYZER_BIAS_BINS] = {}, dynamic_branches[ANALYZER_BIAS_BINS] = {};
+    for (unordered_map <uint64_t, BRANCH_BIAS>::iterator it = branches.begin(); it != branches.end(); it++) {
+        double bias = (double)max(it->second.taken, it->second.executed - it->second.taken) / it->second.executed;
+        uint32_t bin = 0;
+        while (bias >= bias_limit[bin])
+            bin++;
+        static_branches[bin]++;
+        dynamic_branches[bin] += it->second.executed;
+    }
+    cout << "BRANCH BIAS" << endl;
+    cout << "  STATIC BRANCHES: " << branches.size() << "  DYNAMIC BRANCHES: " << mix.branches << endl;
+    for (uint32_t i=0; i<ANALYZER_BIAS_BINS; i++) {
+        cout << "  BIAS " << setw(7) << bias_name[i] << " STATIC: " << setw(10) << static_branches[i];
+        cout << "  DYNAMIC: " << setw(12) << dynamic_branches[i] << " (" << percent(dynamic_branches[i], mix.branches) << "%)" << endl;
+    }
+}
+
+// chunk i is filled into slot i % num_slots once chunk i - num_slots is merged
+class ANALYZER_SLOT {
+  public:
+    char *records;
+    uint64_t num_records;
+    CHUNK_RESULT *result;
+    uint8_t done;
+};
+
+static ANALYZER_SLOT *slot;
+static uint64_t num_slots, dispatched, analyzed;
+static uint8_t analyzer_stop;
+static mutex analyzer_lock;
+static condition_variable work_ready, work_done;
+
+static void analyzer_worker()
+{
+    unordered_map <uint64_t, uint64_t> local_line;
+    REUSE_TREE local_tree;
+
+    while (1) {
+        unique_lock <mutex> lock(analyzer_lock);
+        work_ready.wait(lock, [] { return analyzer_stop || (analyzed < dispatched); });
+        if (analyzed == dispatched)
+            return;
+        ANALYZER_SLOT &chunk = slot[analyzed++ % num_slots];
+        lock.unlock();
+
+        chunk.result = new CHUNK_RESULT;
+        if (knob_cloudsuite)
+            analyze_chunk((cloudsuite_instr *)chunk.records, chunk.num_records, chunk.result, local_line, local_tree);
+        else
+            analyze_chunk((input_instr *)chunk.records, chunk.num_records, chunk.result, local_line, local_tree);
+
+        lock.lock();
+        chunk.done = 1;
+        work_done.notify_all();
+    }
+}
+
+static void analyze_trace(const char *trace_name, uint64_t max_instructions, uint64_t chunk_records, uint32_t top_ips)
+{
+    uint32_t record_size = knob_cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr);
+    TRACE_READER trace;
+    trace.open(trace_name, record_size);
+
+    TRACE_ANALYZER analyzer;
+    uint64_t merged = 0, instructions = 0;
+    uint8_t end_of_trace = 0;
+    while (!end_of_trace || (merged < dispatched)) {
+        // the oldest chunk is merged before its slot is filled again
+        unique_lock <mutex> lock(analyzer_lock);
+        if (end_of_trace || (dispatched - merged == num_slots)) {
+            ANALYZER_SLOT &oldest = slot[merged % num_slots];
+            work_done.wait(lock, [&oldest] { return oldest.done; });
+            lock.unlock();
+
+            analyzer.merge(oldest.result);
+            delete oldest.result;
+            merged++;
+            continue;
+        }
+        lock.unlock();
+
+        ANALYZER_SLOT &chunk = slot[dispatched % num_slots];
+        chunk.num_records = 0;
+        chunk.done = 0;
+        while (chunk.num_records < chunk_records) {
+            if ((max_instructions && (instructions == max_instructions)) || !trace.read(chunk.records + chunk.num_records * record_size)) {
+                end_of_trace = 1;
+                break;
+            }
+            chunk.num_records++;
+            instructions++;
+        }
+
+        if (chunk.num_records) {
+            lock.lock();
+            dispatched++;
+            work_ready.notify_one();
+        }
+    }
+
+    analyzer.print(trace_name, top_ips);
+
+    lock_guard <mutex> lock(analyzer_lock);
+    dispatched = 0;
+    analyzed = 0;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t max_instructions = 0, chunk_records = ANALYZER_CHUNK_RECORDS;
+    uint32_t num_threads = thread::hardware_concurrency(), top_ips = ANALYZER_TOP_IPS;
+
+    int c;
+    while (1) {
+        static struct option long_options[] =
+        {
+            {"instructions", required_argument, 0, 'i'},
+            {"threads", required_argument, 0, 'p'},
+            {"chunk", required_argument, 0, 'k'},
+            {"top_ips", required_argument, 0, 'n'},
+            {"cloudsuite", no_argument, 0, 'c'},
+            {"traces", no_argument, 0, 't'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if ((c == -1) || (c == 't'))
+            break;
+
+        switch(c) {
+            case 'i':
+                max_instructions = atol(optarg);
+                break;
+            case 'p':
+                num_threads = atoi(optarg);
+                break;
+            case 'k':
+                chunk_records = atol(optarg);
+                break;
+            case 'n':
+                top_ips = atoi(optarg);
+                break;
+            case 'c':
+                knob_cloudsuite = 1;
+                break;
+            default:
+                assert(0);
+        }
+    }
+
+    if (optind >= argc) {
+        cerr << "usage: analyze_trace [-instructions N] [-threads N] [-chunk N] [-top_ips N] [-cloudsuite] -traces <trace> ..." << endl;
+        return 1;
+    }
+    num_threads = max(num_threads, 1u);
+    chunk_records = max(chunk_records, (uint64_t)1);
+
+    // two chunks per worker in flight
+    uint32_t record_size = knob_cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr);
+    num_slots = 2 * num_threads;
+    slot = new ANALYZER_SLOT[num_slots];
+    for (uint64_t i=0; i<num_slots; i++)
+        slot[i].records = new char[chunk_records * record_size];
+
+    cout << "*** ChampSim Trace Analyzer ***" << endl << endl;
+    cout << "Threads: " << num_threads << " Chunk Records: " << chunk_records << endl;
+    if (max_instructions)
+        cout << "Instructions: " << max_instructions << endl;
+
+    vector <thread> worker;
+    for (uint32_t i=0; i<num_threads; i++)
+        worker.push_back(thread(analyzer_worker));
+
+    for (int i=optind; i<argc; i++)
+        analyze_trace(argv[i], max_instructions, chunk_records, top_ips);
+
+    {
+        lock_guard <mutex> lock(analyzer_lock);
+        analyzer_stop = 1;
+        work_ready.notify_all();
+    }
+    for (uint32_t i=0; i<num_threads; i++)
+        worker[i].join();
+
+    for (uint64_t i=0; i<num_slots; i++)
+        delete[] slot[i].records;
+    delete[] slot;
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "ooo_cpu.h"
+#include "checkpoint.h"
 
 #define BIMODAL_TABLE_SIZE 16384
 #define BIMODAL_PRIME 16381
@@ -11,6 +12,8 @@ void O3_CPU::initialize_branch_predictor()
 
     for(int i = 0; i < BIMODAL_TABLE_SIZE; i++)
         bimodal_table[cpu][i] = 0;
+
+    checkpoint_register("bimodal_table" + to_string(cpu), bimodal_table[cpu], sizeof(bimodal_table[cpu]));
 }
 
 uint8_t O3_CPU::predict_branch(uint64_t ip)
@@ -55,23 +55,17 @@ if [ ! -f ./branch/${BRANCH}.bpred ] || [ ! -f ./prefetcher/${L1D_PREFETCHER}.l1
 fi
 
 # Check for multi-core
+# NUM_CPUS and DRAM_CHANNELS are passed to make, so inc/champsim.h is never edited
+DRAM_CHANNELS=1
 if [ "$NUM_CORE" != "1" ]
 then
     echo "${BOLD}Building multi-core ChampSim...${NORMAL}"
-    sed -i.bak 's/\<NUM_CPUS 1\>/NUM_CPUS '${NUM_CORE}'/g' inc/champsim.h
-	sed -i.bak 's/\<DRAM_CHANNELS 1\>/DRAM_CHANNELS 2/g' inc/champsim.h
-	sed -i.bak 's/\<DRAM_CHANNELS_LOG2 0\>/DRAM_CHANNELS_LOG2 1/g' inc/champsim.h
+    DRAM_CHANNELS=2
 else
     echo "${BOLD}Building single-core ChampSim...${NORMAL}"
 fi
 echo
 
-# Change prefetchers and replacement policy
-cp branch/${BRANCH}.bpred branch/branch_predictor.cc
-cp prefetcher/${L1D_PREFETCHER}.l1d_pref prefetcher/l1d_prefetcher.cc
-cp prefetcher/${L2C_PREFETCHER}.l2c_pref prefetcher/l2c_prefetcher.cc
-cp replacement/${LLC_REPLACEMENT}.llc_repl replacement/llc_replacement.cc
-
 # Collect cache configuration
 # 0 = ni
 # 1 = in
@@ -155,18 +149,26 @@ else
 fi
 
 # Build
+# every configuration has its own object directory, so several builds can run at once
+# the policies are picked by make, the tracked branch_predictor.cc and the others are left alone
+BINARY_NAME="${BRANCH}-${L1D_PREFETCHER}-${L2C_PREFETCHER}-${LLC_REPLACEMENT}-${NUM_CORE}core-${CACHE_CONFIG}-${PRINT_REUSE_STATS}-${PRINT_ACCESS_PATTERN}-${PRINT_OFFSET_PATTERN}-${PRINT_STRIDE_DISTRIBUTION}-${PRINT_MLP}"
+OBJ_DIR=obj/${BINARY_NAME}
 mkdir -p bin
-rm -f bin/champsim
-make clean
-make cache_config=$MF_CACHE_CONFIG print_reuse_stats=$MF_PRINT_REUSE_STATS \
+rm -f bin/${BINARY_NAME}
+make objDir=${OBJ_DIR} clean
+make objDir=${OBJ_DIR} app=${BINARY_NAME} \
+	 num_cpus=$NUM_CORE dram_channels=$DRAM_CHANNELS \
+	 branch_predictor=$BRANCH l1d_prefetcher=$L1D_PREFETCHER \
+	 l2c_prefetcher=$L2C_PREFETCHER llc_replacement=$LLC_REPLACEMENT \
+	 cache_config=$MF_CACHE_CONFIG print_reuse_stats=$MF_PRINT_REUSE_STATS \
 	 print_access_pattern=$MF_PRINT_ACCESS_PATTERN \
 	 print_offset_pattern=$MF_PRINT_OFFSET_PATTERN \
 	 print_stride_distribution=$MF_PRINT_STRIDE_DISTRIBUTION \
-	 print_mlp=$MF_PRINT_MLP
+	 print_mlp=$MF_PRINT_MLP bin/${BINARY_NAME}
 
 # Sanity check
 echo ""
-if [ ! -f bin/champsim ]; then
+if [ ! -f bin/${BINARY_NAME} ]; then
     echo "${BOLD}ChampSim build FAILED!${NORMAL}"
     echo ""
     exit
@@ -178,18 +180,5 @@ echo "L1D Prefetcher: ${L1D_PREFETCHER}"
 echo "L2C Prefetcher: ${L2C_PREFETCHER}"
 echo "LLC Replacement: ${LLC_REPLACEMENT}"
 echo "Cores: ${NUM_CORE}"
-BINARY_NAME="${BRANCH}-${L1D_PREFETCHER}-${L2C_PREFETCHER}-${LLC_REPLACEMENT}-${NUM_CORE}core-${CACHE_CONFIG}-${PRINT_REUSE_STATS}-${PRINT_ACCESS_PATTERN}-${PRINT_OFFSET_PATTERN}-${PRINT_STRIDE_DISTRIBUTION}-${PRINT_MLP}"
 echo "Binary: bin/${BINARY_NAME}${NORMAL}"
 echo ""
-mv bin/champsim bin/${BINARY_NAME}
-
-
-# Restore to the default configuration
-sed -i.bak 's/\<NUM_CPUS '${NUM_CORE}'\>/NUM_CPUS 1/g' inc/champsim.h
-sed -i.bak 's/\<DRAM_CHANNELS 2\>/DRAM_CHANNELS 1/g' inc/champsim.h
-sed -i.bak 's/\<DRAM_CHANNELS_LOG2 1\>/DRAM_CHANNELS_LOG2 0/g' inc/champsim.h
-
-cp branch/bimodal.bpred branch/branch_predictor.cc
-cp prefetcher/no.l1d_pref prefetcher/l1d_prefetcher.cc
-cp prefetcher/no.l2c_pref prefetcher/l2c_prefetcher.cc
-cp replacement/lru.llc_repl replacement/llc_replacement.cc
@@ -0,0 +1,441 @@
+#include "trace_generator.h"
+
+#include <getopt.h>
+
+static const char *kernel_name[NUM_KERNELS] = {"stream", "stride", "chase", "gather", "branch"};
+
+// footprint and stride take K, M and G as powers of 1024, instruction counts as powers of 1000
+static uint64_t parse_number(const char *text, uint64_t unit)
+{
+    char *end;
+    uint64_t value = strtoull(text, &end, 10);
+    if (end == text) {
+        cerr << "*** Not a number: " << text << " ***" << endl;
+        assert(0);
+    }
+
+    if ((*end == 'K') || (*end == 'k'))
+        value *= unit;
+    else if ((*end == 'M') || (*end == 'm'))
+        value *= unit * unit;
+    else if ((*end == 'G') || (*end == 'g'))
+        value *= unit * unit * unit;
+    else if (*end != '\0') {
+        cerr << "*** Not a number: " << text << " ***" << endl;
+        assert(0);
+    }
+
+    return value;
+}
+
+// <kernel>:<instructions>[:<parameter>=<value>,...]
+static GENERATOR_PHASE parse_phase(const char *text)
+{
+    GENERATOR_PHASE phase;
+    char spec[1024];
+    snprintf(spec, sizeof(spec), "%s", text);
+
+    char *kernel = strtok(spec, ":"),
+         *instructions = strtok(NULL, ":"),
+         *parameters = strtok(NULL, "");
+    if ((kernel == NULL) || (instructions == NULL)) {
+        cerr << "*** Phases are given as <kernel>:<instructions>[:<parameter>=<value>,...]: " << text << " ***" << endl;
+        assert(0);
+    }
+
+    phase.kernel = NUM_KERNELS;
+    for (uint8_t i=0; i<NUM_KERNELS; i++) {
+        if (strcmp(kernel, kernel_name[i]) == 0)
+            phase.kernel = i;
+    }
+    if (phase.kernel == NUM_KERNELS) {
+        cerr << "*** Unknown kernel: " << kernel << " ***" << endl;
+        assert(0);
+    }
+    phase.instructions = parse_number(instructions, 1000);
+
+    char *save = NULL;
+    for (char *parameter = parameters ? strtok_r(parameters, ",", &save) : NULL; parameter; parameter = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(parameter, '=');
+        if (value == NULL) {
+            cerr << "*** Parameters are given as <parameter>=<value>: " << parameter << " ***" << endl;
+            assert(0);
+        }
+        *value++ = '\0';
+
+        if (strcmp(parameter, "footprint") == 0)
+            phase.footprint = parse_number(value, 1024);
+        else if (strcmp(parameter, "stride") == 0)
+            phase.stride = parse_number(value, 1024);
+        else if (strcmp(parameter, "streams") == 0)
+            phase.streams = parse_number(value, 1000);
+        else if (strcmp(parameter, "alu") == 0)
+            phase.alu = parse_number(value, 1000);
+        else if (strcmp(parameter, "bias") == 0)
+            phase.bias = atof(value);
+        else {
+            cerr << "*** Unknown parameter: " << parameter << " ***" << endl;
+            assert(0);
+        }
+    }
+
+    return phase;
+}
+
+// instruction shapes, register 0 means no register
+static void alu(input_instr *instr, uint8_t destination, uint8_t source1, uint8_t source2)
+{
+    instr->destination_registers[0] = destination;
+    instr->source_registers[0] = source1;
+    instr->source_registers[1] = source2;
+}
+
+static void load(input_instr *instr, uint8_t destination, uint8_t address_register, uint64_t address)
+{
+    instr->destination_registers[0] = destination;
+    instr->source_registers[0] = address_register;
+    instr->source_memory[0] = address;
+}
+
+static void store(input_instr *instr, uint8_t data_register, uint8_t address_register, uint64_t address)
+{
+    instr->source_registers[0] = data_register;
+    instr->source_registers[1] = address_register;
+    instr->destination_memory[0] = address;
+}
+
+static void compare(input_instr *instr, uint8_t source1, uint8_t source2)
+{
+    instr->destination_registers[0] = GENERATOR_REG_FLAGS;
+    instr->source_registers[0] = source1;
+    instr->source_registers[1] = source2;
+}
+
+static void branch(input_instr *instr, uint8_t taken)
+{
+    instr->is_branch = 1;
+    instr->branch_taken = taken;
+    instr->destination_registers[0] = GENERATOR_REG_IP;
+    instr->source_registers[0] = GENERATOR_REG_IP;
+    instr->source_registers[1] = GENERATOR_REG_FLAGS;
+}
+
+void TRACE_GENERATOR::open(const char *file_name)
+{
+    const char *extension = strrchr(file_name, '.');
+    if (extension && ((strcmp(extension, ".xz") == 0) || (strcmp(extension, ".zst") == 0))) {
+        char command[1100];
+        snprintf(command, sizeof(command), "%s > %s", (extension[1] == 'x') ? "xz -c" : "zstd -q -c", file_name);
+        pipe = popen(command, "w");
+    }
+    else if (extension && (strcmp(extension, ".gz") == 0))
+        gz = gzopen(file_name, "wb1");
+    else {
+        cerr << "*** Traces are written as gz, xz or zst: " << file_name << " ***" << endl;
+        assert(0);
+    }
+
+    if ((gz == NULL) && (pipe == NULL)) {
+        cerr << "*** Cannot open trace for writing: " << file_name << " ***" << endl;
+        assert(0);
+    }
+}
+
+void TRACE_GENERATOR::flush()
+{
+    for (uint64_t i=0; i<buffered; i++) {
+        input_instr *instr = &buffer[i];
+        stats.instructions++;
+        if (instr->is_branch) {
+            stats.branches++;
+            stats.taken += instr->branch_taken;
+        }
+        if (instr->source_memory[0])
+            stats.loads++;
+        if (instr->destination_memory[0])
+            stats.stores++;
+    }
+
+    uint64_t bytes = buffered * sizeof(input_instr);
+    if (bytes && (gz ? (gzwrite(gz, buffer.data(), bytes) != (int)bytes) : (fwrite(buffer.data(), 1, bytes, pipe) != bytes))) {
+        cerr << "*** Cannot write trace ***" << endl;
+        assert(0);
+    }
+    buffered = 0;
+}
+
+void TRACE_GENERATOR::close()
+{
+    flush();
+    if ((gz && (gzclose(gz) != Z_OK)) || (pipe && pclose(pipe))) {
+        cerr << "*** Cannot write trace ***" << endl;
+        assert(0);
+    }
+    gz = NULL;
+    pipe = NULL;
+}
+
+input_instr *TRACE_GENERATOR::emit(uint64_t ip)
+{
+    input_instr *instr = &discard;
+    if (limit) {
+        if (buffered == GENERATOR_BUFFER_RECORDS)
+            flush();
+        instr = &buffer[buffered++];
+        limit--;
+    }
+
+    *instr = input_instr();
+    instr->ip = ip;
+
+    return instr;
+}
+
+// independent of the standard library's distributions, which differ between implementations
+uint64_t TRACE_GENERATOR::random(uint64_t range)
+{
+    return engine() % range;
+}
+
+double TRACE_GENERATOR::uniform()
+{
+    return (engine() >> 11) * (1.0 / (1ull << 53));
+}
+
+void TRACE_GENERATOR::prepare(GENERATOR_PHASE *phase)
+{
+    if (phase->footprint == 0) {
+        if (phase->kernel == KERNEL_CHASE)
+            phase->footprint = 16 << 20;
+        else if (phase->kernel == KERNEL_BRANCH)
+            phase->footprint = 4 << 10;
+        else
+            phase->footprint = 64 << 20;
+    }
+    if (phase->streams == 0)
+        phase->streams = (phase->kernel == KERNEL_BRANCH) ? 8 : 1;
+
+    // the gather kernel keeps its index array right after the data
+    uint64_t region = phase->footprint * ((phase->kernel == KERNEL_GATHER) ? 2 : 1),
+             body = 3 * phase->streams + phase->alu + 8;
+    if ((phase->footprint < (2 * BLOCK_SIZE)) || (region > GENERATOR_DATA_REGION) || (phase->stride == 0) ||
+        (body * GENERATOR_INSTR_SIZE > GENERATOR_IP_REGION) || (phase->bias < 0) || (phase->bias > 1)) {
+        cerr << "*** Phase parameters out of range: footprint " << phase->footprint << " stride " << phase->stride;
+        cerr << " streams " << phase->streams << " alu " << phase->alu << " bias " << phase->bias << " ***" << endl;
+        assert(0);
+    }
+
+    // the lines are shuffled and linked into one ring, so the chase never settles in a short loop
+    if (phase->kernel == KERNEL_CHASE) {
+        uint64_t lines = phase->footprint / BLOCK_SIZE;
+        vector <uint32_t> order(lines);
+        for (uint64_t i=0; i<lines; i++)
+            order[i] = i;
+        for (uint64_t i=lines-1; i>0; i--)
+            swap(order[i], order[random(i + 1)]);
+
+        phase->next_node.resize(lines);
+        for (uint64_t i=0; i<lines; i++)
+            phase->next_node[order[i]] = order[(i + 1) % lines];
+        phase->node = order[0];
+    }
+}
+
+// extra ALU work, then the induction variable, the exit test and the backward branch
+void TRACE_GENERATOR::loop_end(GENERATOR_PHASE *phase, uint64_t ip)
+{
+    for (uint64_t i=0; i<phase->alu; i++) {
+        alu(emit(ip), 10 + (i % 4), 10 + (i % 4), 14);
+        ip += GENERATOR_INSTR_SIZE;
+    }
+
+    alu(emit(ip), 8, 8, 0);
+    compare(emit(ip + GENERATOR_INSTR_SIZE), 8, 9);
+    branch(emit(ip + 2*GENERATOR_INSTR_SIZE), 1);
+    phase->position++;
+}
+
+void TRACE_GENERATOR::stream(GENERATOR_PHASE *phase)
+{
+    uint64_t elements = max(phase->footprint / (3 * 8), (uint64_t)1),
+             i = phase->position % elements,
+             a = phase->data_base + 8*i,
+             b = a + 8*elements,
+             c = b + 8*elements,
+             ip = phase->ip_base;
+
+    load(emit(ip), 1, 8, a);
+    load(emit(ip + GENERATOR_INSTR_SIZE), 2, 8, b);
+    alu(emit(ip + 2*GENERATOR_INSTR_SIZE), 2, 2, 3);
+    alu(emit(ip + 3*GENERATOR_INSTR_SIZE), 1, 1, 2);
+    store(emit(ip + 4*GENERATOR_INSTR_SIZE), 1, 8, c);
+    loop_end(phase, ip + 5*GENERATOR_INSTR_SIZE);
+}
+
+void TRACE_GENERATOR::strided(GENERATOR_PHASE *phase)
+{
+    uint64_t size = max(phase->footprint / phase->streams, phase->stride),
+             offset = (phase->position * phase->stride) % size,
+             ip = phase->ip_base;
+
+    for (uint64_t s=0; s<phase->streams; s++) {
+        uint8_t value = 1 + (s % 6);
+        load(emit(ip), value, 8, phase->data_base + s*size + offset);
+        alu(emit(ip + GENERATOR_INSTR_SIZE), 7, 7, value);
+        ip += 2*GENERATOR_INSTR_SIZE;
+    }
+    loop_end(phase, ip);
+}
+
+void TRACE_GENERATOR::chase(GENERATOR_PHASE *phase)
+{
+    uint64_t ip = phase->ip_base;
+
+    // the address of the next node is the value just loaded
+    load(emit(ip), 1, 1, phase->data_base + (uint64_t)phase->node * BLOCK_SIZE);
+    phase->node = phase->next_node[phase->node];
+    loop_end(phase, ip + GENERATOR_INSTR_SIZE);
+}
+
+void TRACE_GENERATOR::gather(GENERATOR_PHASE *phase)
+{
+    uint64_t elements = max(phase->footprint / 8, (uint64_t)1),
+             i = phase->position % elements,
+             ip = phase->ip_base;
+
+    load(emit(ip), 2, 8, phase->data_base + phase->footprint + 4*i);
+    load(emit(ip + GENERATOR_INSTR_SIZE), 3, 2, phase->data_base + 8*random(elements));
+    alu(emit(ip + 2*GENERATOR_INSTR_SIZE), 4, 4, 3);
+    loop_end(phase, ip + 3*GENERATOR_INSTR_SIZE);
+}
+
+// every block is a compare, a branch that skips the next instruction when taken, and that instruction
+// even blocks are usually taken and odd blocks usually not, bias 0.5 makes every branch a coin flip
+void TRACE_GENERATOR::branchy(GENERATOR_PHASE *phase)
+{
+    uint64_t ip = phase->ip_base;
+
+    load(emit(ip), 5, 8, phase->data_base + (phase->position * 8) % phase->footprint);
+    ip += GENERATOR_INSTR_SIZE;
+
+    for (uint64_t b=0; b<phase->streams; b++) {
+        uint8_t usual = (b % 2) == 0,
+                taken = (uniform() < phase->bias) ? usual : !usual;
+
+        compare(emit(ip), 5, 6 + (b % 4));
+        branch(emit(ip + GENERATOR_INSTR_SIZE), taken);
+        if (!taken)
+            alu(emit(ip + 2*GENERATOR_INSTR_SIZE), 5, 5, 6 + (b % 4));
+        ip += 3*GENERATOR_INSTR_SIZE;
+    }
+    loop_end(phase, ip);
+}
+
+void TRACE_GENERATOR::run(GENERATOR_PHASE *phase)
+{
+    limit = phase->instructions;
+    while (limit) {
+        switch (phase->kernel) {
+            case KERNEL_STREAM:
+                stream(phase);
+                break;
+            case KERNEL_STRIDE:
+                strided(phase);
+                break;
+            case KERNEL_CHASE:
+                chase(phase);
+                break;
+            case KERNEL_GATHER:
+                gather(phase);
+                break;
+            default:
+                branchy(phase);
+        }
+    }
+    flush();
+}
+
+int main(int argc, char** argv)
+{
+    char out[1024] = "";
+    uint64_t seed = 1, repeat = 1;
+    vector <GENERATOR_PHASE> phases;
+
+    int c;
+    while (1) {
+        static struct option long_options[] =
+        {
+            {"o", required_argument, 0, 'o'},
+            {"phase", required_argument, 0, 'p'},
+            {"repeat", required_argument, 0, 'r'},
+            {"seed", required_argument, 0, 's'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long_only(argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch(c) {
+            case 'o':
+                snprintf(out, sizeof(out), "%s", optarg);
+                break;
+            case 'p':
+                phases.push_back(parse_phase(optarg));
+                break;
+            case 'r':
+                repeat = atol(optarg);
+                break;
+            case 's':
+                seed = atol(optarg);
+                break;
+            default:
+                assert(0);
+        }
+    }
+
+    if ((out[0] == 0) || phases.empty()) {
+        cerr << "usage: gen_trace -o <name>.trace.<gz|xz|zst> [-seed N] [-repeat N] -phase <kernel>:<instructions>[:<parameter>=<value>,...] ..." << endl;
+        cerr << "kernels: stream, stride, chase, gather, branch" << endl;
+        cerr << "parameters: footprint (bytes), stride (bytes), streams, alu, bias" << endl;
+        return 1;
+    }
+
+    cout << "*** ChampSim Trace Generator ***" << endl << endl;
+
+    // champsim takes the random seed from the name before ".trace." and cannot run a trace named otherwise
+    if (strstr(out, ".trace.") == NULL)
+        cerr << "Warning: " << out << " is not named <name>.trace.<gz|xz|zst>, champsim expects that name" << endl;
+    cout << "Trace: " << out << " Seed: " << seed << " Repeat: " << repeat << endl;
+
+    TRACE_GENERATOR generator(seed);
+    for (uint64_t i=0; i<phases.size(); i++) {
+        phases[i].ip_base = GENERATOR_IP_BASE + i*GENERATOR_IP_REGION;
+        phases[i].data_base = GENERATOR_DATA_BASE + i*GENERATOR_DATA_REGION;
+        generator.prepare(&phases[i]);
+
+        cout << "Phase " << i << " " << kernel_name[phases[i].kernel] << " instructions: " << phases[i].instructions;
+        cout << " footprint: " << phases[i].footprint;
+        if (phases[i].kernel == KERNEL_STRIDE)
+            cout << " stride: " << phases[i].stride;
+        if ((phases[i].kernel == KERNEL_STRIDE) || (phases[i].kernel == KERNEL_BRANCH))
+            cout << " streams: " << phases[i].streams;
+        if (phases[i].kernel == KERNEL_BRANCH)
+            cout << " bias: " << phases[i].bias;
+        cout << " alu: " << phases[i].alu << endl;
+    }
+
+    generator.open(out);
+    for (uint64_t r=0; r<repeat; r++) {
+        for (uint64_t i=0; i<phases.size(); i++)
+            generator.run(&phases[i]);
+    }
+    generator.close();
+
+    GENERATOR_STATS *stats = &generator.stats;
+    cout << endl << "Instructions: " << stats->instructions << " loads: " << stats->loads << " stores: " << stats->stores;
+    cout << " branches: " << stats->branches << " taken: " << stats->taken << endl;
+
+    return 0;
+}
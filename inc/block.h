@@ -60,6 +60,71 @@ class DRAM_ARRAY {
     };
 };
 
+// ROB, LQ or SQ entries waiting on a packet, only packets that requests were merged into have any
+// the fastset is taken from a pool on the first insert, so copying or resetting the other packets only moves a NULL pointer
+class DEPEND_SET {
+  public:
+    fastset *set;
+
+    DEPEND_SET() {
+        set = NULL;
+    };
+
+    DEPEND_SET(const DEPEND_SET &other) {
+        set = NULL;
+        copy(other);
+    };
+
+    ~DEPEND_SET() {
+        clear();
+    };
+
+    DEPEND_SET &operator=(const DEPEND_SET &other) {
+        if (this != &other)
+            copy(other);
+        return *this;
+    };
+
+    void insert(TYPE x) {
+        if (set == NULL)
+            set = allocate();
+        set->insert(x);
+    };
+
+    void join(DEPEND_SET &other, int n) {
+        if (other.set == NULL)
+            return;
+        if (set == NULL)
+            set = allocate();
+        set->join(*other.set, n);
+    };
+
+    int expand(TYPE v[], int n) {
+        return set ? set->expand(v, n) : 0;
+    };
+
+    void clear() {
+        if (set) {
+            release(set);
+            set = NULL;
+        }
+    };
+
+    void copy(const DEPEND_SET &other) {
+        if (other.set == NULL) {
+            clear();
+            return;
+        }
+        if (set == NULL)
+            set = allocate();
+        *set = *other.set;
+    };
+
+    // the pool is per host thread, sets are never returned to the system
+    static fastset *allocate();
+    static void release(fastset *set);
+};
+
 // message packet
 class PACKET {
   public:
@@ -93,7 +158,7 @@ class PACKET {
              asid[2],
              type;
 
-    fastset
+    DEPEND_SET
              rob_index_depend_on_me, 
              lq_index_depend_on_me, 
              sq_index_depend_on_me;
@@ -153,6 +218,7 @@ class PACKET {
         address = 0;
         full_addr = 0;
         instruction_pa = 0;
+        data_pa = 0;
         data = 0;
         instr_id = 0;
         ip = 0;
@@ -160,6 +226,44 @@ class PACKET {
     };
 };
 
+// hash from an address to the entry holding it, open addressing with linear probing
+// an address can be in several entries, find() returns the one inserted first
+class ADDRESS_INDEX {
+  public:
+    const uint32_t SIZE; // entries, at most half of the slots are used
+    uint32_t hash_mask,
+             *hash_entry; // UINT32_MAX for an empty slot
+    uint64_t *hash_address;
+
+    ADDRESS_INDEX(uint32_t v1) : SIZE(v1) {
+        uint32_t hash_size = 1;
+        while (hash_size < 2*SIZE)
+            hash_size <<= 1;
+        hash_mask = hash_size - 1;
+        hash_entry = new uint32_t[hash_size];
+        hash_address = new uint64_t[hash_size];
+        for (uint32_t i=0; i<hash_size; i++) {
+            hash_entry[i] = UINT32_MAX;
+            hash_address[i] = 0;
+        }
+    };
+
+    ~ADDRESS_INDEX() {
+        delete[] hash_entry;
+        delete[] hash_address;
+    };
+
+    // entry holding address, -1 if none
+    int find(uint64_t address);
+
+    void insert(uint64_t address, uint32_t index),
+         erase(uint64_t address, uint32_t index);
+
+    uint32_t hash(uint64_t address) {
+        return (uint32_t) ((address * 0x9E3779B97F4A7C15ull) >> 32) & hash_mask;
+    };
+};
+
 // packet queue
 class PACKET_QUEUE {
   public:
@@ -192,8 +296,12 @@ class PACKET_QUEUE {
 
     PACKET *entry, processed_packet[2*MAX_READ_PER_CYCLE];
 
+    // queues searched by check_queue() keep an index of their entries, filled by add_queue() and emptied by remove_queue()
+    ADDRESS_INDEX *index;
+    uint8_t match_full_addr; // match packets by full_addr instead of the block address
+
     // constructor
-    PACKET_QUEUE(string v1, uint32_t v2) : NAME(v1), SIZE(v2) {
+    PACKET_QUEUE(string v1, uint32_t v2, uint8_t searched = 0) : NAME(v1), SIZE(v2) {
         is_RQ = 0;
         is_WQ = 0;
         write_mode = 0;
@@ -220,6 +328,10 @@ class PACKET_QUEUE {
         FULL = 0;
 
         entry = new PACKET[SIZE]; 
+
+        index = searched ? new ADDRESS_INDEX(SIZE) : NULL;
+        // stores to the same line are only merged in the L1D write queue if they write the same bytes
+        match_full_addr = (NAME == "L1D_WQ");
     };
 
     PACKET_QUEUE() {
@@ -248,11 +360,18 @@ class PACKET_QUEUE {
         FULL = 0;
 
         //entry = new PACKET[SIZE]; 
+        index = NULL;
+        match_full_addr = 0;
     };
 
     // destructor
     ~PACKET_QUEUE() {
         delete[] entry;
+        delete index;
+    };
+
+    uint64_t match_address(PACKET *packet) {
+        return match_full_addr ? packet->full_addr : packet->address;
     };
 
     // functions
@@ -261,6 +380,66 @@ class PACKET_QUEUE {
          remove_queue(PACKET* packet);
 };
 
+// bookkeeping of an MSHR, so that merging, allocating and picking the next fill do not scan every entry
+// an address index, a bitmap of free entries, and a min-heap of the completed entries ordered by (event_cycle, index)
+// the lowest free entry is allocated and ties are broken by the lowest index, as the linear scans did
+class MSHR_INDEX {
+  public:
+    const uint32_t SIZE;
+    ADDRESS_INDEX address_index;
+    uint32_t *heap,
+             *heap_position, // SIZE if the entry is not in the heap
+             heap_size;
+    uint64_t *heap_cycle,    // by entry
+             *free_mask;
+
+    MSHR_INDEX(uint32_t v1) : SIZE(v1), address_index(v1) {
+        heap = new uint32_t[SIZE];
+        heap_position = new uint32_t[SIZE];
+        heap_cycle = new uint64_t[SIZE];
+        heap_size = 0;
+        for (uint32_t i=0; i<SIZE; i++)
+            heap_position[i] = SIZE;
+
+        free_mask = new uint64_t[(SIZE+63)/64];
+        for (uint32_t i=0; i<(SIZE+63)/64; i++)
+            free_mask[i] = 0;
+        for (uint32_t i=0; i<SIZE; i++)
+            free_mask[i/64] |= 1ull << (i%64);
+    };
+
+    ~MSHR_INDEX() {
+        delete[] heap;
+        delete[] heap_position;
+        delete[] heap_cycle;
+        delete[] free_mask;
+    };
+
+    // entry holding address, -1 if none
+    int find(uint64_t address) {
+        return address_index.find(address);
+    };
+
+    // takes the lowest free entry for address, SIZE if the MSHR is full
+    uint32_t allocate(uint64_t address);
+
+    void release(uint32_t index, uint64_t address),
+         complete(uint32_t index, uint64_t event_cycle); // the entry returned and fills at event_cycle
+
+    // completed entry with the earliest event_cycle, SIZE if none
+    uint32_t next_fill() {
+        return heap_size ? heap[0] : SIZE;
+    };
+
+    bool heap_less(uint32_t a, uint32_t b) {
+        return (heap_cycle[a] < heap_cycle[b]) || ((heap_cycle[a] == heap_cycle[b]) && (a < b));
+    };
+
+    void heap_swap(uint32_t i, uint32_t j),
+         heap_up(uint32_t i),
+         heap_down(uint32_t i);
+};
+
 // reorder buffer
 class CORE_BUFFER {
   public:
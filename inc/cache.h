@@ -3,6 +3,9 @@
 
 #include <map>
 #include <set>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 #include "memory_class.h"
 
 // PAGE
@@ -17,68 +20,61 @@ extern uint32_t PAGE_TABLE_LATENCY, SWAP_LATENCY;
 #define IS_L2C  5
 #define IS_LLC  6
 
+// cache geometry, queue sizes and latencies are set at runtime (-config), defaults are in src/cache.cc
 // INSTRUCTION TLB
-#define ITLB_SET 16
-#define ITLB_WAY 4
-#define ITLB_RQ_SIZE 16
-#define ITLB_WQ_SIZE 16
-#define ITLB_PQ_SIZE 0
-#define ITLB_MSHR_SIZE 8
-#define ITLB_LATENCY 1
+extern uint32_t ITLB_SET, ITLB_WAY, ITLB_RQ_SIZE, ITLB_WQ_SIZE, ITLB_PQ_SIZE, ITLB_MSHR_SIZE, ITLB_LATENCY;
 
 // DATA TLB
-#define DTLB_SET 16
-#define DTLB_WAY 4
-#define DTLB_RQ_SIZE 16
-#define DTLB_WQ_SIZE 16
-#define DTLB_PQ_SIZE 0
-#define DTLB_MSHR_SIZE 8
-#define DTLB_LATENCY 1
+extern uint32_t DTLB_SET, DTLB_WAY, DTLB_RQ_SIZE, DTLB_WQ_SIZE, DTLB_PQ_SIZE, DTLB_MSHR_SIZE, DTLB_LATENCY;
 
 // SECOND LEVEL TLB
-#define STLB_SET 128
-#define STLB_WAY 12
-#define STLB_RQ_SIZE 32
-#define STLB_WQ_SIZE 32
-#define STLB_PQ_SIZE 0
-#define STLB_MSHR_SIZE 16
-#define STLB_LATENCY 8
+extern uint32_t STLB_SET, STLB_WAY, STLB_RQ_SIZE, STLB_WQ_SIZE, STLB_PQ_SIZE, STLB_MSHR_SIZE, STLB_LATENCY;
 
 // L1 INSTRUCTION CACHE
-#define L1I_SET 64
-#define L1I_WAY 8
-#define L1I_RQ_SIZE 64
-#define L1I_WQ_SIZE 64 
-#define L1I_PQ_SIZE 64
-#define L1I_MSHR_SIZE 8
-#define L1I_LATENCY 1
+extern uint32_t L1I_SET, L1I_WAY, L1I_RQ_SIZE, L1I_WQ_SIZE, L1I_PQ_SIZE, L1I_MSHR_SIZE, L1I_LATENCY;
 
 // L1 DATA CACHE
-#define L1D_SET 64
-#define L1D_WAY 8
-#define L1D_RQ_SIZE 64
-#define L1D_WQ_SIZE 64 
-#define L1D_PQ_SIZE 64
-#define L1D_MSHR_SIZE 8
-#define L1D_LATENCY 4 
+extern uint32_t L1D_SET, L1D_WAY, L1D_RQ_SIZE, L1D_WQ_SIZE, L1D_PQ_SIZE, L1D_MSHR_SIZE, L1D_LATENCY;
 
 // L2 CACHE
-#define L2C_SET 512
-#define L2C_WAY 8
-#define L2C_RQ_SIZE 32
-#define L2C_WQ_SIZE 32
-#define L2C_PQ_SIZE 32
-#define L2C_MSHR_SIZE 16
-#define L2C_LATENCY 8  // 4 (L1I or L1D) + 8 = 12 cycles
+extern uint32_t L2C_SET, L2C_WAY, L2C_RQ_SIZE, L2C_WQ_SIZE, L2C_PQ_SIZE, L2C_MSHR_SIZE, L2C_LATENCY;
 
 // LAST LEVEL CACHE
-#define LLC_SET NUM_CPUS*2048
-#define LLC_WAY 16
-#define LLC_RQ_SIZE NUM_CPUS*L2C_MSHR_SIZE //48
-#define LLC_WQ_SIZE NUM_CPUS*L2C_MSHR_SIZE //48
-#define LLC_PQ_SIZE NUM_CPUS*L2C_MSHR_SIZE //48
-#define LLC_MSHR_SIZE 32
-#define LLC_LATENCY 20  // 4 (L1I or L1D) + 8 + 20 = 32 cycles
+extern uint32_t LLC_SET, LLC_WAY, LLC_RQ_SIZE, LLC_WQ_SIZE, LLC_PQ_SIZE, LLC_MSHR_SIZE, LLC_LATENCY;
+
+// per-block state of an LLC replacement policy, indexed [set][way] like a static array
+// policies allocate it in llc_initialize_replacement(), once the LLC geometry is known
+// the entries are contiguous, so a table is registered as one checkpoint section (entry, bytes())
+template <class T>
+class LLC_TABLE {
+  public:
+    T *entry;
+    uint32_t NUM_SET, NUM_WAY;
+
+    LLC_TABLE() {
+        entry = NULL;
+        NUM_SET = 0;
+        NUM_WAY = 0;
+    };
+
+    void allocate(uint32_t num_set, uint32_t num_way) {
+        assert(entry == NULL);
+        entry = new T[num_set*num_way]();
+        NUM_SET = num_set;
+        NUM_WAY = num_way;
+    };
+
+    T *operator[](uint32_t set) {
+        return &entry[set*NUM_WAY];
+    };
+
+    size_t bytes() {
+        return (size_t)NUM_SET*NUM_WAY*sizeof(T);
+    };
+};
+
+// tag of an invalid way in the tag array, block addresses never get this large
+#define INVALID_TAG UINT64_MAX
 
 class CACHE : public MEMORY {
   public:
@@ -87,6 +83,7 @@ class CACHE : public MEMORY {
     const uint32_t NUM_SET, NUM_WAY, NUM_LINE, WQ_SIZE, RQ_SIZE, PQ_SIZE, MSHR_SIZE;
     uint32_t LATENCY;
     BLOCK **block;
+    uint64_t *tags; // tag of every way, set by set and 64-byte aligned, INVALID_TAG for invalid ways
     int fill_level;
     uint32_t MAX_READ, MAX_FILL;
     uint8_t cache_type;
@@ -137,11 +134,12 @@ class CACHE : public MEMORY {
     uint64_t total_parallel_loads;
 
     // queues
-    PACKET_QUEUE WQ{NAME + "_WQ", WQ_SIZE}, // write queue
-                 RQ{NAME + "_RQ", RQ_SIZE}, // read queue
-                 PQ{NAME + "_PQ", PQ_SIZE}, // prefetch queue
+    PACKET_QUEUE WQ{NAME + "_WQ", WQ_SIZE, 1}, // write queue
+                 RQ{NAME + "_RQ", RQ_SIZE, 1}, // read queue
+                 PQ{NAME + "_PQ", PQ_SIZE, 1}, // prefetch queue
                  MSHR{NAME + "_MSHR", MSHR_SIZE}, // MSHR
                  PROCESSED{NAME + "_PROCESSED", ROB_SIZE}; // processed queue
+    MSHR_INDEX mshr_table{MSHR_SIZE};
 
     uint64_t sim_access[NUM_CPUS][NUM_TYPES],
              sim_hit[NUM_CPUS][NUM_TYPES],
@@ -151,21 +149,28 @@ class CACHE : public MEMORY {
              roi_miss[NUM_CPUS][NUM_TYPES];
     
     // constructor
-    CACHE(string v1, uint32_t v2, int v3, uint32_t v4, uint32_t v5, uint32_t v6, uint32_t v7, uint32_t v8) 
+    CACHE(string v1, uint32_t v2, uint32_t v3, uint32_t v4, uint32_t v5, uint32_t v6, uint32_t v7, uint32_t v8) 
         : NAME(v1), NUM_SET(v2), NUM_WAY(v3), NUM_LINE(v4), WQ_SIZE(v5), RQ_SIZE(v6), PQ_SIZE(v7), MSHR_SIZE(v8) {
 
         LATENCY = 0;
 
-        // cache block
+        // cache block, all sets in one array
         block = new BLOCK* [NUM_SET];
+        block[0] = new BLOCK[NUM_SET*NUM_WAY];
         for (uint32_t i=0; i<NUM_SET; i++) {
-            block[i] = new BLOCK[NUM_WAY]; 
+            block[i] = block[0] + i*NUM_WAY;
 
             for (uint32_t j=0; j<NUM_WAY; j++) {
                 block[i][j].lru = j;
             }
         }
 
+        // lookups only compare tags, so they scan a few cache lines instead of NUM_WAY blocks
+        size_t tags_size = ((NUM_SET*NUM_WAY*sizeof(uint64_t) + 63) / 64) * 64;
+        tags = (uint64_t *) aligned_alloc(64, tags_size);
+        for (uint32_t i=0; i<NUM_SET*NUM_WAY; i++)
+            tags[i] = INVALID_TAG;
+
         for (uint32_t i=0; i<NUM_CPUS; i++) {
             upper_level_icache[i] = NULL;
             upper_level_dcache[i] = NULL;
@@ -214,9 +219,50 @@ class CACHE : public MEMORY {
 
     // destructor
     ~CACHE() {
-        for (uint32_t i=0; i<NUM_SET; i++)
-            delete[] block[i];
+        delete[] block[0];
         delete[] block;
+        free(tags);
+    };
+
+    // way holding tag in set, NUM_WAY if none, find_way(set, INVALID_TAG) finds an invalid way
+    uint32_t find_way(uint32_t set, uint64_t tag) {
+        const uint64_t *set_tags = tags + set*NUM_WAY;
+        uint32_t way = 0;
+#if defined(__AVX512F__)
+        __m512i key = _mm512_set1_epi64(tag);
+        for (; way < NUM_WAY; way += 8) {
+            __mmask8 ways = (NUM_WAY - way >= 8) ? 0xff : (__mmask8) ((1 << (NUM_WAY - way)) - 1);
+            __mmask8 match = _mm512_mask_cmpeq_epu64_mask(ways, key, _mm512_maskz_loadu_epi64(ways, set_tags + way));
+            if (match)
+                return way + __builtin_ctz(match);
+        }
+        return NUM_WAY;
+#elif defined(__AVX2__)
+        __m256i key = _mm256_set1_epi64x(tag);
+        for (; way + 4 <= NUM_WAY; way += 4) {
+            __m256i match = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) (set_tags + way)), key);
+            int mask = _mm256_movemask_pd(_mm256_castsi256_pd(match));
+            if (mask)
+                return way + __builtin_ctz(mask);
+        }
+#endif
+        for (; way < NUM_WAY; way++) {
+            if (set_tags[way] == tag)
+                return way;
+        }
+        return NUM_WAY;
+    };
+
+    // call after changing valid or tag of a block
+    void update_tag(uint32_t set, uint32_t way) {
+        tags[set*NUM_WAY + way] = block[set][way].valid ? block[set][way].tag : INVALID_TAG;
+    };
+
+    // rebuilds the tag array from the blocks, e.g., after a checkpoint is loaded
+    void update_tags() {
+        for (uint32_t set=0; set<NUM_SET; set++)
+            for (uint32_t way=0; way<NUM_WAY; way++)
+                update_tag(set, way);
     };
 
     // functions
@@ -231,6 +277,8 @@ class CACHE : public MEMORY {
     uint32_t get_occupancy(uint8_t queue_type, uint64_t address),
              get_size(uint8_t queue_type, uint64_t address);
 
+    uint64_t next_event_cycle();
+
     int  check_hit(PACKET *packet),
          invalidate_entry(uint64_t inval_addr),
          check_mshr(PACKET *packet),
@@ -242,7 +290,12 @@ class CACHE : public MEMORY {
          handle_read(),
          handle_prefetch();
 
+    uint64_t functional_access(PACKET *packet);
+    void functional_fill(PACKET *packet),
+         functional_prefetch();
+
     void add_mshr(PACKET *packet),
+         remove_mshr(uint32_t mshr_index),
          update_fill_cycle(),
          llc_initialize_replacement(),
          update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit),
@@ -37,7 +37,10 @@
 #endif
 
 // CPU
+// NUM_CPUS and DRAM_CHANNELS can be set at build time (make num_cpus=4 dram_channels=2)
+#ifndef NUM_CPUS
 #define NUM_CPUS 1
+#endif
 #define CPU_FREQ 4000
 #define DRAM_IO_FREQ 800
 #define PAGE_SIZE 4096
@@ -59,8 +62,10 @@
 #define FILL_DRAM 16
 
 // DRAM
+#ifndef DRAM_CHANNELS
 #define DRAM_CHANNELS 1      // default: assuming one DIMM per one channel 4GB * 1 => 4GB off-chip memory
 #define LOG2_DRAM_CHANNELS 0
+#endif
 #define DRAM_RANKS 8         // 512MB * 8 ranks => 4GB per DIMM
 #define LOG2_DRAM_RANKS 3
 #define DRAM_BANKS 8         // 64MB * 8 banks => 512MB per rank
@@ -83,7 +88,13 @@ extern uint8_t warmup_complete[NUM_CPUS],
                all_simulation_complete,
                MAX_INSTR_DESTINATIONS,
                knob_cloudsuite,
-               knob_low_bandwidth;
+               knob_low_bandwidth,
+               knob_skip_idle,
+               knob_threads,
+               knob_functional_warmup,
+               show_heartbeat;
+
+extern uint64_t sim_quantum;
 
 extern uint64_t current_core_cycle[NUM_CPUS], 
                 stall_cycle[NUM_CPUS], 
@@ -95,7 +106,8 @@ extern queue <uint64_t> page_queue;
 extern map <uint64_t, uint64_t> page_table, inverse_table, recent_page, unique_cl[NUM_CPUS];
 extern uint64_t previous_ppage, num_adjacent_page, num_cl[NUM_CPUS], allocated_pages, num_page[NUM_CPUS], minor_fault[NUM_CPUS], major_fault[NUM_CPUS];
 
-void print_stats();
+void print_stats(),
+     print_simulation_time();
 uint64_t rotl64 (uint64_t n, unsigned int c),
          rotr64 (uint64_t n, unsigned int c),
          va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_vpage);
@@ -118,5 +130,6 @@ class RANDOM {
         return dist(engine);
     };
 };
+extern RANDOM champsim_rand;
 extern uint64_t champsim_seed;
 #endif
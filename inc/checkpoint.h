@@ -0,0 +1,81 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "champsim.h"
+#include <vector>
+
+#define CHECKPOINT_MAGIC   0x54504b4843534843 // "CHSCHKPT"
+#define CHECKPOINT_VERSION 1
+
+// a checkpoint holds the warmed state of the simulated machine: cache/TLB blocks, replacement,
+// prefetcher and branch predictor state, page tables, statistics and the trace position of each core
+// in-flight state (ROB, LSQ, cache queues, MSHRs, DRAM requests) is not saved, so the pipeline
+// refills from the first unretired instruction after a restore
+
+// policy state
+// policies register their globals once from their initialize function
+// sections are matched by name on restore, so a checkpoint taken with one policy can warm up another one
+typedef void (*checkpoint_hook)(FILE *checkpoint_file);
+
+void checkpoint_register(string name, void *data, size_t size),
+     checkpoint_register(string name, checkpoint_hook save, checkpoint_hook load);
+
+void write_checkpoint(const char *file_name),
+     read_checkpoint(const char *file_name);
+
+extern char checkpoint_out[1024];
+extern uint64_t checkpoint_interval;
+
+// SIGINT/SIGTERM with -checkpoint_out, polled between cycles and by the functional warmup and fast-forward loops
+extern volatile sig_atomic_t checkpoint_signal;
+
+// helpers for hooks
+void checkpoint_write(FILE *checkpoint_file, const void *data, size_t size),
+     checkpoint_read(FILE *checkpoint_file, void *data, size_t size);
+
+template <class T>
+void checkpoint_write_vector(FILE *checkpoint_file, const vector<T> &v)
+{
+    uint64_t num = v.size();
+    checkpoint_write(checkpoint_file, &num, sizeof(num));
+    if (num)
+        checkpoint_write(checkpoint_file, v.data(), num*sizeof(T));
+}
+
+template <class T>
+void checkpoint_read_vector(FILE *checkpoint_file, vector<T> &v)
+{
+    uint64_t num;
+    checkpoint_read(checkpoint_file, &num, sizeof(num));
+    v.resize(num);
+    if (num)
+        checkpoint_read(checkpoint_file, v.data(), num*sizeof(T));
+}
+
+template <class K, class V>
+void checkpoint_write_map(FILE *checkpoint_file, const map<K, V> &m)
+{
+    uint64_t num = m.size();
+    checkpoint_write(checkpoint_file, &num, sizeof(num));
+    for (typename map<K, V>::const_iterator it = m.begin(); it != m.end(); ++it) {
+        checkpoint_write(checkpoint_file, &it->first, sizeof(K));
+        checkpoint_write(checkpoint_file, &it->second, sizeof(V));
+    }
+}
+
+template <class K, class V>
+void checkpoint_read_map(FILE *checkpoint_file, map<K, V> &m)
+{
+    uint64_t num;
+    checkpoint_read(checkpoint_file, &num, sizeof(num));
+    m.clear();
+    for (uint64_t i=0; i<num; i++) {
+        K key;
+        V value;
+        checkpoint_read(checkpoint_file, &key, sizeof(K));
+        checkpoint_read(checkpoint_file, &value, sizeof(V));
+        m.insert(m.end(), make_pair(key, value));
+    }
+}
+
+#endif
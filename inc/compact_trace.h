@@ -0,0 +1,65 @@
+#ifndef COMPACT_TRACE_H
+#define COMPACT_TRACE_H
+
+#include "champsim.h"
+#include "instruction.h"
+
+// compact trace format (.ct), written from any gz/xz/zst trace with -convert_trace
+// each record is a flag byte, register and memory presence masks, the registers that are present,
+// and zigzag varint deltas of the ip (against the previous ip) and of every address (against the previous address)
+// records are grouped into chunks of COMPACT_CHUNK_SIZE instructions, each chunk is deflated on its own and
+// starts from zero deltas, so the index of chunk offsets at the end of the file makes any instruction reachable
+#define COMPACT_MAGIC "CHAMPCT1"
+#define COMPACT_CHUNK_SIZE 65536    // instructions per chunk
+#define COMPACT_MAX_RECORD_BYTES 128 // encoded record upper bound: 3 + 8 registers + 9 varints of up to 10 bytes + asid
+#define COMPACT_BRANCH 0x1
+#define COMPACT_TAKEN 0x2
+#define COMPACT_SOURCE_SHIFT 4       // masks hold destinations in bits 0-3 and sources in bits 4-7
+
+extern char convert_trace_out[1024];
+
+class COMPACT_HEADER {
+  public:
+    char magic[8];
+    uint32_t record_size, chunk_size;
+    uint64_t num_instructions, num_chunks, index_offset;
+};
+
+class COMPACT_CHUNK {
+  public:
+    uint64_t offset;
+    uint32_t compressed_size, encoded_size;
+};
+
+// decodes a compact trace back into raw records, used by the trace reader thread
+class COMPACT_TRACE {
+  public:
+    const char *file_name;
+    uint8_t recover, failed; // as in TRACE_DECODER
+    FILE *file;
+    COMPACT_HEADER header;
+    COMPACT_CHUNK *index;
+    uint8_t *compressed, *encoded;
+
+    // current chunk
+    uint64_t next_chunk, encoded_position, chunk_records;
+    uint64_t last_ip, last_address;
+
+    COMPACT_TRACE(const char *name, uint32_t record_size, uint8_t recover = 0);
+    ~COMPACT_TRACE();
+
+    void fail(const char *what),
+         load_chunk(uint64_t chunk),
+         seek(uint64_t instr),
+         decode_record(char *record);
+
+    template <class INSTR> void decode_fields(INSTR *instr);
+
+    // decodes whole records, returns the number of bytes and 0 at the end of the trace
+    uint64_t read(char *data, uint64_t size);
+};
+
+class O3_CPU;
+void convert_trace(O3_CPU *core, const char *file_name);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "champsim.h"
+
+// runtime configuration (-config)
+// one "PARAMETER = value" per line, parameters are named after the sizes in cache.h, ooo_cpu.h, instruction.h and dram_controller.h
+// BRANCH_PREDICTOR, L1D_PREFETCHER, L2C_PREFETCHER and LLC_REPLACEMENT name a policy of a plugins=1 build (policy.h)
+// '#' starts a comment and [section] lines are ignored
+// NUM_CPUS and DRAM_CHANNELS stay compile-time (make num_cpus=... dram_channels=...): policies and statistics size their per-core state with NUM_CPUS
+// LLC replacement policies allocate their per-set state in llc_initialize_replacement() (LLC_TABLE in cache.h)
+void read_config(const char *file_name),
+     check_config();
+
+#endif
@@ -5,12 +5,9 @@
 
 // DRAM configuration
 #define DRAM_CHANNEL_WIDTH 8 // 8B
-#define DRAM_WQ_SIZE 48
-#define DRAM_RQ_SIZE 48
-
-#define tRP_DRAM_CYCLE  11 
-#define tRCD_DRAM_CYCLE 11
-#define tCAS_DRAM_CYCLE 11
+// queue sizes and timings are set at runtime (-config), defaults are in src/dram_controller.cc
+extern uint32_t DRAM_WQ_SIZE, DRAM_RQ_SIZE,
+                tRP_DRAM_CYCLE, tRCD_DRAM_CYCLE, tCAS_DRAM_CYCLE;
 
 // the data bus must wait this amount of time when switching between reads and writes, and vice versa
 #define DRAM_DBUS_TURN_AROUND_TIME ((15*CPU_FREQ)/2000) // 7.5 ns 
@@ -100,7 +97,9 @@ class MEMORY_CONTROLLER : public MEMORY {
              dram_get_column (uint64_t address),
              drc_check_hit (uint64_t address, uint32_t cpu, uint32_t channel, uint32_t rank, uint32_t bank, uint32_t row);
 
-    uint64_t get_bank_earliest_cycle();
+    uint64_t get_bank_earliest_cycle(),
+             next_event_cycle(),
+             next_queue_event(PACKET_QUEUE *queue);
 
     int check_dram_queue(PACKET_QUEUE *queue, PACKET *packet);
 };
@@ -11,6 +11,7 @@ using namespace std;
 #include <set>
 #include <vector>
 #include <map>
+#include "checkpoint.h"
 
 #define NUM_UNIQUE_PC 7
 #define NUM_ISVM 2048
@@ -153,6 +154,20 @@ class GLIDER_PC_PREDICTOR
 		return prediction;
 		
     }
+
+    void save(FILE *checkpoint_file)
+    {
+        checkpoint_write(checkpoint_file, ISVM_TABLE, sizeof(ISVM_TABLE));
+        checkpoint_write_map(checkpoint_file, PCHR);
+        checkpoint_write(checkpoint_file, &access_time, sizeof(access_time));
+    }
+
+    void load(FILE *checkpoint_file)
+    {
+        checkpoint_read(checkpoint_file, ISVM_TABLE, sizeof(ISVM_TABLE));
+        checkpoint_read_map(checkpoint_file, PCHR);
+        checkpoint_read(checkpoint_file, &access_time, sizeof(access_time));
+    }
 };
 
 #endif
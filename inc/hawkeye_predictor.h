@@ -23,6 +23,7 @@ using namespace std;
 #include <set>
 #include <vector>
 #include <map>
+#include "checkpoint.h"
 
 uint64_t CRC( uint64_t _blockAddress )
 {
@@ -66,6 +67,16 @@ class HAWKEYE_PC_PREDICTOR
             return false;
         return true;
     }
+
+    void save(FILE *checkpoint_file)
+    {
+        checkpoint_write_map(checkpoint_file, SHCT);
+    }
+
+    void load(FILE *checkpoint_file)
+    {
+        checkpoint_read_map(checkpoint_file, SHCT);
+    }
 };
 
 #endif
@@ -3,9 +3,9 @@
 
 
 // instruction format
-#define ROB_SIZE 256
-#define LQ_SIZE 72
-#define SQ_SIZE 56
+// ROB, LQ and SQ sizes are set at runtime (-config), up to MAX_ROB_SIZE which sizes the dependency sets
+#define MAX_ROB_SIZE 1024
+extern uint32_t ROB_SIZE, LQ_SIZE, SQ_SIZE;
 #define NUM_INSTR_DESTINATIONS_SPARC 4
 #define NUM_INSTR_DESTINATIONS 2
 #define NUM_INSTR_SOURCES 4
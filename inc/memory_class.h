@@ -35,6 +35,12 @@ class MEMORY {
     virtual uint32_t get_occupancy(uint8_t queue_type, uint64_t address) = 0;
     virtual uint32_t get_size(uint8_t queue_type, uint64_t address) = 0;
 
+    // functional warmup walks down the caches, and the uncore ports of core threads pass it on
+    virtual uint64_t functional_access(PACKET *packet) {
+        assert(0);
+        return 0;
+    };
+
     // stats
     uint64_t ACCESS[NUM_TYPES], HIT[NUM_TYPES], MISS[NUM_TYPES], MSHR_MERGED[NUM_TYPES], STALL[NUM_TYPES];
 
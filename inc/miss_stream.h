@@ -0,0 +1,198 @@
+#ifndef MISS_STREAM_H
+#define MISS_STREAM_H
+
+#include "cache.h"
+
+#include <zlib.h>
+#include <unordered_map>
+
+// miss streams, record the requests one cache level sends to the next and replay them without cores
+// -record_misses <file> writes every request L2C (or the LLC with -record_level LLC) hands to its lower level,
+// -replay_misses <file> feeds them to the LLC and DRAM (or DRAM alone) at the recorded cycles
+// open loop (-replay_mlp 0) issues every request at its recorded cycle, closed loop keeps at most replay_mlp demand reads
+// of a core in flight and delays the rest of its stream by the time it waited, so the recorded gaps between requests are kept
+// the stream is gzip-compressed, each record is a flag byte followed by varints: the cpu, the fill level,
+// and zigzag deltas of the cycle, the address and the ip against the previous record
+#define MISS_STREAM_MAGIC "CHAMPMS1"
+#define MISS_STREAM_BUFFER (64*1024)
+#define MISS_MAX_RECORD_BYTES 64
+
+// flag byte
+#define MISS_RQ 0
+#define MISS_WQ 1
+#define MISS_PQ 2
+#define MISS_MARKER 3
+#define MISS_QUEUE_MASK 0x3
+#define MISS_TYPE_SHIFT 2         // packet type, or the marker kind
+#define MISS_TYPE_MASK 0x3
+#define MISS_INSTRUCTION 0x10
+#define MISS_WARMUP_COMPLETE 0x20 // the core had finished its warmup when the request was sent
+#define MISS_BLOCK_ADDRESS 0x40   // the block address does not follow from full_addr and is stored as well
+
+// markers
+#define MISS_MARK_WARMUP 0  // all cores finished their warmup, finish_warmup() ran
+#define MISS_MARK_ROI_END 1 // the core reached its simulation instructions
+
+extern char record_misses_out[1024], replay_misses_in[1024];
+extern uint32_t record_misses_level;
+extern uint64_t replay_mlp;
+
+class MISS_STREAM_HEADER {
+  public:
+    char magic[8];
+    uint32_t level,    // fill level of the recorded cache, FILL_L2 or FILL_LLC
+             num_cpus;
+};
+
+class MISS_RECORD {
+  public:
+    uint8_t flags, queue, type;
+    uint32_t cpu;
+    int fill_level;
+    uint64_t seq, // requests before this one in the stream
+             cycle, address, full_addr, ip;
+};
+
+// lower_level of the recorded cache, passes everything through and writes down the accepted requests
+class MISS_RECORDER : public MEMORY {
+  public:
+    gzFile file;
+    uint8_t *buffer, *position;
+    uint64_t last_cycle, last_addr, last_ip, num_records;
+
+    MISS_RECORDER() {
+        file = NULL;
+        buffer = NULL;
+        position = NULL;
+        last_cycle = 0;
+        last_addr = 0;
+        last_ip = 0;
+        num_records = 0;
+        lower_level = NULL;
+    };
+
+    void open(const char *file_name, uint32_t level),
+         close(),
+         flush(),
+         record(uint8_t queue, PACKET *packet),
+         mark(uint8_t kind, uint32_t cpu);
+
+    int add_rq(PACKET *packet) {
+        int result = lower_level->add_rq(packet);
+        if (result != -2)
+            record(MISS_RQ, packet);
+        return result;
+    };
+
+    int add_wq(PACKET *packet) {
+        int result = lower_level->add_wq(packet);
+        if (result != -2)
+            record(MISS_WQ, packet);
+        return result;
+    };
+
+    int add_pq(PACKET *packet) {
+        int result = lower_level->add_pq(packet);
+        if (result != -2)
+            record(MISS_PQ, packet);
+        return result;
+    };
+
+    void return_data(PACKET *packet) {
+        assert(0);
+    };
+
+    void operate() {
+    };
+
+    void increment_WQ_FULL(uint64_t address) {
+        lower_level->increment_WQ_FULL(address);
+    };
+
+    uint32_t get_occupancy(uint8_t queue_type, uint64_t address) {
+        return lower_level->get_occupancy(queue_type, address);
+    };
+
+    uint32_t get_size(uint8_t queue_type, uint64_t address) {
+        return lower_level->get_size(queue_type, address);
+    };
+};
+
+extern MISS_RECORDER *miss_recorder;
+
+// demand read of a replayed core waiting for its data
+class MISS_INFLIGHT {
+  public:
+    uint32_t count;       // requests merged into one
+    uint64_t issue_cycle;
+};
+
+// upper level of the replayed cache, stands in for the caches of one core
+class MISS_REPLAY_PORT : public MEMORY {
+  public:
+    uint32_t cpu;
+    unordered_map <uint64_t, MISS_INFLIGHT> inflight; // by block address
+    uint64_t outstanding,
+             issued[NUM_TYPES], returned, total_latency,
+             full_cycles,  // the head request found the queue full
+             mlp_cycles,   // the head request waited for a demand read to return
+             slip,         // closed loop, cycles the stream is behind the recording
+             roi_cycles;
+    uint8_t blocked;       // the head request is due but could not be sent this cycle
+
+    MISS_REPLAY_PORT() {
+        cpu = 0;
+        outstanding = 0;
+        for (uint32_t i=0; i<NUM_TYPES; i++)
+            issued[i] = 0;
+        returned = 0;
+        total_latency = 0;
+        full_cycles = 0;
+        mlp_cycles = 0;
+        slip = 0;
+        roi_cycles = 0;
+        blocked = 0;
+    };
+
+    int add_rq(PACKET *packet) {
+        assert(0);
+        return -2;
+    };
+
+    int add_wq(PACKET *packet) {
+        assert(0);
+        return -2;
+    };
+
+    int add_pq(PACKET *packet) {
+        assert(0);
+        return -2;
+    };
+
+    void return_data(PACKET *packet);
+
+    void operate() {
+    };
+
+    void increment_WQ_FULL(uint64_t address) {
+    };
+
+    uint32_t get_occupancy(uint8_t queue_type, uint64_t address) {
+        return 0;
+    };
+
+    uint32_t get_size(uint8_t queue_type, uint64_t address) {
+        return 0;
+    };
+};
+
+// defined in main.cc
+void reset_cache_stats(uint32_t cpu, CACHE *cache),
+     record_roi_stats(uint32_t cpu, CACHE *cache),
+     print_roi_stats(uint32_t cpu, CACHE *cache),
+     print_dram_stats();
+
+// runs the stream through the uncore, the cores are never simulated
+void replay_misses(const char *file_name);
+
+#endif
@@ -2,6 +2,7 @@
 #define OOO_CPU_H
 
 #include "cache.h"
+#include "trace_reader.h"
 
 #ifdef CRC2_COMPILE
 #define STAT_PRINTING_PERIOD 1000000
@@ -13,18 +14,16 @@
 using namespace std;
 
 // CORE PROCESSOR
-#define FETCH_WIDTH 4
-#define DECODE_WIDTH 4
-#define EXEC_WIDTH 6
-#define LQ_WIDTH 2
-#define SQ_WIDTH 1
-#define RETIRE_WIDTH 4
-#define SCHEDULER_SIZE 100
+// widths are set at runtime (-config), defaults are in src/ooo_cpu.cc
+extern uint32_t FETCH_WIDTH, DECODE_WIDTH, EXEC_WIDTH, LQ_WIDTH, SQ_WIDTH, RETIRE_WIDTH, SCHEDULER_SIZE;
 //#define SCHEDULING_LATENCY 6
 //#define EXEC_LATENCY 1
 
 #define STA_SIZE (ROB_SIZE*NUM_INSTR_DESTINATIONS_SPARC)
 
+// trace records are decoded into ooo_model_instr this many at a time, ahead of handle_branch()
+#define DECODE_BATCH_SIZE 256
+
 extern uint32_t SCHEDULING_LATENCY, EXEC_LATENCY;
 
 // cpu
@@ -33,13 +32,15 @@ class O3_CPU {
     uint32_t cpu;
 
     // trace
-    FILE *trace_file;
+    TRACE_READER trace;
     char trace_string[1024];
-    char gunzip_command[1024];
 
     // instruction
     input_instr current_instr;
     cloudsuite_instr current_cloudsuite_instr;
+    ooo_model_instr decode_buffer[DECODE_BATCH_SIZE];
+    uint32_t decode_head, decode_tail;
+    uint8_t decode_end_of_trace;
     uint64_t instr_unique_id, completed_executions, 
              begin_sim_cycle, begin_sim_instr, 
              last_sim_cycle, last_sim_instr,
@@ -48,25 +49,26 @@ class O3_CPU {
              next_print_instruction, num_retired;
     uint32_t inflight_reg_executions, inflight_mem_executions, num_searched;
     uint32_t next_ITLB_fetch;
+    uint64_t functional_fetch_block;
 
     // reorder buffer, load/store queue, register file
     CORE_BUFFER ROB{"ROB", ROB_SIZE};
     LOAD_STORE_QUEUE LQ{"LQ", LQ_SIZE}, SQ{"SQ", SQ_SIZE};
     
     // store array, this structure is required to properly handle store instructions
-    uint64_t STA[STA_SIZE], STA_head, STA_tail; 
+    uint64_t *STA, STA_head, STA_tail; 
 
     // Ready-To-Execute
-    uint32_t RTE0[ROB_SIZE], RTE0_head, RTE0_tail, 
-             RTE1[ROB_SIZE], RTE1_head, RTE1_tail;  
+    uint32_t *RTE0, RTE0_head, RTE0_tail, 
+             *RTE1, RTE1_head, RTE1_tail;  
 
     // Ready-To-Load
-    uint32_t RTL0[LQ_SIZE], RTL0_head, RTL0_tail, 
-             RTL1[LQ_SIZE], RTL1_head, RTL1_tail;  
+    uint32_t *RTL0, RTL0_head, RTL0_tail, 
+             *RTL1, RTL1_head, RTL1_tail;  
 
     // Ready-To-Store
-    uint32_t RTS0[SQ_SIZE], RTS0_head, RTS0_tail,
-             RTS1[SQ_SIZE], RTS1_head, RTS1_tail;
+    uint32_t *RTS0, RTS0_head, RTS0_tail,
+             *RTS1, RTS1_head, RTS1_tail;
 
     // branch
     int branch_mispredict_stall_fetch; // flag that says that we should stall because a branch prediction was wrong
@@ -86,9 +88,6 @@ class O3_CPU {
     O3_CPU() {
         cpu = 0;
 
-        // trace
-        trace_file = NULL;
-
         // instruction
         instr_unique_id = 0;
         completed_executions = 0;
@@ -98,6 +97,10 @@ class O3_CPU {
         last_sim_instr = 0;
         finish_sim_cycle = 0;
         finish_sim_instr = 0;
+        functional_fetch_block = 0;
+        decode_head = 0;
+        decode_tail = 0;
+        decode_end_of_trace = 0;
         warmup_instructions = 0;
         simulation_instructions = 0;
         instrs_to_read_this_cycle = 0;
@@ -119,11 +122,14 @@ class O3_CPU {
         num_branch = 0;
         branch_mispredictions = 0;
 
+        STA = new uint64_t[STA_SIZE];
         for (uint32_t i=0; i<STA_SIZE; i++)
             STA[i] = UINT64_MAX;
         STA_head = 0;
         STA_tail = 0;
 
+        RTE0 = new uint32_t[ROB_SIZE];
+        RTE1 = new uint32_t[ROB_SIZE];
         for (uint32_t i=0; i<ROB_SIZE; i++) {
             RTE0[i] = ROB_SIZE;
             RTE1[i] = ROB_SIZE;
@@ -133,6 +139,8 @@ class O3_CPU {
         RTE0_tail = 0;
         RTE1_tail = 0;
 
+        RTL0 = new uint32_t[LQ_SIZE];
+        RTL1 = new uint32_t[LQ_SIZE];
         for (uint32_t i=0; i<LQ_SIZE; i++) {
             RTL0[i] = LQ_SIZE;
             RTL1[i] = LQ_SIZE;
@@ -142,6 +150,8 @@ class O3_CPU {
         RTL0_tail = 0;
         RTL1_tail = 0;
 
+        RTS0 = new uint32_t[SQ_SIZE];
+        RTS1 = new uint32_t[SQ_SIZE];
         for (uint32_t i=0; i<SQ_SIZE; i++) {
             RTS0[i] = SQ_SIZE;
             RTS1[i] = SQ_SIZE;
@@ -153,7 +163,8 @@ class O3_CPU {
     }
 
     // functions
-    void handle_branch(),
+    void decode_batch(),
+         handle_branch(),
          fetch_instruction(),
          schedule_instruction(),
          execute_instruction(),
@@ -184,18 +195,27 @@ class O3_CPU {
     void operate_cache();
     void update_rob();
     void retire_rob();
+    uint64_t next_event_cycle();
 
+    ooo_model_instr *next_decoded_instr();
     uint32_t  add_to_rob(ooo_model_instr *arch_instr),
               check_rob(uint64_t instr_id);
 
     uint32_t check_and_add_lsq(uint32_t rob_index);
 
+    void skip_trace(uint64_t num_instr);
+
+    // functional warmup
+    void functional_instruction();
+    uint64_t functional_translate(CACHE *tlb, ooo_model_instr *arch_instr, uint64_t va, uint8_t type),
+             functional_fetch(CACHE *cache, ooo_model_instr *arch_instr, uint64_t pa, uint8_t type);
+
     // branch predictor
     uint8_t predict_branch(uint64_t ip);
     void    initialize_branch_predictor(),
             last_branch_result(uint64_t ip, uint8_t taken); 
 };
 
-extern O3_CPU ooo_cpu[NUM_CPUS];
+extern O3_CPU *ooo_cpu; // allocated once the configuration is known
 
 #endif
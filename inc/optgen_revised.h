@@ -26,6 +26,7 @@ using namespace std;
 #include <math.h>
 #include <set>
 #include <vector>
+#include "checkpoint.h"
 
 struct ADDR_INFO
 {
@@ -133,6 +134,24 @@ struct OPTgen	//
         uint64_t num_opt_misses = demand_access - num_cache;
         return num_opt_misses;
     }
+
+    void save(FILE *checkpoint_file)
+    {
+        checkpoint_write_vector(checkpoint_file, liveness_history);
+        checkpoint_write(checkpoint_file, &num_cache, sizeof(num_cache));
+        checkpoint_write(checkpoint_file, &num_dont_cache, sizeof(num_dont_cache));
+        checkpoint_write(checkpoint_file, &demand_access, sizeof(demand_access));
+        checkpoint_write(checkpoint_file, &prefetch_access, sizeof(prefetch_access));
+    }
+
+    void load(FILE *checkpoint_file)
+    {
+        checkpoint_read_vector(checkpoint_file, liveness_history);
+        checkpoint_read(checkpoint_file, &num_cache, sizeof(num_cache));
+        checkpoint_read(checkpoint_file, &num_dont_cache, sizeof(num_dont_cache));
+        checkpoint_read(checkpoint_file, &demand_access, sizeof(demand_access));
+        checkpoint_read(checkpoint_file, &prefetch_access, sizeof(prefetch_access));
+    }
 };
 
 #endif
@@ -0,0 +1,72 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include "ooo_cpu.h"
+
+// branch predictor, L1D and L2C prefetchers and LLC replacement policy
+// the default build compiles the policies chosen by build_champsim.sh into the binary and calls them directly
+// with plugins=1, every branch/*.bpred, prefetcher/*.l1d_pref, prefetcher/*.l2c_pref and replacement/*.llc_repl
+// is built into bin/policies/<name>.<suffix>.so on its own, and the simulator loads the ones picked with
+// -branch_predictor, -l1d_prefetcher, -l2c_prefetcher and -llc_replacement (or BRANCH_PREDICTOR = ... in a config file)
+// each plugin keeps the file-scope state of its policy to itself, so the policy sources are unchanged
+#define BRANCH_PREDICTOR 0
+#define L1D_PREFETCHER   1
+#define L2C_PREFETCHER   2
+#define LLC_REPLACEMENT  3
+#define NUM_POLICY_KINDS 4
+
+class POLICY_KIND {
+  public:
+    const char *option,    // command line option
+               *parameter, // config file parameter
+               *suffix,    // of the policy sources
+               *entry;     // filled in by the plugin
+    char name[256];        // selected policy, or a path to a plugin
+};
+
+extern POLICY_KIND policy_kinds[NUM_POLICY_KINDS];
+
+// the hooks of a policy, as implemented by the O3_CPU or CACHE member functions of its source file
+class BRANCH_POLICY {
+  public:
+    void (O3_CPU::*initialize)();
+    uint8_t (O3_CPU::*predict)(uint64_t ip);
+    void (O3_CPU::*last_result)(uint64_t ip, uint8_t taken);
+};
+
+class PREFETCH_POLICY {
+  public:
+    void (CACHE::*initialize)();
+    void (CACHE::*operate)(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type);
+    void (CACHE::*cache_fill)(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr);
+    void (CACHE::*final_stats)();
+    void (CACHE::*reset_stats)(); // L2C prefetchers only
+};
+
+class REPLACEMENT_POLICY {
+  public:
+    void (CACHE::*initialize)();
+    uint32_t (CACHE::*find_victim)(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type);
+    void (CACHE::*update_state)(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit);
+    void (CACHE::*final_stats)();
+};
+
+class POLICY_TABLE {
+  public:
+    BRANCH_POLICY branch_predictor;
+    PREFETCH_POLICY l1d_prefetcher, l2c_prefetcher;
+    REPLACEMENT_POLICY llc_replacement;
+};
+
+extern POLICY_TABLE policies;
+
+// a plugin exports one extern "C" function named by POLICY_KIND::entry, which fills in its part of the table
+typedef void (*policy_entry)(POLICY_TABLE *table);
+
+// the kind configured by a config file parameter, -1 if it is not a policy
+int policy_parameter(const char *parameter);
+
+void select_policy(uint32_t kind, const char *name),
+     load_policies();
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "champsim.h"
+
+// host-side self-profiling (-profile N)
+// one simulated cycle in N is timed, each stage is charged its own time (nested stages are excluded)
+// functional warmup and fast-forward are timed in full
+#define PROFILE_MAX_DEPTH 16
+
+#define PROFILE_OTHER 0             // main loop, check_core() and everything outside a stage
+#define PROFILE_HANDLE_BRANCH 1
+#define PROFILE_BRANCH_PREDICTOR 2
+#define PROFILE_FETCH 3
+#define PROFILE_SCHEDULE 4
+#define PROFILE_EXECUTE 5
+#define PROFILE_LSQ 6
+#define PROFILE_UPDATE_ROB 7
+#define PROFILE_RETIRE_ROB 8
+#define PROFILE_DRAM 9
+#define PROFILE_CACHE 10
+
+// per cache type (IS_ITLB ... IS_LLC)
+#define PROFILE_FILL 0
+#define PROFILE_WRITEBACK 1
+#define PROFILE_READ 2
+#define PROFILE_PREFETCH 3
+#define PROFILE_REPLACEMENT 4
+#define PROFILE_PREFETCHER 5
+#define PROFILE_CACHE_STAGES 6
+
+#define PROFILE_CACHE_STAGE(type, stage) (PROFILE_CACHE + (type)*PROFILE_CACHE_STAGES + (stage))
+#define NUM_PROFILE_STAGES (PROFILE_CACHE + 7*PROFILE_CACHE_STAGES)
+
+extern uint64_t profile_period;
+extern uint8_t profile_active; // the current cycle is timed
+
+void profile_push(uint32_t stage),
+     profile_pop(),
+     profile_start(),
+     profile_cycle_begin(),
+     profile_cycle_end(),
+     profile_functional_begin(),
+     profile_functional_end(),
+     print_profile_stats();
+
+inline void profile_enter(uint32_t stage)
+{
+    if (profile_active)
+        profile_push(stage);
+}
+
+inline void profile_exit()
+{
+    if (profile_active)
+        profile_pop();
+}
+
+#endif
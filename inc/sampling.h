@@ -0,0 +1,26 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "champsim.h"
+
+// SMARTS-style periodic sampling (-sample_period)
+// after warmup, every sample_period instructions of each core start with sample_warmup instructions of detailed warmup
+// followed by a sample_size instruction measurement window, then the pipeline and caches are drained
+// and the rest of the period is fast-forwarded with functional warmup
+// the run stops once the confidence intervals of CPI and LLC MPKI are within sample_error of the mean on every core,
+// or when simulation_instructions have been retired
+#define SAMPLE_Z 3.0            // 99.7% confidence
+#define SAMPLE_MIN_SAMPLES 30   // samples needed before the confidence interval is trusted
+
+extern uint64_t sample_period, sample_warmup, sample_size;
+extern double sample_error;
+extern uint8_t sample_drain;    // stops fetching new instructions while the machine drains
+extern uint64_t fast_forward_instr[NUM_CPUS];
+
+// instructions simulated in detail since warmup, the ROI statistics leave out fast-forwarded instructions
+uint64_t detailed_instructions(uint32_t cpu);
+
+void sampling_operate(),
+     print_sampling_stats();
+
+#endif
@@ -12,7 +12,7 @@
 #include <string.h>
 
 #define TYPE	unsigned short int
-#define MAX_SIZE	ROB_SIZE
+#define MAX_SIZE	MAX_ROB_SIZE
 
 // tuned empirically
 
@@ -246,9 +246,10 @@ public:
 };
 
 // this little macro iterates over either the whole set or just the single member
+// n is only known at runtime, so the buffer is sized for the largest set rather than as a variable-length array
 
 #define ITERATE_SET(i,a,n) \
-	TYPE expand_##i[n+1]; \
+	TYPE expand_##i[MAX_SIZE+1]; \
 	int card_##i = (a).expand (expand_##i, n); \
 	for (int count_##i=0, i=expand_##i[0]; count_##i<card_##i; i=expand_##i[++count_##i])
 
@@ -0,0 +1,21 @@
+#ifndef SIMPOINT_H
+#define SIMPOINT_H
+
+#include "champsim.h"
+
+// SimPoint-style phase analysis
+// a fast pass over the trace of CPU 0 collects one basic block vector (BBV) per interval,
+// the vectors are reduced with a random projection and clustered with k-means,
+// and the interval closest to each centroid becomes a simulation point weighted by the size of its cluster
+#define SIMPOINT_DIM 15             // random projection dimensions
+#define SIMPOINT_ITERATIONS 100     // k-means iterations per run
+#define SIMPOINT_SEEDS 5            // k-means runs per k, the one with the lowest distortion is kept
+#define SIMPOINT_BIC_THRESHOLD 0.9  // pick the smallest k whose BIC reaches this fraction of the best score
+
+extern char simpoint_profile_out[1024];
+extern uint64_t simpoint_interval, simpoint_max_k;
+
+class O3_CPU;
+void simpoint_profile(O3_CPU *core, const char *file_name);
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef TRACE_ANALYZER_H
+#define TRACE_ANALYZER_H
+
+#include "champsim.h"
+#include "instruction.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// offline trace characterization (bin/analyze_trace), no timing model
+// the trace is cut into chunks that worker threads analyze on their own, and the chunk results are merged in trace order
+// reuse distances are exact LRU stack distances in cache lines: a worker resolves the reuses inside its chunk,
+// the merge resolves the first access to each line of a chunk against the lines of all earlier chunks
+#define ANALYZER_CHUNK_RECORDS (256*1024) // default records per chunk
+#define ANALYZER_REUSE_BINS 40            // bin i counts distances in [2^(i-1), 2^i), i.e., hits in an LRU of 2^i lines but not of 2^(i-1)
+#define ANALYZER_STRIDE_BINS 8            // the stride bins of CACHE::get_stride_bin, in lines
+#define ANALYZER_BIAS_BINS 6              // share of the more frequent direction: 50-60, 60-70, 70-80, 80-90, 90-99 and 99-100%
+#define ANALYZER_TOP_IPS 10               // default number of load/store IPs reported with their stride distribution
+
+class ANALYZER_MIX {
+  public:
+    uint64_t instructions, branches, taken,
+             loads, stores,         // instructions with at least one source or destination in memory
+             load_ops, store_ops,
+             memory_instructions,
+             others;                // neither a branch nor a memory access
+
+    ANALYZER_MIX() {
+        instructions = 0;
+        branches = 0;
+        taken = 0;
+        loads = 0;
+        stores = 0;
+        load_ops = 0;
+        store_ops = 0;
+        memory_instructions = 0;
+        others = 0;
+    };
+
+    void add(const ANALYZER_MIX &other);
+};
+
+// lines between consecutive accesses of one IP, first and last line join the strides across chunks
+class IP_STRIDE {
+  public:
+    uint64_t first_line, last_line, accesses;
+    uint64_t bin[ANALYZER_STRIDE_BINS];
+
+    IP_STRIDE() {
+        first_line = 0;
+        last_line = 0;
+        accesses = 0;
+        for (uint32_t i=0; i<ANALYZER_STRIDE_BINS; i++)
+            bin[i] = 0;
+    };
+};
+
+class BRANCH_BIAS {
+  public:
+    uint64_t executed, taken;
+
+    BRANCH_BIAS() {
+        executed = 0;
+        taken = 0;
+    };
+};
+
+// a line touched in a chunk, first and last are access numbers within the chunk
+class LINE_REUSE {
+  public:
+    uint64_t line, first, last;
+};
+
+// marks on access numbers, counts the distinct lines accessed after a given access
+class REUSE_TREE {
+  public:
+    vector <uint32_t> count;
+    uint64_t marks;
+
+    void reset(uint64_t size),
+         add(uint64_t position, int32_t delta);
+    uint64_t after(uint64_t position);
+};
+
+class CHUNK_RESULT {
+  public:
+    uint64_t num_accesses;
+    ANALYZER_MIX mix;
+
+    vector <LINE_REUSE> lines; // in order of their first access
+    uint64_t reuse[ANALYZER_REUSE_BINS]; // reuses inside the chunk
+
+    unordered_map <uint64_t, IP_STRIDE> strides;
+    unordered_map <uint64_t, BRANCH_BIAS> branches;
+    unordered_set <uint64_t> data_pages, code_lines, code_pages;
+};
+
+class TRACE_ANALYZER {
+  public:
+    ANALYZER_MIX mix;
+
+    // line -> access number of its last access, the tree is renumbered when it fills up
+    unordered_map <uint64_t, uint64_t> last_access;
+    REUSE_TREE tree;
+    uint64_t next_access, capacity;
+    uint64_t reuse[ANALYZER_REUSE_BINS], cold;
+
+    unordered_map <uint64_t, IP_STRIDE> strides;
+    unordered_map <uint64_t, BRANCH_BIAS> branches;
+    unordered_set <uint64_t> data_pages, code_lines, code_pages;
+
+    TRACE_ANALYZER();
+
+    void compact(uint64_t room),
+         merge(CHUNK_RESULT *chunk),
+         print(const char *trace_name, uint32_t top_ips);
+};
+
+// analyzes num_records records, local_line and local_tree are scratch space of the worker
+template <class INSTR> void analyze_chunk(const INSTR *record, uint64_t num_records, CHUNK_RESULT *result,
+                                          unordered_map <uint64_t, uint64_t> &local_line, REUSE_TREE &local_tree);
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef TRACE_DECODER_H
+#define TRACE_DECODER_H
+
+#include "trace_reader.h"
+#include "compact_trace.h"
+
+#include <zlib.h>
+#include <lzma.h>
+#ifdef ZSTD_TRACE
+#include <zstd.h>
+#endif
+
+#define TRACE_INPUT_SIZE (1024*1024) // compressed bytes read at a time
+
+// one decoder per reader thread (or trace server channel), decode() returns 0 at the end of the trace
+// with recover, a trace that cannot be read sets failed instead of aborting, the trace server goes on serving others
+class TRACE_DECODER {
+  public:
+    uint8_t format;
+    const char *file_name;
+    uint8_t recover, failed;
+
+    gzFile gz_file;
+
+    FILE *input;
+    uint8_t *input_buffer;
+    lzma_stream xz_stream;
+    uint8_t xz_finished;
+    COMPACT_TRACE *compact;
+#ifdef ZSTD_TRACE
+    ZSTD_DStream *zstd_stream;
+    ZSTD_inBuffer zstd_input;
+#endif
+
+    TRACE_DECODER(uint8_t format, const char *file_name, uint32_t record_size, uint64_t start_record, uint8_t recover = 0) : format(format), file_name(file_name), recover(recover) {
+        failed = 0;
+        gz_file = NULL;
+        input = NULL;
+        input_buffer = NULL;
+        xz_stream = LZMA_STREAM_INIT;
+        xz_finished = 0;
+        compact = NULL;
+#ifdef ZSTD_TRACE
+        zstd_stream = NULL;
+#endif
+
+        if (format == TRACE_COMPACT) {
+            compact = new COMPACT_TRACE(file_name, record_size, recover);
+            compact->seek(start_record);
+            failed = compact->failed;
+            return;
+        }
+
+        if (format == TRACE_GZIP) {
+            gz_file = gzopen(file_name, "rb");
+            if (gz_file == NULL) {
+                fail("cannot open");
+                return;
+            }
+            gzbuffer(gz_file, TRACE_INPUT_SIZE);
+            return;
+        }
+
+        input = fopen(file_name, "rb");
+        if (input == NULL) {
+            fail("cannot open");
+            return;
+        }
+        input_buffer = new uint8_t[TRACE_INPUT_SIZE];
+
+        if (format == TRACE_XZ)
+            start_xz();
+#ifdef ZSTD_TRACE
+        if (format == TRACE_ZSTD) {
+            zstd_stream = ZSTD_createDStream();
+            ZSTD_initDStream(zstd_stream);
+            zstd_input.src = input_buffer;
+            zstd_input.size = 0;
+            zstd_input.pos = 0;
+        }
+#endif
+    };
+
+    ~TRACE_DECODER() {
+        delete compact;
+        if (gz_file)
+            gzclose(gz_file);
+        if (format == TRACE_XZ)
+            lzma_end(&xz_stream);
+#ifdef ZSTD_TRACE
+        if (format == TRACE_ZSTD)
+            ZSTD_freeDStream(zstd_stream);
+#endif
+        if (input)
+            fclose(input);
+        delete[] input_buffer;
+    };
+
+    void fail(const char *what) {
+        cerr << "*** Trace " << file_name << ": " << what << " ***" << endl;
+        failed = 1;
+        if (!recover)
+            assert(0);
+    };
+
+    void start_xz() {
+        xz_stream = LZMA_STREAM_INIT;
+        if (lzma_stream_decoder(&xz_stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+            fail("cannot start the xz decoder");
+        xz_finished = 0;
+    };
+
+    uint64_t decode(char *data, uint64_t size) {
+        if (failed)
+            return 0;
+
+        if (format == TRACE_COMPACT) {
+            uint64_t bytes = compact->read(data, size);
+            failed = compact->failed;
+            return bytes;
+        }
+
+        if (format == TRACE_GZIP) {
+            int bytes = gzread(gz_file, data, size);
+            if (bytes < 0) {
+                fail("corrupted gzip data");
+                return 0;
+            }
+            return bytes;
+        }
+
+        if (format == TRACE_XZ) {
+            if (xz_finished)
+                return 0;
+
+            xz_stream.next_out = (uint8_t *)data;
+            xz_stream.avail_out = size;
+            while (xz_stream.avail_out) {
+                if ((xz_stream.avail_in == 0) && !feof(input)) {
+                    xz_stream.next_in = input_buffer;
+                    xz_stream.avail_in = fread(input_buffer, 1, TRACE_INPUT_SIZE, input);
+                }
+
+                lzma_ret ret = lzma_code(&xz_stream, ((xz_stream.avail_in == 0) && feof(input)) ? LZMA_FINISH : LZMA_RUN);
+                if (ret == LZMA_STREAM_END) {
+                    xz_finished = 1;
+                    break;
+                }
+                if (ret != LZMA_OK) {
+                    fail("corrupted xz data");
+                    return 0;
+                }
+            }
+            return size - xz_stream.avail_out;
+        }
+
+#ifdef ZSTD_TRACE
+        if (format == TRACE_ZSTD) {
+            ZSTD_outBuffer output = {data, (size_t)size, 0};
+            while (output.pos < output.size) {
+                if (zstd_input.pos == zstd_input.size) {
+                    zstd_input.size = fread(input_buffer, 1, TRACE_INPUT_SIZE, input);
+                    zstd_input.pos = 0;
+                }
+
+                size_t before = output.pos;
+                size_t ret = ZSTD_decompressStream(zstd_stream, &output, &zstd_input);
+                if (ZSTD_isError(ret)) {
+                    fail(ZSTD_getErrorName(ret));
+                    return 0;
+                }
+                if ((zstd_input.size == 0) && (output.pos == before)) // end of file and nothing left to flush
+                    break;
+            }
+            return output.pos;
+        }
+#endif
+
+        return 0;
+    };
+
+    void rewind() {
+        if (format == TRACE_COMPACT) {
+            compact->seek(0);
+            return;
+        }
+
+        if (format == TRACE_GZIP) {
+            gzrewind(gz_file);
+            return;
+        }
+
+        fseek(input, 0, SEEK_SET);
+        clearerr(input);
+        if (format == TRACE_XZ) {
+            lzma_end(&xz_stream);
+            start_xz();
+        }
+#ifdef ZSTD_TRACE
+        if (format == TRACE_ZSTD) {
+            ZSTD_initDStream(zstd_stream);
+            zstd_input.size = 0;
+            zstd_input.pos = 0;
+        }
+#endif
+    };
+};
+
+#endif
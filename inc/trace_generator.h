@@ -0,0 +1,115 @@
+#ifndef TRACE_GENERATOR_H
+#define TRACE_GENERATOR_H
+
+#include "champsim.h"
+#include "instruction.h"
+
+#include <vector>
+#include <zlib.h>
+
+// synthetic traces (bin/gen_trace) in the input_instr format
+// a trace is a list of phases, each phase runs one kernel loop for a number of instructions,
+// and the whole list can be repeated to get recurring program phases
+// every phase has its own code and data region, so a repeated phase finds its lines and IPs again
+// records come from a seeded mt19937_64 and nothing else, the same command line writes the same trace on every host
+#define GENERATOR_IP_BASE 0x400000
+#define GENERATOR_IP_REGION 0x1000          // code bytes per phase
+#define GENERATOR_DATA_BASE 0x10000000
+#define GENERATOR_DATA_REGION (1ull << 36)  // data bytes per phase, i.e., the largest footprint
+#define GENERATOR_BUFFER_RECORDS 65536
+#define GENERATOR_INSTR_SIZE 4              // bytes between consecutive IPs
+
+#define KERNEL_STREAM 0 // c[i] = a[i] + s*b[i] over three arrays of 8-byte elements
+#define KERNEL_STRIDE 1 // sum of a[i*stride], one IP per load stream
+#define KERNEL_CHASE  2 // p = p->next around a random cycle through every line of the footprint
+#define KERNEL_GATHER 3 // sum of data[index[i]], a sequential index stream and random data loads
+#define KERNEL_BRANCH 4 // if-then blocks whose branches go their usual way with probability bias
+#define NUM_KERNELS 5
+
+// x86 register numbers as written by the Pin tracer
+#define GENERATOR_REG_FLAGS 25
+#define GENERATOR_REG_IP 26
+
+class GENERATOR_PHASE {
+  public:
+    uint8_t kernel;
+    uint64_t instructions,
+             footprint,  // bytes of data the kernel walks over
+             stride,     // bytes between loads of KERNEL_STRIDE
+             streams,    // KERNEL_STRIDE load streams, KERNEL_BRANCH blocks per iteration
+             alu;        // extra ALU instructions per iteration, lowers the memory intensity
+    double bias;
+
+    uint64_t ip_base, data_base;
+
+    // kernel state, kept across repetitions
+    uint64_t position, node;
+    vector <uint32_t> next_node;
+
+    GENERATOR_PHASE() {
+        kernel = KERNEL_STREAM;
+        instructions = 0;
+        footprint = 0;
+        stride = 256;
+        streams = 0;
+        alu = 0;
+        bias = 0.9;
+        ip_base = 0;
+        data_base = 0;
+        position = 0;
+        node = 0;
+    };
+};
+
+class GENERATOR_STATS {
+  public:
+    uint64_t instructions, loads, stores, branches, taken;
+
+    GENERATOR_STATS() {
+        instructions = 0;
+        loads = 0;
+        stores = 0;
+        branches = 0;
+        taken = 0;
+    };
+};
+
+class TRACE_GENERATOR {
+  public:
+    std::mt19937_64 engine;
+    vector <input_instr> buffer;
+    uint64_t buffered, limit;  // records in the buffer, records left in the current phase
+    GENERATOR_STATS stats;
+
+    // output, gz is written in-process, xz and zst go through the command line tools
+    gzFile gz;
+    FILE *pipe;
+    input_instr discard;
+
+    TRACE_GENERATOR(uint64_t seed) : engine(seed) {
+        buffer.resize(GENERATOR_BUFFER_RECORDS);
+        buffered = 0;
+        limit = 0;
+        gz = NULL;
+        pipe = NULL;
+    };
+
+    void open(const char *file_name),
+         close(),
+         flush(),
+         prepare(GENERATOR_PHASE *phase),
+         run(GENERATOR_PHASE *phase),
+         stream(GENERATOR_PHASE *phase),
+         strided(GENERATOR_PHASE *phase),
+         chase(GENERATOR_PHASE *phase),
+         gather(GENERATOR_PHASE *phase),
+         branchy(GENERATOR_PHASE *phase),
+         loop_end(GENERATOR_PHASE *phase, uint64_t ip);
+
+    // the next record, a discarded one once the phase has all its instructions, so kernels always finish their iteration
+    input_instr *emit(uint64_t ip);
+    uint64_t random(uint64_t range);
+    double uniform();
+};
+
+#endif
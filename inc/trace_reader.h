@@ -0,0 +1,148 @@
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include "champsim.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// in-process trace decompression
+// a reader thread per trace decompresses large blocks with zlib/liblzma (and zstd when built with zstd=1)
+// into a ring of blocks, the core copies records straight out of the current block
+// at the end of the trace the reader rewinds the decoder itself, no process is spawned
+// cores that open the same trace file share one reader thread and one ring, each core keeps its own cursor
+#define TRACE_BLOCK_SIZE (1024*1024) // bytes of decompressed trace per block, rounded down to whole records
+#define TRACE_BLOCKS 4               // blocks in flight for a trace read by one core
+#define TRACE_SHARED_BLOCKS 64       // blocks in flight for a shared trace, i.e., how far apart its cores may run
+
+#define TRACE_PIPE 0 // popen() or an inherited pipe, read with fread()
+#define TRACE_GZIP 1
+#define TRACE_XZ   2
+#define TRACE_ZSTD 3
+#define TRACE_COMPACT 4 // see compact_trace.h
+#define TRACE_MAPPED  5 // decompressed copy in the trace cache, mapped read-only
+
+// -trace_cache: every trace is decompressed once into the cache directory, named after a hash of the
+// compressed file, and later runs map the raw records instead of decompressing them again
+#define TRACE_CACHE_MAGIC "CHAMPRAW"
+
+extern char trace_cache_dir[1024];
+
+class TRACE_CACHE_HEADER {
+  public:
+    char magic[8];
+    uint64_t record_size, num_records;
+};
+
+class TRACE_BLOCK {
+  public:
+    char *data;
+    uint64_t size;
+    uint8_t end_of_trace; // the trace wraps around after this block
+};
+
+class TRACE_READER;
+class TRACE_CHANNEL;
+
+// a reader thread and its ring, filled counts blocks and only grows
+// a block is reused once every attached core released it, the thread starts with the first read
+class TRACE_SOURCE {
+  public:
+    char file_name[1024];
+    uint8_t format;
+    uint32_t record_size;
+    uint64_t start_record;
+
+    TRACE_BLOCK *block;
+    uint32_t num_blocks;
+    std::atomic<uint64_t> filled;
+
+    std::atomic<TRACE_READER *> reader[NUM_CPUS]; // cleared when the core leaves
+    uint32_t num_readers;
+    std::atomic<uint32_t> attached_readers;
+
+    std::thread decoder;
+    std::atomic<uint8_t> started, stop;
+    std::mutex start_lock;
+
+    TRACE_SOURCE(const char *name, uint8_t format, uint32_t record_size, uint64_t start_record);
+    ~TRACE_SOURCE();
+
+    void attach(TRACE_READER *trace),
+         start(),
+         read_blocks();
+    uint64_t released();
+};
+
+class TRACE_READER {
+  public:
+    char file_name[1024], command[1024+16];
+    uint8_t format;
+    uint32_t record_size;
+
+    // pipe
+    FILE *pipe;
+
+    // trace cache, the records follow the header
+    char *map;
+    uint64_t map_size, map_records;
+
+    // ring of a trace server (see trace_server.h), released is mirrored into the client slot
+    TRACE_CHANNEL *channel;
+    uint32_t channel_slot;
+    char *channel_data;
+    TRACE_BLOCK channel_block;
+
+    // cursor in the ring of the source, released counts blocks and only grows
+    TRACE_SOURCE *source;
+    std::atomic<uint64_t> released;
+    TRACE_BLOCK *current;
+    uint64_t position;
+
+    // records read since the start of the trace, and records to drop when the source starts behind this core
+    uint64_t record_number, drop_records;
+
+    TRACE_READER() {
+        file_name[0] = '\0';
+        command[0] = '\0';
+        format = TRACE_PIPE;
+        record_size = 0;
+        pipe = NULL;
+
+        map = NULL;
+        map_size = 0;
+        map_records = 0;
+
+        channel = NULL;
+        channel_slot = 0;
+        channel_data = NULL;
+
+        source = NULL;
+        released = 0;
+        current = NULL;
+        position = 0;
+        record_number = 0;
+        drop_records = 0;
+    };
+
+    ~TRACE_READER() {
+        close();
+    };
+
+    void open(const char *name, uint32_t size),
+         open_pipe(FILE *stream, uint32_t size),
+         open_cache(),
+         write_cache(const char *cache_name),
+         close(),
+         detach(uint64_t start_record);
+
+    // copies the next record, returns 0 once at the end of the trace and starts over with the next read
+    uint8_t read(void *record);
+
+    // drops the next records without decoding them, returns 0 if they have to be read instead,
+    // i.e., once the trace is being decoded, unless it is a compact or a cached trace
+    uint8_t skip(uint64_t num_records);
+};
+
+#endif
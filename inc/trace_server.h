@@ -0,0 +1,67 @@
+#ifndef TRACE_SERVER_H
+#define TRACE_SERVER_H
+
+#include "trace_reader.h"
+
+#include <pthread.h>
+
+// cross-process trace sharing
+// champsim -serve_traces <name> decompresses every trace that simulators started with -trace_server <name> ask for
+// once into a ring of blocks in POSIX shared memory, and every core of every simulator reads it at its own pace
+// as with cores of one simulator sharing a trace, a core that gets a whole ring ahead of the slowest one goes on
+// with a decoder of its own, so does every core when the server goes away
+#define TRACE_SERVER_CHANNELS 64 // traces served at once
+#define TRACE_SERVER_CLIENTS 64  // cores reading one channel
+#define TRACE_SERVER_BLOCKS 64   // TRACE_BLOCK_SIZE blocks per channel
+
+#define CHANNEL_FREE 0
+#define CHANNEL_REQUESTED 1
+#define CHANNEL_SERVING 2
+#define CHANNEL_FAILED 3 // e.g., the server is low on memory or cannot read the trace, the client decodes it itself
+
+extern char trace_server_name[256], serve_traces_name[256];
+
+class TRACE_CLIENT {
+  public:
+    std::atomic<int32_t> pid; // 0 for a free slot
+    std::atomic<uint64_t> released;
+};
+
+class TRACE_CHANNEL {
+  public:
+    // a trace is named by its canonical path, and the file behind it must not have changed since the client opened it
+    char file_name[1024];
+    uint64_t device, inode, size, mtime;
+    uint32_t format, record_size;
+    std::atomic<uint32_t> state;
+    uint64_t generation; // names the data segment
+    uint8_t recycled;    // the first block was overwritten, later clients ask for a channel of their own
+
+    // ring, filled counts blocks and only grows
+    std::atomic<uint64_t> filled;
+    uint64_t block_size[TRACE_SERVER_BLOCKS];
+    uint8_t end_of_trace[TRACE_SERVER_BLOCKS];
+
+    TRACE_CLIENT client[TRACE_SERVER_CLIENTS];
+
+    uint64_t released();
+};
+
+// control segment, channels and client slots change hands under the lock
+class TRACE_SERVER_CONTROL {
+  public:
+    pthread_mutex_t lock;
+    int32_t server_pid;
+    uint64_t generation;
+    TRACE_CHANNEL channel[TRACE_SERVER_CHANNELS];
+};
+
+// returns NULL if the trace has to be decoded locally
+TRACE_CHANNEL *attach_channel(const char *file_name, uint8_t format, uint32_t record_size, uint32_t &slot, char *&data);
+void detach_channel(TRACE_CHANNEL *channel, uint32_t slot, char *data);
+uint8_t trace_server_alive();
+
+// runs until SIGINT, SIGTERM or SIGHUP
+void serve_traces(const char *name);
+
+#endif
@@ -21,6 +21,84 @@ class UNCORE {
     UNCORE(); 
 };
 
-extern UNCORE uncore;
+extern UNCORE *uncore;
+
+// shared state (LLC queues, page table) accessed from core threads
+// quantum == 1: cores take turns in cpu order every cycle, so results do not depend on host scheduling
+// quantum > 1: accesses are only serialized by a lock
+// the main thread touches the uncore only while the core threads wait, so only core threads take turns
+void uncore_enter(uint32_t cpu),
+     uncore_exit(uint32_t cpu),
+     uncore_pass(uint32_t cpu),
+     uncore_thread_begin(),
+     uncore_reset_turn();
+
+class UNCORE_LOCK {
+  public:
+    const uint32_t cpu;
+
+    UNCORE_LOCK(uint32_t v1) : cpu(v1) {
+        uncore_enter(cpu);
+    };
+
+    ~UNCORE_LOCK() {
+        uncore_exit(cpu);
+    };
+};
+
+// per-core view of the LLC used as L2C lower_level when cores run on host threads
+class UNCORE_PORT : public MEMORY {
+  public:
+    uint32_t cpu;
+
+    UNCORE_PORT() {
+        cpu = 0;
+        lower_level = NULL;
+    };
+
+    int add_rq(PACKET *packet) {
+        UNCORE_LOCK lock(cpu);
+        return lower_level->add_rq(packet);
+    };
+
+    int add_wq(PACKET *packet) {
+        UNCORE_LOCK lock(cpu);
+        return lower_level->add_wq(packet);
+    };
+
+    int add_pq(PACKET *packet) {
+        UNCORE_LOCK lock(cpu);
+        return lower_level->add_pq(packet);
+    };
+
+    void return_data(PACKET *packet) {
+        assert(0);
+    };
+
+    void operate() {
+    };
+
+    void increment_WQ_FULL(uint64_t address) {
+        UNCORE_LOCK lock(cpu);
+        lower_level->increment_WQ_FULL(address);
+    };
+
+    uint32_t get_occupancy(uint8_t queue_type, uint64_t address) {
+        UNCORE_LOCK lock(cpu);
+        return lower_level->get_occupancy(queue_type, address);
+    };
+
+    uint32_t get_size(uint8_t queue_type, uint64_t address) {
+        UNCORE_LOCK lock(cpu);
+        return lower_level->get_size(queue_type, address);
+    };
+
+    // from the main thread only, e.g., the fast-forward of -sample_period
+    uint64_t functional_access(PACKET *packet) {
+        return lower_level->functional_access(packet);
+    };
+};
+
+extern UNCORE_PORT uncore_port[NUM_CPUS];
 
 #endif
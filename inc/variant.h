@@ -0,0 +1,20 @@
+#ifndef VARIANT_H
+#define VARIANT_H
+
+#include "champsim.h"
+
+// single-pass multi-configuration simulation (-variant)
+// every variant is a config file applied on top of the command line, and runs as its own simulator process
+// the parent decompresses each trace once and fans the raw records out to all variants over pipes,
+// looping the trace like handle_branch() so the variants never see the end of a trace
+#define MAX_VARIANTS 16
+#define VARIANT_BUFFER_SIZE (16*1024*1024) // bytes of trace buffered per core, bounds how far a variant can run ahead
+
+extern char variant_config[MAX_VARIANTS][1024];
+extern uint32_t num_variants;
+extern int variant_trace_fd[NUM_CPUS]; // read end of the trace pipe in a variant, -1 otherwise
+
+// returns only in a variant process, with its config applied and stdout redirected to "${config}.out"
+void variant_fork(int argc, char** argv);
+
+#endif
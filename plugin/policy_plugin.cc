@@ -0,0 +1,39 @@
+// one policy as a plugin (make plugins=1), see inc/policy.h
+// the Makefile builds this file once per policy source, with POLICY_SOURCE naming the source and PLUGIN_KIND its kind
+#include "policy.h"
+#include POLICY_SOURCE
+
+#if PLUGIN_KIND == BRANCH_PREDICTOR
+extern "C" void champsim_branch_predictor(POLICY_TABLE *table)
+{
+    table->branch_predictor.initialize = &O3_CPU::initialize_branch_predictor;
+    table->branch_predictor.predict = &O3_CPU::predict_branch;
+    table->branch_predictor.last_result = &O3_CPU::last_branch_result;
+}
+#elif PLUGIN_KIND == L1D_PREFETCHER
+extern "C" void champsim_l1d_prefetcher(POLICY_TABLE *table)
+{
+    table->l1d_prefetcher.initialize = &CACHE::l1d_prefetcher_initialize;
+    table->l1d_prefetcher.operate = &CACHE::l1d_prefetcher_operate;
+    table->l1d_prefetcher.cache_fill = &CACHE::l1d_prefetcher_cache_fill;
+    table->l1d_prefetcher.final_stats = &CACHE::l1d_prefetcher_final_stats;
+    table->l1d_prefetcher.reset_stats = NULL;
+}
+#elif PLUGIN_KIND == L2C_PREFETCHER
+extern "C" void champsim_l2c_prefetcher(POLICY_TABLE *table)
+{
+    table->l2c_prefetcher.initialize = &CACHE::l2c_prefetcher_initialize;
+    table->l2c_prefetcher.operate = &CACHE::l2c_prefetcher_operate;
+    table->l2c_prefetcher.cache_fill = &CACHE::l2c_prefetcher_cache_fill;
+    table->l2c_prefetcher.final_stats = &CACHE::l2c_prefetcher_final_stats;
+    table->l2c_prefetcher.reset_stats = &CACHE::l2c_prefetcher_reset_stats;
+}
+#elif PLUGIN_KIND == LLC_REPLACEMENT
+extern "C" void champsim_llc_replacement(POLICY_TABLE *table)
+{
+    table->llc_replacement.initialize = &CACHE::llc_initialize_replacement;
+    table->llc_replacement.find_victim = &CACHE::llc_find_victim;
+    table->llc_replacement.update_state = &CACHE::llc_update_replacement_state;
+    table->llc_replacement.final_stats = &CACHE::llc_replacement_final_stats;
+}
+#endif
@@ -9,25 +9,26 @@
 using namespace std;
 
 
-#define NUM_CORE 1
-#define LLC_SETS NUM_CORE*2048
-#define LLC_WAYS 16
+// the LLC geometry is set at runtime (-config), the per-set state is allocated in llc_initialize_replacement()
+#define NUM_CORE NUM_CPUS
+#define LLC_SETS LLC_SET
+#define LLC_WAYS LLC_WAY
 
 //3-bit RRIP counters or all lines
 #define maxRRPV 7
-uint32_t rrpv[LLC_SETS][LLC_WAYS];
+LLC_TABLE <uint32_t> rrpv;
 
 
 #define TIMER_SIZE 1024
-uint64_t perset_mytimer[LLC_SETS];
+vector <uint64_t> perset_mytimer;
 
-uint64_t signatures[LLC_SETS][LLC_WAYS];
+LLC_TABLE <uint64_t> signatures;
 #include "glider_predictor_ver2.h"
 GLIDER_PC_PREDICTOR* glider_predictor;  
 
 #define OPTGEN_VECTOR_SIZE 128
 #include "optgen.h"
-OPTgen perset_optgen[LLC_SETS]; // per-set occupancy vectors; we only use 64 of these
+vector <OPTgen> perset_optgen; // per-set occupancy vectors; we only use 64 of these
 
 #include <math.h>
 #define bitmask(l) (((l) == 64) ? (unsigned long long)(-1LL) : ((1LL << (l))-1LL))
@@ -45,12 +46,41 @@ vector<map<uint64_t, ADDR_INFO> > addr_history; // Sampler
 uint64_t num_of_evictions;
 uint64_t num_of_cache_friendly_evictions;
 
+// checkpoint hooks for the sampler, OPTgen and predictor state
+void glider_ver2_save_state(FILE *checkpoint_file)
+{
+    for (uint32_t i=0; i<LLC_SETS; i++)
+        perset_optgen[i].save(checkpoint_file);
+    for (int i=0; i<SAMPLER_SETS; i++)
+        checkpoint_write_map(checkpoint_file, addr_history[i]);
+    glider_predictor->save(checkpoint_file);
+}
+
+void glider_ver2_load_state(FILE *checkpoint_file)
+{
+    for (uint32_t i=0; i<LLC_SETS; i++)
+        perset_optgen[i].load(checkpoint_file);
+    for (int i=0; i<SAMPLER_SETS; i++)
+        checkpoint_read_map(checkpoint_file, addr_history[i]);
+    glider_predictor->load(checkpoint_file);
+}
+
 // initialize replacement state
 void CACHE::llc_initialize_replacement()
 {
     cout << "---------------------this is glider------------------------" << endl;
-	for (int i=0; i<LLC_SETS; i++) {
-        for (int j=0; j<LLC_WAYS; j++) {
+
+    if (LLC_SETS < 64) {
+        cerr << "*** OPTgen samples 64 sets, it needs at least 64 LLC sets ***" << endl;
+        assert(0);
+    }
+
+    rrpv.allocate(LLC_SETS, LLC_WAYS);
+    signatures.allocate(LLC_SETS, LLC_WAYS);
+    perset_mytimer.resize(LLC_SETS);
+    perset_optgen.resize(LLC_SETS);
+    for (uint32_t i=0; i<LLC_SETS; i++) {
+        for (uint32_t j=0; j<LLC_WAYS; j++) {
             rrpv[i][j] = maxRRPV;
 			signatures[i][j] = 0;
         }
@@ -68,6 +98,11 @@ void CACHE::llc_initialize_replacement()
 
     num_of_evictions = 0;
     num_of_cache_friendly_evictions = 0;
+
+    checkpoint_register("glider_ver2.rrpv", rrpv.entry, rrpv.bytes());
+    checkpoint_register("glider_ver2.perset_mytimer", perset_mytimer.data(), perset_mytimer.size()*sizeof(uint64_t));
+    checkpoint_register("glider_ver2.signatures", signatures.entry, signatures.bytes());
+    checkpoint_register("glider_ver2.tables", glider_ver2_save_state, glider_ver2_load_state);
 }
 
 // find replacement victim
@@ -0,0 +1,29 @@
+TRACE_DIR=/your/trace/directory/
+binary=${1}
+n_warm=${2}
+n_sim=${3}
+quantum=${4}
+shift 4
+
+traces=""
+for trace in "$@"; do
+    traces="${traces} ${TRACE_DIR}/${trace}.trace.gz"
+done
+
+mkdir -p results_parallel
+name=`echo $@ | tr ' ' '-'`
+serial=results_parallel/${name}-${binary}-serial.txt
+parallel=results_parallel/${name}-${binary}-q${quantum}.txt
+
+(./bin/${binary} -warmup_instructions ${n_warm}000000 -simulation_instructions ${n_sim}000000 -traces ${traces}) &> ${serial}
+(./bin/${binary} -warmup_instructions ${n_warm}000000 -simulation_instructions ${n_sim}000000 -threads -quantum ${quantum} -traces ${traces}) &> ${parallel}
+
+# per-CPU IPC error of the threaded run against the serial baseline
+grep "^Finished CPU" ${serial} | sort -n -k3 | sed 's/.*IPC: \([0-9.]*\).*/\1/' > ${serial}.ipc
+grep "^Finished CPU" ${parallel} | sort -n -k3 | sed 's/.*IPC: \([0-9.]*\).*/\1/' > ${parallel}.ipc
+paste ${serial}.ipc ${parallel}.ipc | awk '{ err = ($1 > 0) ? 100*($2-$1)/$1 : 0; if (err < 0) err = -err; sum += err; if (err > max) max = err;
+    printf "CPU %d serial IPC: %s threaded IPC: %s error: %.3f%%\n", NR-1, $1, $2, err }
+    END { if (NR) printf "Mean error: %.3f%% Max error: %.3f%%\n", sum/NR, max }'
+grep "^Finished CPU" ${serial} | tail -1 | sed "s/.*(/(/" | sed 's/^/Serial   /'
+grep "^Finished CPU" ${parallel} | tail -1 | sed "s/.*(/(/" | sed 's/^/Threaded /'
+rm -f ${serial}.ipc ${parallel}.ipc
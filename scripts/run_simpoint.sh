@@ -0,0 +1,67 @@
+TRACE_DIR=/your/trace/directory/
+binary=${1}
+n_warm=${2}
+n_sim=${3}
+max_k=${4}
+trace=${5}
+option=${6}
+
+mkdir -p results_simpoint
+simpoints=results_simpoint/${trace}-${n_sim}M.simpoints
+prefix=results_simpoint/${trace}-${binary}${option}
+
+# phase 1: BBV collection and clustering, the simulation points only depend on the trace and the interval
+if [ ! -f ${simpoints} ]; then
+    (./bin/${binary} -simpoint_profile ${simpoints} -simpoint_interval ${n_sim}000000 -simpoint_max_k ${max_k} -traces ${TRACE_DIR}/${trace}.trace.gz) &> ${simpoints}.log
+fi
+
+# phase 2: fast-forward to every point, warm up over the instructions right before it, simulate one interval
+grep -v "^#" ${simpoints} | while read point weight; do
+    start=$((point * n_sim * 1000000))
+    warm=$((n_warm * 1000000))
+    if [ ${warm} -gt ${start} ]; then
+        warm=${start}
+    fi
+    (./bin/${binary} -skip_instructions $((start - warm)) -warmup_instructions ${warm} -simulation_instructions ${n_sim}000000 ${option} -traces ${TRACE_DIR}/${trace}.trace.gz) &> ${prefix}-${point}.txt
+done
+
+# phase 3: weighted report, IPC is computed from the weighted CPI
+grep -v "^#" ${simpoints} | while read point weight; do
+    echo "${point} ${weight} ${prefix}-${point}.txt"
+done | awk '{
+    point = $1; weight = $2; file = $3; roi = 0; instr = 0
+    while ((getline line < file) > 0) {
+        n = split(line, f)
+        if (line ~ /^CPU 0 Branch Prediction Accuracy/)
+            branch_mpki += weight * f[n]
+        if (line ~ /^Region of Interest Statistics/)
+            roi = 1
+        if (!roi)
+            continue
+        if ((line ~ /^CPU 0 cumulative IPC/) && (f[9] > 0)) {
+            instr = f[7]
+            cpi += weight * f[9] / instr
+            printf "SimPoint %d weight: %s IPC: %s\n", point, weight, f[5]
+        }
+        if ((instr > 0) && (f[2] == "TOTAL")) {
+            if (!(f[1] in apki))
+                cache[num_cache++] = f[1]
+            apki[f[1]] += weight * 1000 * f[4] / instr
+            mpki[f[1]] += weight * 1000 * f[8] / instr
+        }
+    }
+    close(file)
+    if (instr == 0)
+        printf "SimPoint %d did not finish: %s\n", point, file
+    total_weight += weight
+}
+END {
+    if (cpi == 0)
+        exit
+    printf "\nWeighted IPC: %.6f (total weight: %.3f)\n", 1 / cpi, total_weight
+    printf "Weighted branch MPKI: %.4f\n", branch_mpki
+    for (i=0; i<num_cache; i++) {
+        name = cache[i]
+        printf "%-4s weighted APKI: %10.4f MPKI: %10.4f HIT RATE: %8.4f\n", name, apki[name], mpki[name], (apki[name] > 0) ? 100 * (1 - mpki[name] / apki[name]) : 0
+    }
+}' | tee ${prefix}-simpoint.txt
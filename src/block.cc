@@ -1,76 +1,65 @@
 #include "block.h"
 
+#include <vector>
+
+#define DEPEND_SET_CHUNK 256 // sets allocated at once when a pool runs dry
+
+// a pointer, so packets of global objects can still release into the pool after thread_local destructors ran
+static thread_local vector <fastset *> *depend_set_pool = NULL;
+
+fastset *DEPEND_SET::allocate()
+{
+    if (depend_set_pool == NULL)
+        depend_set_pool = new vector <fastset *>;
+
+    if (depend_set_pool->empty()) {
+        fastset *chunk = new fastset[DEPEND_SET_CHUNK];
+        for (uint32_t i=0; i<DEPEND_SET_CHUNK; i++)
+            depend_set_pool->push_back(&chunk[i]);
+    }
+
+    fastset *set = depend_set_pool->back();
+    depend_set_pool->pop_back();
+    *set = fastset();
+
+    return set;
+}
+
+void DEPEND_SET::release(fastset *set)
+{
+    if (depend_set_pool == NULL)
+        depend_set_pool = new vector <fastset *>;
+
+    depend_set_pool->push_back(set);
+}
+
 int PACKET_QUEUE::check_queue(PACKET *packet)
 {
     if ((head == tail) && occupancy == 0)
         return -1;
 
-    if (head < tail) {
-        for (uint32_t i=head; i<tail; i++) {
-            if (NAME == "L1D_WQ") {
-                if (entry[i].full_addr == packet->full_addr) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
-            }
-            else {
-                if (entry[i].address == packet->address) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
-            }
-        }
-    }
+    uint64_t address = match_address(packet);
+    int match = -1;
+    if (index)
+        match = index->find(address);
     else {
-        for (uint32_t i=head; i<SIZE; i++) {
-            if (NAME == "L1D_WQ") {
-                if (entry[i].full_addr == packet->full_addr) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
-            }
-            else {
-                if (entry[i].address == packet->address) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
-            }
-        }
-        for (uint32_t i=0; i<tail; i++) {
-            if (NAME == "L1D_WQ") {
-                if (entry[i].full_addr == packet->full_addr) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
-            }
-            else {
-                if (entry[i].address == packet->address) {
-                    DP (if (warmup_complete[packet->cpu]) {
-                    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
-                    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[i].instr_id << " index: " << i;
-                    cout << " cycle " << packet->event_cycle << endl; });
-                    return i;
-                }
+        for (uint32_t i=head, n=0; n<occupancy; n++) {
+            if (match_address(&entry[i]) == address) {
+                match = i;
+                break;
             }
+            i++;
+            if (i >= SIZE)
+                i = 0;
         }
     }
 
-    return -1;
+    DP (if ((match != -1) && warmup_complete[packet->cpu]) {
+    cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id << " same address: " << hex << packet->address;
+    cout << " full_addr: " << packet->full_addr << dec << " by instr_id: " << entry[match].instr_id << " index: " << match;
+    cout << " cycle " << packet->event_cycle << endl; });
+
+    return match;
 }
 
 void PACKET_QUEUE::add_queue(PACKET *packet)
@@ -82,6 +71,8 @@ void PACKET_QUEUE::add_queue(PACKET *packet)
 
     // add entry
     entry[tail] = *packet;
+    if (index)
+        index->insert(match_address(packet), tail);
 
     DP ( if (warmup_complete[packet->cpu]) {
     cout << "[" << NAME << "] " << __func__ << " cpu: " << packet->cpu << " instr_id: " << packet->instr_id;
@@ -106,6 +97,9 @@ void PACKET_QUEUE::remove_queue(PACKET *packet)
     cout << " address: " << hex << packet->address << " full_addr: " << packet->full_addr << dec << " fill_level: " << packet->fill_level;
     cout << " head: " << head << " tail: " << tail << " occupancy: " << occupancy << " event_cycle: " << packet->event_cycle << endl; });
 
+    if (index)
+        index->erase(match_address(packet), packet - entry);
+
     // reset entry
     PACKET empty_packet;
     *packet = empty_packet;
@@ -115,3 +109,126 @@ void PACKET_QUEUE::remove_queue(PACKET *packet)
     if (head >= SIZE)
         head = 0;
 }
+
+int ADDRESS_INDEX::find(uint64_t address)
+{
+    for (uint32_t slot = hash(address); hash_entry[slot] != UINT32_MAX; slot = (slot+1) & hash_mask) {
+        if (hash_address[slot] == address)
+            return hash_entry[slot];
+    }
+
+    return -1;
+}
+
+void ADDRESS_INDEX::insert(uint64_t address, uint32_t index)
+{
+    uint32_t slot = hash(address);
+    while (hash_entry[slot] != UINT32_MAX)
+        slot = (slot+1) & hash_mask;
+    hash_entry[slot] = index;
+    hash_address[slot] = address;
+}
+
+void ADDRESS_INDEX::erase(uint64_t address, uint32_t index)
+{
+    uint32_t slot = hash(address);
+    while ((hash_entry[slot] != index) || (hash_address[slot] != address)) {
+        if (hash_entry[slot] == UINT32_MAX) {
+            cerr << "*** Entry " << index << " is not indexed under address " << hex << address << dec << " ***" << endl;
+            assert(0);
+        }
+        slot = (slot+1) & hash_mask;
+    }
+
+    // shift back the entries that probed past this slot, so lookups never stop at a hole
+    for (uint32_t next = (slot+1) & hash_mask; hash_entry[next] != UINT32_MAX; next = (next+1) & hash_mask) {
+        uint32_t home = hash(hash_address[next]);
+        if (((next - home) & hash_mask) >= ((next - slot) & hash_mask)) {
+            hash_entry[slot] = hash_entry[next];
+            hash_address[slot] = hash_address[next];
+            slot = next;
+        }
+    }
+    hash_entry[slot] = UINT32_MAX;
+}
+
+uint32_t MSHR_INDEX::allocate(uint64_t address)
+{
+    uint32_t index = SIZE;
+    for (uint32_t i=0; i<(SIZE+63)/64; i++) {
+        if (free_mask[i]) {
+            index = i*64 + __builtin_ctzll(free_mask[i]);
+            free_mask[i] &= free_mask[i] - 1;
+            break;
+        }
+    }
+
+    if (index < SIZE)
+        address_index.insert(address, index);
+
+    return index;
+}
+
+void MSHR_INDEX::release(uint32_t index, uint64_t address)
+{
+    address_index.erase(address, index);
+
+    uint32_t position = heap_position[index];
+    if (position != SIZE) {
+        heap_size--;
+        if (position != heap_size) {
+            heap_swap(position, heap_size);
+            heap_down(position);
+            heap_up(position);
+        }
+        heap_position[index] = SIZE;
+    }
+
+    free_mask[index/64] |= 1ull << (index%64);
+}
+
+void MSHR_INDEX::complete(uint32_t index, uint64_t event_cycle)
+{
+    heap_cycle[index] = event_cycle;
+
+    uint32_t position = heap_position[index];
+    if (position == SIZE) {
+        position = heap_size++;
+        heap[position] = index;
+        heap_position[index] = position;
+    }
+    heap_down(position);
+    heap_up(heap_position[index]);
+}
+
+void MSHR_INDEX::heap_swap(uint32_t i, uint32_t j)
+{
+    uint32_t entry = heap[i];
+    heap[i] = heap[j];
+    heap[j] = entry;
+    heap_position[heap[i]] = i;
+    heap_position[heap[j]] = j;
+}
+
+void MSHR_INDEX::heap_up(uint32_t i)
+{
+    while (i && heap_less(heap[i], heap[(i-1)/2])) {
+        heap_swap(i, (i-1)/2);
+        i = (i-1)/2;
+    }
+}
+
+void MSHR_INDEX::heap_down(uint32_t i)
+{
+    while (1) {
+        uint32_t smallest = i, left = 2*i + 1, right = 2*i + 2;
+        if ((left < heap_size) && heap_less(heap[left], heap[smallest]))
+            smallest = left;
+        if ((right < heap_size) && heap_less(heap[right], heap[smallest]))
+            smallest = right;
+        if (smallest == i)
+            break;
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
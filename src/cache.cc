@@ -3,9 +3,21 @@
 
 #include "ooo_cpu.h"
 #include "uncore.h"
+#include "profiler.h"
 
 uint64_t l2pf_access = 0;
 
+// default cache configuration
+uint32_t ITLB_SET = 16, ITLB_WAY = 4, ITLB_RQ_SIZE = 16, ITLB_WQ_SIZE = 16, ITLB_PQ_SIZE = 0, ITLB_MSHR_SIZE = 8, ITLB_LATENCY = 1,
+         DTLB_SET = 16, DTLB_WAY = 4, DTLB_RQ_SIZE = 16, DTLB_WQ_SIZE = 16, DTLB_PQ_SIZE = 0, DTLB_MSHR_SIZE = 8, DTLB_LATENCY = 1,
+         STLB_SET = 128, STLB_WAY = 12, STLB_RQ_SIZE = 32, STLB_WQ_SIZE = 32, STLB_PQ_SIZE = 0, STLB_MSHR_SIZE = 16, STLB_LATENCY = 8,
+         L1I_SET = 64, L1I_WAY = 8, L1I_RQ_SIZE = 64, L1I_WQ_SIZE = 64, L1I_PQ_SIZE = 64, L1I_MSHR_SIZE = 8, L1I_LATENCY = 1,
+         L1D_SET = 64, L1D_WAY = 8, L1D_RQ_SIZE = 64, L1D_WQ_SIZE = 64, L1D_PQ_SIZE = 64, L1D_MSHR_SIZE = 8, L1D_LATENCY = 4,
+         L2C_SET = 512, L2C_WAY = 8, L2C_RQ_SIZE = 32, L2C_WQ_SIZE = 32, L2C_PQ_SIZE = 32, L2C_MSHR_SIZE = 16, L2C_LATENCY = 8, // 4 (L1I or L1D) + 8 = 12 cycles
+         LLC_SET = NUM_CPUS*2048, LLC_WAY = 16,
+         LLC_RQ_SIZE = 0, LLC_WQ_SIZE = 0, LLC_PQ_SIZE = 0, // 0: NUM_CPUS*L2C_MSHR_SIZE
+         LLC_MSHR_SIZE = 32, LLC_LATENCY = 20; // 4 (L1I or L1D) + 8 + 20 = 32 cycles
+
 void CACHE::handle_fill()
 {
     // handle fill
@@ -24,11 +36,13 @@ void CACHE::handle_fill()
 
         // find victim
         uint32_t set = get_set(MSHR.entry[mshr_index].address), way;
+        profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_REPLACEMENT));
         if (cache_type == IS_LLC) {
             way = llc_find_victim(fill_cpu, MSHR.entry[mshr_index].instr_id, set, block[set], MSHR.entry[mshr_index].ip, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].type);
         }
         else
             way = find_victim(fill_cpu, MSHR.entry[mshr_index].instr_id, set, block[set], MSHR.entry[mshr_index].ip, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].type);
+        profile_exit();
 
         uint8_t  do_fill = 1;
 
@@ -43,7 +57,7 @@ void CACHE::handle_fill()
                     upper_level_dcache[fill_cpu]->return_data(&MSHR.entry[mshr_index]);
             }
 
-            MSHR.remove_queue(&MSHR.entry[mshr_index]);
+            remove_mshr(mshr_index);
             MSHR.num_returned--;
 
             update_fill_cycle();
@@ -90,12 +104,14 @@ void CACHE::handle_fill()
 #ifdef LLC_BYPASS
         if ((cache_type == IS_LLC) && (way == LLC_WAY)) { // this is a bypass that does not fill the LLC
             // update replacement policy
+            profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_REPLACEMENT));
             if (cache_type == IS_LLC) {
                 llc_update_replacement_state(fill_cpu, set, way, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].ip, 0, MSHR.entry[mshr_index].type, 0);
 
             }
             else
                 update_replacement_state(fill_cpu, set, way, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].ip, 0, MSHR.entry[mshr_index].type, 0);
+            profile_exit();
 
             // COLLECT STATS
             sim_miss[fill_cpu][MSHR.entry[mshr_index].type]++;
@@ -110,7 +126,7 @@ void CACHE::handle_fill()
                     upper_level_dcache[fill_cpu]->return_data(&MSHR.entry[mshr_index]);
             }
 
-            MSHR.remove_queue(&MSHR.entry[mshr_index]);
+            remove_mshr(mshr_index);
             MSHR.num_returned--;
 
             update_fill_cycle();
@@ -172,12 +188,15 @@ void CACHE::handle_fill()
 
         if (do_fill) {
             // update prefetcher
+            profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_PREFETCHER));
             if (cache_type == IS_L1D)
                 l1d_prefetcher_cache_fill(MSHR.entry[mshr_index].full_addr, set, way, (MSHR.entry[mshr_index].type == PREFETCH) ? 1 : 0, block[set][way].full_addr);
             if  (cache_type == IS_L2C)
                 l2c_prefetcher_cache_fill(MSHR.entry[mshr_index].full_addr, set, way, (MSHR.entry[mshr_index].type == PREFETCH) ? 1 : 0, block[set][way].full_addr);
+            profile_exit();
 
             // update replacement policy
+            profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_REPLACEMENT));
             if (cache_type == IS_LLC) {
                 llc_update_replacement_state(fill_cpu, set, way, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].ip, block[set][way].full_addr, MSHR.entry[mshr_index].type, 0);
 
@@ -190,6 +209,7 @@ void CACHE::handle_fill()
             }
             else
                 update_replacement_state(fill_cpu, set, way, MSHR.entry[mshr_index].full_addr, MSHR.entry[mshr_index].ip, block[set][way].full_addr, MSHR.entry[mshr_index].type, 0);
+            profile_exit();
 
             // COLLECT STATS
             sim_miss[fill_cpu][MSHR.entry[mshr_index].type]++;
@@ -233,7 +253,7 @@ void CACHE::handle_fill()
                     PROCESSED.add_queue(&MSHR.entry[mshr_index]);
             }
 
-            MSHR.remove_queue(&MSHR.entry[mshr_index]);
+            remove_mshr(mshr_index);
             MSHR.num_returned--;
 
             update_fill_cycle();
@@ -258,12 +278,14 @@ void CACHE::handle_writeback()
         
         if (way >= 0) { // writeback hit (or RFO hit for L1D)
 
+            profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_REPLACEMENT));
             if (cache_type == IS_LLC) {
                 llc_update_replacement_state(writeback_cpu, set, way, block[set][way].full_addr, WQ.entry[index].ip, 0, WQ.entry[index].type, 1);
 
             }
             else
                 update_replacement_state(writeback_cpu, set, way, block[set][way].full_addr, WQ.entry[index].ip, 0, WQ.entry[index].type, 1);
+            profile_exit();
 
             // COLLECT STATS
             sim_hit[writeback_cpu][WQ.entry[index].type]++;
@@ -373,11 +395,13 @@ void CACHE::handle_writeback()
             else {
                 // find victim
                 uint32_t set = get_set(WQ.entry[index].address), way;
+                profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_REPLACEMENT));
                 if (cache_type == IS_LLC) {
                     way = llc_find_victim(writeback_cpu, WQ.entry[index].instr_id, set, block[set], WQ.entry[index].ip, WQ.entry[index].full_addr, WQ.entry[index].type);
                 }
                 else
                     way = find_victim(writeback_cpu, WQ.entry[index].instr_id, set, block[set], WQ.entry[index].ip, WQ.entry[index].full_addr, WQ.entry[index].type);
+                profile_exit();
 
                 uint8_t  do_fill = 1;
 
@@ -477,18 +501,22 @@ void CACHE::handle_writeback()
 
                 if (do_fill) {
                     // update prefetcher
+                    profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_PREFETCHER));
                     if (cache_type == IS_L1D)
                         l1d_prefetcher_cache_fill(WQ.entry[index].full_addr, set, way, 0, block[set][way].full_addr);
                     else if (cache_type == IS_L2C)
                         l2c_prefetcher_cache_fill(WQ.entry[index].full_addr, set, way, 0, block[set][way].full_addr);
+                    profile_exit();
 
                     // update replacement policy
+                    profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_REPLACEMENT));
                     if (cache_type == IS_LLC) {
                         llc_update_replacement_state(writeback_cpu, set, way, WQ.entry[index].full_addr, WQ.entry[index].ip, block[set][way].full_addr, WQ.entry[index].type, 0);
 
                     }
                     else
                         update_replacement_state(writeback_cpu, set, way, WQ.entry[index].full_addr, WQ.entry[index].ip, block[set][way].full_addr, WQ.entry[index].type, 0);
+                    profile_exit();
 
                     // COLLECT STATS
                     sim_miss[writeback_cpu][WQ.entry[index].type]++;
@@ -566,10 +594,12 @@ void CACHE::handle_read()
 
                 // update prefetcher on load instruction
                 if (RQ.entry[index].type == LOAD) {
+                    profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_PREFETCHER));
                     if (cache_type == IS_L1D) 
                         l1d_prefetcher_operate(block[set][way].full_addr, RQ.entry[index].ip, 1, RQ.entry[index].type);
                     else if (cache_type == IS_L2C)
                         l2c_prefetcher_operate(block[set][way].full_addr, RQ.entry[index].ip, 1, RQ.entry[index].type);
+                    profile_exit();
 
                     total_access_count++;
                     uint64_t block_address = RQ.entry[index].address;
@@ -589,12 +619,14 @@ void CACHE::handle_read()
                 }
 
                 // update replacement policy
+                profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_REPLACEMENT));
                 if (cache_type == IS_LLC) {
                     llc_update_replacement_state(read_cpu, set, way, block[set][way].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type, 1);
 
                 }
                 else
                     update_replacement_state(read_cpu, set, way, block[set][way].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type, 1);
+                profile_exit();
 
                 // COLLECT STATS
                 sim_hit[read_cpu][RQ.entry[index].type]++;
@@ -626,6 +658,7 @@ void CACHE::handle_read()
                 // invalidate LLC block on read hit
                 if (cache_type == IS_LLC) {
                     block[set][way].valid = 0;
+                    update_tag(set, way);
                 }
 #endif
             }
@@ -779,10 +812,12 @@ void CACHE::handle_read()
                 if (miss_handled) {
                     // update prefetcher on load instruction
                     if (RQ.entry[index].type == LOAD) {
+                        profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_PREFETCHER));
                         if (cache_type == IS_L1D) 
                             l1d_prefetcher_operate(RQ.entry[index].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type);
                         if (cache_type == IS_L2C)
                             l2c_prefetcher_operate(RQ.entry[index].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type);
+                        profile_exit();
 
                         total_access_count++;
                         uint64_t block_address = RQ.entry[index].address;
@@ -832,12 +867,14 @@ void CACHE::handle_prefetch()
             if (way >= 0) { // prefetch hit
 
                 // update replacement policy
+                profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_REPLACEMENT));
                 if (cache_type == IS_LLC) {
                     llc_update_replacement_state(prefetch_cpu, set, way, block[set][way].full_addr, PQ.entry[index].ip, 0, PQ.entry[index].type, 1);
 
                 }
                 else
                     update_replacement_state(prefetch_cpu, set, way, block[set][way].full_addr, PQ.entry[index].ip, 0, PQ.entry[index].type, 1);
+                profile_exit();
 
                 // COLLECT STATS
                 sim_hit[prefetch_cpu][PQ.entry[index].type]++;
@@ -954,12 +991,165 @@ void CACHE::handle_prefetch()
 
 void CACHE::operate()
 {
+    profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_FILL));
     handle_fill();
+    profile_exit();
+    profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_WRITEBACK));
     handle_writeback();
+    profile_exit();
+    profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_READ));
     handle_read();
+    profile_exit();
 
-    if (PQ.occupancy && (RQ.occupancy == 0))
+    if (PQ.occupancy && (RQ.occupancy == 0)) {
+        profile_enter(PROFILE_CACHE_STAGE(cache_type, PROFILE_PREFETCH));
         handle_prefetch();
+        profile_exit();
+    }
+}
+
+// functional warmup: zero-latency access that walks down the hierarchy on a miss and fills on the way back
+// replacement and prefetcher hooks are called as in the timing model, but no queue or MSHR is used
+uint64_t CACHE::functional_access(PACKET *packet)
+{
+    uint32_t access_cpu = packet->cpu;
+    uint32_t set = get_set(packet->address);
+    int way = check_hit(packet);
+
+    if (way >= 0) { // hit
+
+        // update prefetcher on load instruction
+        if (packet->type == LOAD) {
+            if (cache_type == IS_L1D)
+                l1d_prefetcher_operate(block[set][way].full_addr, packet->ip, 1, packet->type);
+            else if (cache_type == IS_L2C)
+                l2c_prefetcher_operate(block[set][way].full_addr, packet->ip, 1, packet->type);
+        }
+
+        // update replacement policy
+        if (cache_type == IS_LLC)
+            llc_update_replacement_state(access_cpu, set, way, block[set][way].full_addr, packet->ip, 0, packet->type, 1);
+        else
+            update_replacement_state(access_cpu, set, way, block[set][way].full_addr, packet->ip, 0, packet->type, 1);
+
+        // COLLECT STATS, the ROI statistics (sim_*) only cover detailed simulation
+        HIT[packet->type]++;
+        ACCESS[packet->type]++;
+
+        // update prefetch stats and reset prefetch bit
+        if (packet->type != PREFETCH) {
+            if (block[set][way].prefetch) {
+                pf_useful++;
+                block[set][way].prefetch = 0;
+            }
+            block[set][way].used = 1;
+        }
+
+        // RFO and writeback mark cache line dirty
+        if (((cache_type == IS_L1D) && (packet->type == RFO)) || (packet->type == WRITEBACK))
+            block[set][way].dirty = 1;
+
+        packet->data = block[set][way].data;
+        functional_prefetch();
+
+        return packet->data;
+    }
+
+    // miss, writebacks below L1D are filled directly as in handle_writeback()
+    if (packet->type != WRITEBACK) {
+        if (cache_type == IS_STLB) {
+            // the clock stands still in functional mode, so the page fault must not stall the core once detailed simulation resumes
+            uint64_t stall = stall_cycle[access_cpu];
+            packet->data = va_to_pa(access_cpu, packet->instr_id, packet->full_addr, packet->address) >> LOG2_PAGE_SIZE;
+            stall_cycle[access_cpu] = stall;
+        }
+        else if (lower_level && (cache_type != IS_LLC)) // DRAM has no state to warm
+            lower_level->functional_access(packet);
+    }
+
+    // update prefetcher on load instruction
+    if (packet->type == LOAD) {
+        if (cache_type == IS_L1D)
+            l1d_prefetcher_operate(packet->full_addr, packet->ip, 0, packet->type);
+        else if (cache_type == IS_L2C)
+            l2c_prefetcher_operate(packet->full_addr, packet->ip, 0, packet->type);
+    }
+
+    MISS[packet->type]++;
+    ACCESS[packet->type]++;
+
+    // prefetches may be destined to a lower level only
+    if (packet->fill_level <= fill_level)
+        functional_fill(packet);
+
+    functional_prefetch();
+
+    return packet->data;
+}
+
+void CACHE::functional_fill(PACKET *packet)
+{
+    uint32_t fill_cpu = packet->cpu;
+
+    // find victim
+    uint32_t set = get_set(packet->address), way;
+    if (cache_type == IS_LLC)
+        way = llc_find_victim(fill_cpu, packet->instr_id, set, block[set], packet->ip, packet->full_addr, packet->type);
+    else
+        way = find_victim(fill_cpu, packet->instr_id, set, block[set], packet->ip, packet->full_addr, packet->type);
+
+#ifdef LLC_BYPASS
+    if ((cache_type == IS_LLC) && (way == LLC_WAY)) { // this is a bypass that does not fill the LLC
+        llc_update_replacement_state(fill_cpu, set, way, packet->full_addr, packet->ip, 0, packet->type, 0);
+
+        return;
+    }
+#endif
+
+    // write back the dirty victim
+    if (block[set][way].valid && block[set][way].dirty && lower_level && (cache_type != IS_LLC)) {
+        PACKET writeback_packet;
+
+        writeback_packet.fill_level = fill_level << 1;
+        writeback_packet.cpu = fill_cpu;
+        writeback_packet.address = block[set][way].address;
+        writeback_packet.full_addr = block[set][way].full_addr;
+        writeback_packet.data = block[set][way].data;
+        writeback_packet.instr_id = packet->instr_id;
+        writeback_packet.ip = 0; // writeback does not have ip
+        writeback_packet.type = WRITEBACK;
+
+        lower_level->functional_access(&writeback_packet);
+    }
+
+    // update prefetcher
+    if (cache_type == IS_L1D)
+        l1d_prefetcher_cache_fill(packet->full_addr, set, way, (packet->type == PREFETCH) ? 1 : 0, block[set][way].full_addr);
+    if  (cache_type == IS_L2C)
+        l2c_prefetcher_cache_fill(packet->full_addr, set, way, (packet->type == PREFETCH) ? 1 : 0, block[set][way].full_addr);
+
+    // update replacement policy
+    if (cache_type == IS_LLC)
+        llc_update_replacement_state(fill_cpu, set, way, packet->full_addr, packet->ip, block[set][way].full_addr, packet->type, 0);
+    else
+        update_replacement_state(fill_cpu, set, way, packet->full_addr, packet->ip, block[set][way].full_addr, packet->type, 0);
+
+    fill_cache(set, way, packet);
+
+    // RFO and writeback mark cache line dirty
+    if (((cache_type == IS_L1D) && (packet->type == RFO)) || (packet->type == WRITEBACK))
+        block[set][way].dirty = 1;
+}
+
+// issue the prefetches generated by functional accesses right away
+void CACHE::functional_prefetch()
+{
+    while (PQ.occupancy) {
+        PACKET pf_packet = PQ.entry[PQ.head];
+        PQ.remove_queue(&PQ.entry[PQ.head]);
+
+        functional_access(&pf_packet);
+    }
 }
 
 uint32_t CACHE::get_set(uint64_t address)
@@ -969,12 +1159,7 @@ uint32_t CACHE::get_set(uint64_t address)
 
 uint32_t CACHE::get_way(uint64_t address, uint32_t set)
 {
-    for (uint32_t way=0; way<NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == address)) 
-            return way;
-    }
-
-    return NUM_WAY;
+    return find_way(set, address);
 }
 
 void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet)
@@ -1018,6 +1203,7 @@ void CACHE::fill_cache(uint32_t set, uint32_t way, PACKET *packet)
     block[set][way].data = packet->data;
     block[set][way].cpu = packet->cpu;
     block[set][way].instr_id = packet->instr_id;
+    update_tag(set, way);
 
     DP ( if (warmup_complete[packet->cpu]) {
     cout << "[" << NAME << "] " << __func__ << " set: " << set << " way: " << way;
@@ -1038,19 +1224,16 @@ int CACHE::check_hit(PACKET *packet)
     }
 
     // hit
-    for (uint32_t way=0; way<NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == packet->address)) {
-
-            match_way = way;
+    uint32_t way = find_way(set, packet->address);
+    if (way < NUM_WAY) {
 
-            DP ( if (warmup_complete[packet->cpu]) {
-            cout << "[" << NAME << "] " << __func__ << " instr_id: " << packet->instr_id << " type: " << +packet->type << hex << " addr: " << packet->address;
-            cout << " full_addr: " << packet->full_addr << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
-            cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru;
-            cout << " event: " << packet->event_cycle << " cycle: " << current_core_cycle[cpu] << endl; });
+        match_way = way;
 
-            break;
-        }
+        DP ( if (warmup_complete[packet->cpu]) {
+        cout << "[" << NAME << "] " << __func__ << " instr_id: " << packet->instr_id << " type: " << +packet->type << hex << " addr: " << packet->address;
+        cout << " full_addr: " << packet->full_addr << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
+        cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru;
+        cout << " event: " << packet->event_cycle << " cycle: " << current_core_cycle[cpu] << endl; });
     }
 
     return match_way;
@@ -1068,20 +1251,18 @@ int CACHE::invalidate_entry(uint64_t inval_addr)
     }
 
     // invalidate
-    for (uint32_t way=0; way<NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == inval_addr)) {
+    uint32_t way = find_way(set, inval_addr);
+    if (way < NUM_WAY) {
 
-            block[set][way].valid = 0;
+        block[set][way].valid = 0;
+        update_tag(set, way);
 
-            match_way = way;
+        match_way = way;
 
-            DP ( if (warmup_complete[cpu]) {
-            cout << "[" << NAME << "] " << __func__ << " inval_addr: " << hex << inval_addr;  
-            cout << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
-            cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru << " cycle: " << current_core_cycle[cpu] << endl; });
-
-            break;
-        }
+        DP ( if (warmup_complete[cpu]) {
+        cout << "[" << NAME << "] " << __func__ << " inval_addr: " << hex << inval_addr;  
+        cout << " tag: " << block[set][way].tag << " data: " << block[set][way].data << dec;
+        cout << " set: " << set << " way: " << way << " lru: " << block[set][way].lru << " cycle: " << current_core_cycle[cpu] << endl; });
     }
 
     return match_way;
@@ -1189,7 +1370,7 @@ int CACHE::add_rq(PACKET *packet)
     }
 #endif
 
-    RQ.entry[index] = *packet;
+    RQ.add_queue(packet);
 
     // ADD LATENCY
     if (RQ.entry[index].event_cycle < current_core_cycle[packet->cpu])
@@ -1197,11 +1378,6 @@ int CACHE::add_rq(PACKET *packet)
     else
         RQ.entry[index].event_cycle += LATENCY;
 
-    RQ.occupancy++;
-    RQ.tail++;
-    if (RQ.tail >= RQ.SIZE)
-        RQ.tail = 0;
-
     DP ( if (warmup_complete[RQ.entry[index].cpu]) {
     cout << "[" << NAME << "_RQ] " <<  __func__ << " instr_id: " << RQ.entry[index].instr_id << " address: " << hex << RQ.entry[index].address;
     cout << " full_addr: " << RQ.entry[index].full_addr << dec;
@@ -1242,7 +1418,7 @@ int CACHE::add_wq(PACKET *packet)
         assert(0);
     }
 
-    WQ.entry[index] = *packet;
+    WQ.add_queue(packet);
 
     // ADD LATENCY
     if (WQ.entry[index].event_cycle < current_core_cycle[packet->cpu])
@@ -1250,11 +1426,6 @@ int CACHE::add_wq(PACKET *packet)
     else
         WQ.entry[index].event_cycle += LATENCY;
 
-    WQ.occupancy++;
-    WQ.tail++;
-    if (WQ.tail >= WQ.SIZE)
-        WQ.tail = 0;
-
     DP (if (warmup_complete[WQ.entry[index].cpu]) {
     cout << "[" << NAME << "_WQ] " <<  __func__ << " instr_id: " << WQ.entry[index].instr_id << " address: " << hex << WQ.entry[index].address;
     cout << " full_addr: " << WQ.entry[index].full_addr << dec;
@@ -1392,7 +1563,7 @@ int CACHE::add_pq(PACKET *packet)
     }
 #endif
 
-    PQ.entry[index] = *packet;
+    PQ.add_queue(packet);
 
     // ADD LATENCY
     if (PQ.entry[index].event_cycle < current_core_cycle[packet->cpu])
@@ -1400,11 +1571,6 @@ int CACHE::add_pq(PACKET *packet)
     else
         PQ.entry[index].event_cycle += LATENCY;
 
-    PQ.occupancy++;
-    PQ.tail++;
-    if (PQ.tail >= PQ.SIZE)
-        PQ.tail = 0;
-
     DP ( if (warmup_complete[PQ.entry[index].cpu]) {
     cout << "[" << NAME << "_PQ] " <<  __func__ << " instr_id: " << PQ.entry[index].instr_id << " address: " << hex << PQ.entry[index].address;
     cout << " full_addr: " << PQ.entry[index].full_addr << dec;
@@ -1446,6 +1612,7 @@ void CACHE::return_data(PACKET *packet)
     else
         MSHR.entry[mshr_index].event_cycle += LATENCY;
 
+    mshr_table.complete(mshr_index, MSHR.entry[mshr_index].event_cycle);
     update_fill_cycle();
 
     DP (if (warmup_complete[packet->cpu]) {
@@ -1459,23 +1626,8 @@ void CACHE::return_data(PACKET *packet)
 void CACHE::update_fill_cycle()
 {
     // update next_fill_cycle
-    uint64_t min_cycle = UINT64_MAX;
-    uint32_t min_index = MSHR.SIZE;
-    for (uint32_t i=0; i<MSHR.SIZE; i++) {
-        if ((MSHR.entry[i].returned == COMPLETED) && (MSHR.entry[i].event_cycle < min_cycle)) {
-            min_cycle = MSHR.entry[i].event_cycle;
-            min_index = i;
-        }
-
-        DP (if (warmup_complete[MSHR.entry[i].cpu]) {
-        cout << "[" << NAME << "_MSHR] " <<  __func__ << " checking instr_id: " << MSHR.entry[i].instr_id;
-        cout << " address: " << hex << MSHR.entry[i].address << " full_addr: " << MSHR.entry[i].full_addr;
-        cout << " data: " << MSHR.entry[i].data << dec << " returned: " << +MSHR.entry[i].returned << " fill_level: " << MSHR.entry[i].fill_level;
-        cout << " index: " << i << " occupancy: " << MSHR.occupancy;
-        cout << " event: " << MSHR.entry[i].event_cycle << " current: " << current_core_cycle[MSHR.entry[i].cpu] << " next: " << MSHR.next_fill_cycle << endl; });
-    }
-    
-    MSHR.next_fill_cycle = min_cycle;
+    uint32_t min_index = mshr_table.next_fill();
+    MSHR.next_fill_cycle = (min_index < MSHR.SIZE) ? MSHR.entry[min_index].event_cycle : UINT64_MAX;
     MSHR.next_fill_index = min_index;
     if (min_index < MSHR.SIZE) {
 
@@ -1490,16 +1642,15 @@ void CACHE::update_fill_cycle()
 int CACHE::check_mshr(PACKET *packet)
 {
     // search mshr
-    for (uint32_t index=0; index<MSHR_SIZE; index++) {
-        if (MSHR.entry[index].address == packet->address) {
-            
-            DP ( if (warmup_complete[packet->cpu]) {
-            cout << "[" << NAME << "_MSHR] " << __func__ << " same entry instr_id: " << packet->instr_id << " prior_id: " << MSHR.entry[index].instr_id;
-            cout << " address: " << hex << packet->address;
-            cout << " full_addr: " << packet->full_addr << dec << endl; });
+    int index = mshr_table.find(packet->address);
+    if (index != -1) {
 
-            return index;
-        }
+        DP ( if (warmup_complete[packet->cpu]) {
+        cout << "[" << NAME << "_MSHR] " << __func__ << " same entry instr_id: " << packet->instr_id << " prior_id: " << MSHR.entry[index].instr_id;
+        cout << " address: " << hex << packet->address;
+        cout << " full_addr: " << packet->full_addr << dec << endl; });
+
+        return index;
     }
 
     DP ( if (warmup_complete[packet->cpu]) {
@@ -1518,24 +1669,24 @@ int CACHE::check_mshr(PACKET *packet)
 
 void CACHE::add_mshr(PACKET *packet)
 {
-    uint32_t index = 0;
+    uint32_t index = mshr_table.allocate(packet->address);
+    if (index == MSHR_SIZE)
+        return;
 
-    // search mshr
-    for (index=0; index<MSHR_SIZE; index++) {
-        if (MSHR.entry[index].address == 0) {
-            
-            MSHR.entry[index] = *packet;
-            MSHR.entry[index].returned = INFLIGHT;
-            MSHR.occupancy++;
+    MSHR.entry[index] = *packet;
+    MSHR.entry[index].returned = INFLIGHT;
+    MSHR.occupancy++;
 
-            DP ( if (warmup_complete[packet->cpu]) {
-            cout << "[" << NAME << "_MSHR] " << __func__ << " instr_id: " << packet->instr_id;
-            cout << " address: " << hex << packet->address << " full_addr: " << packet->full_addr << dec;
-            cout << " index: " << index << " occupancy: " << MSHR.occupancy << endl; });
+    DP ( if (warmup_complete[packet->cpu]) {
+    cout << "[" << NAME << "_MSHR] " << __func__ << " instr_id: " << packet->instr_id;
+    cout << " address: " << hex << packet->address << " full_addr: " << packet->full_addr << dec;
+    cout << " index: " << index << " occupancy: " << MSHR.occupancy << endl; });
+}
 
-            break;
-        }
-    }
+void CACHE::remove_mshr(uint32_t mshr_index)
+{
+    mshr_table.release(mshr_index, MSHR.entry[mshr_index].address);
+    MSHR.remove_queue(&MSHR.entry[mshr_index]);
 }
 
 uint32_t CACHE::get_occupancy(uint8_t queue_type, uint64_t address)
@@ -1566,6 +1717,27 @@ uint32_t CACHE::get_size(uint8_t queue_type, uint64_t address)
     return 0;
 }
 
+uint64_t CACHE::next_event_cycle()
+{
+    // earliest cycle at which operate() can do any work
+    // only the queue heads matter since every queue is handled in order
+    uint64_t next_cycle = UINT64_MAX;
+
+    if ((MSHR.next_fill_index < MSHR_SIZE) && (MSHR.next_fill_cycle < next_cycle))
+        next_cycle = MSHR.next_fill_cycle;
+
+    if (WQ.occupancy && (WQ.entry[WQ.head].event_cycle < next_cycle))
+        next_cycle = WQ.entry[WQ.head].event_cycle;
+
+    if (RQ.occupancy && (RQ.entry[RQ.head].event_cycle < next_cycle))
+        next_cycle = RQ.entry[RQ.head].event_cycle;
+
+    if (PQ.occupancy && (PQ.entry[PQ.head].event_cycle < next_cycle))
+        next_cycle = PQ.entry[PQ.head].event_cycle;
+
+    return next_cycle;
+}
+
 void CACHE::increment_WQ_FULL(uint64_t address)
 {
     WQ.FULL++;
@@ -1578,12 +1750,7 @@ void CACHE::back_invalidate(uint64_t address)
     int data_cache = FILL_DRAM;
 
     // get set and way
-    uint32_t set = get_set(address), way;
-    for (way = 0; way < NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == address)) {
-            break;
-        }
-    }
+    uint32_t set = get_set(address), way = find_way(set, address);
 
     if (cache_type == IS_LLC) {
         // invalidate the block in all higher cache levels of all CPUs and fetch the latest data
@@ -1631,20 +1798,17 @@ uint8_t CACHE::invalidate_and_return_data(uint32_t cpu, uint64_t address, uint64
     }
 
     uint8_t dirty = 0;
-    uint32_t set = get_set(address), way;
+    uint32_t set = get_set(address), way = find_way(set, address);
 
     // invalidate the block and record its data and fill level if it is dirty
-    for (way = 0; way < NUM_WAY; way++) {
-        if (block[set][way].valid && (block[set][way].tag == address)) {
-            block[set][way].valid = 0;
-
-            if (block[set][way].dirty && !upper_level_dirty && (fill_level <= *data_cache)) {
-                dirty = 1;
-                *data = block[set][way].data;
-                *data_cache = fill_level;
-            }
-
-            break;
+    if (way < NUM_WAY) {
+        block[set][way].valid = 0;
+        update_tag(set, way);
+
+        if (block[set][way].dirty && !upper_level_dirty && (fill_level <= *data_cache)) {
+            dirty = 1;
+            *data = block[set][way].data;
+            *data_cache = fill_level;
         }
     }
 
@@ -1665,13 +1829,11 @@ uint8_t CACHE::higher_level_dirty(uint64_t address)
             }
         }
 
-        uint32_t set = get_set(address), way;
+        uint32_t set = get_set(address), way = find_way(set, address);
 
         // check if the block is dirty
-        for (way = 0; way < NUM_WAY; way++) {
-            if (block[set][way].valid && (block[set][way].tag == address)) {
-                return block[set][way].dirty;
-            }
+        if (way < NUM_WAY) {
+            return block[set][way].dirty;
         }
     }
 
@@ -1687,13 +1849,11 @@ uint8_t CACHE::higher_level_dirty(uint64_t address)
             return 1;
         }
 
-        uint32_t set = get_set(address), way;
+        uint32_t set = get_set(address), way = find_way(set, address);
 
         // check if the block is dirty
-        for (way = 0; way < NUM_WAY; way++) {
-            if (block[set][way].valid && (block[set][way].tag == address)) {
-                return block[set][way].dirty;
-            }
+        if (way < NUM_WAY) {
+            return block[set][way].dirty;
         }
     }
 
@@ -1878,14 +2038,14 @@ void CACHE::check_inclusive()
     {
         //cout<<"1";
         //L1I data should be present L2C
-        for (int l1iset = 0; l1iset < L1I_SET; l1iset++)
-            for (int l1iway = 0; l1iway < L1I_WAY; l1iway++)
+        for (uint32_t l1iset = 0; l1iset < L1I_SET; l1iset++)
+            for (uint32_t l1iway = 0; l1iway < L1I_WAY; l1iway++)
                 if (ooo_cpu[i].L1I.block[l1iset][l1iway].valid == 1)
                 {
                     //cout<<"2";
                     int match = 0;
-                    for (int l2cset = 0; l2cset < L2C_SET; l2cset++)
-                        for (int l2cway = 0; l2cway < L2C_WAY; l2cway++)
+                    for (uint32_t l2cset = 0; l2cset < L2C_SET; l2cset++)
+                        for (uint32_t l2cway = 0; l2cway < L2C_WAY; l2cway++)
                         {
                             if (ooo_cpu[i].L2C.block[l2cset][l2cway].tag == ooo_cpu[i].L1I.block[l1iset][l1iway].tag &&
                                 ooo_cpu[i].L2C.block[l2cset][l2cway].full_addr == ooo_cpu[i].L1I.block[l1iset][l1iway].full_addr &&
@@ -1902,14 +2062,14 @@ void CACHE::check_inclusive()
                     }
                 }
         //L1D data should be present L2C
-        for (int l1dset = 0; l1dset < L1D_SET; l1dset++)
-            for (int l1dway = 0; l1dway < L1D_WAY; l1dway++)
+        for (uint32_t l1dset = 0; l1dset < L1D_SET; l1dset++)
+            for (uint32_t l1dway = 0; l1dway < L1D_WAY; l1dway++)
                 if (ooo_cpu[i].L1D.block[l1dset][l1dway].valid == 1)
                 {
                     //cout<<"4";
                     int match = 0;
-                    for (int l2cset = 0; l2cset < L2C_SET; l2cset++)
-                        for (int l2cway = 0; l2cway < L2C_WAY; l2cway++)
+                    for (uint32_t l2cset = 0; l2cset < L2C_SET; l2cset++)
+                        for (uint32_t l2cway = 0; l2cway < L2C_WAY; l2cway++)
                         {
                             if (ooo_cpu[i].L2C.block[l2cset][l2cway].tag == ooo_cpu[i].L1D.block[l1dset][l1dway].tag &&
                                 ooo_cpu[i].L2C.block[l2cset][l2cway].full_addr == ooo_cpu[i].L1D.block[l1dset][l1dway].full_addr &&
@@ -1924,18 +2084,18 @@ void CACHE::check_inclusive()
                     }
                 }
         //L2C data should be present in LLC
-        for (int l2cset = 0; l2cset < L2C_SET; l2cset++)
-            for (int l2cway = 0; l2cway < L2C_WAY; l2cway++)
+        for (uint32_t l2cset = 0; l2cset < L2C_SET; l2cset++)
+            for (uint32_t l2cway = 0; l2cway < L2C_WAY; l2cway++)
                 if (ooo_cpu[i].L2C.block[l2cset][l2cway].valid == 1)
                 {
                     //cout<<"5";
                     int match = 0;
-                    for (int llcset = 0; llcset < LLC_SET; llcset++)
-                        for (int llcway = 0; llcway < LLC_WAY; llcway++)
-                            if (ooo_cpu[i].L2C.block[l2cset][l2cway].tag == uncore.LLC.block[llcset][llcway].tag &&
-                                ooo_cpu[i].L2C.block[l2cset][l2cway].full_addr == uncore.LLC.block[llcset][llcway].full_addr &&
-                                //ooo_cpu[i].L2C.block[l2cset][l2cway].data == uncore.LLC.block[llcset][llcway].data &&
-                                uncore.LLC.block[llcset][llcway].valid == 1)
+                    for (uint32_t llcset = 0; llcset < LLC_SET; llcset++)
+                        for (uint32_t llcway = 0; llcway < LLC_WAY; llcway++)
+                            if (ooo_cpu[i].L2C.block[l2cset][l2cway].tag == uncore->LLC.block[llcset][llcway].tag &&
+                                ooo_cpu[i].L2C.block[l2cset][l2cway].full_addr == uncore->LLC.block[llcset][llcway].full_addr &&
+                                //ooo_cpu[i].L2C.block[l2cset][l2cway].data == uncore->LLC.block[llcset][llcway].data &&
+                                uncore->LLC.block[llcset][llcway].valid == 1)
                             {
                                 match = 1;
                                 //		cout<<"6";
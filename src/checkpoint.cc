@@ -0,0 +1,429 @@
+#include "checkpoint.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+#include <sstream>
+
+char checkpoint_out[1024];
+uint64_t checkpoint_interval = 0;
+
+class CHECKPOINT_SECTION {
+  public:
+    string name;
+    void *data;
+    size_t size;
+    checkpoint_hook save, load;
+};
+
+static vector <CHECKPOINT_SECTION> checkpoint_sections;
+
+void checkpoint_register(string name, void *data, size_t size)
+{
+    for (uint32_t i=0; i<checkpoint_sections.size(); i++) {
+        if (checkpoint_sections[i].name == name) {
+            cerr << "*** Checkpoint section registered twice: " << name << " ***" << endl;
+            assert(0);
+        }
+    }
+
+    CHECKPOINT_SECTION section;
+    section.name = name;
+    section.data = data;
+    section.size = size;
+    section.save = NULL;
+    section.load = NULL;
+    checkpoint_sections.push_back(section);
+}
+
+void checkpoint_register(string name, checkpoint_hook save, checkpoint_hook load)
+{
+    checkpoint_register(name, (void *)NULL, 0);
+    checkpoint_sections.back().save = save;
+    checkpoint_sections.back().load = load;
+}
+
+void checkpoint_write(FILE *checkpoint_file, const void *data, size_t size)
+{
+    if (fwrite(data, 1, size, checkpoint_file) != size) {
+        cerr << "*** Failed to write checkpoint ***" << endl;
+        assert(0);
+    }
+}
+
+void checkpoint_read(FILE *checkpoint_file, void *data, size_t size)
+{
+    if (fread(data, 1, size, checkpoint_file) != size) {
+        cerr << "*** Truncated checkpoint ***" << endl;
+        assert(0);
+    }
+}
+
+template <class T>
+static void write_value(FILE *checkpoint_file, const T &value)
+{
+    checkpoint_write(checkpoint_file, &value, sizeof(T));
+}
+
+template <class T>
+static void read_value(FILE *checkpoint_file, T &value)
+{
+    checkpoint_read(checkpoint_file, &value, sizeof(T));
+}
+
+static void write_string(FILE *checkpoint_file, const string &s)
+{
+    write_value(checkpoint_file, (uint64_t)s.size());
+    checkpoint_write(checkpoint_file, s.data(), s.size());
+}
+
+static string read_string(FILE *checkpoint_file)
+{
+    uint64_t size;
+    read_value(checkpoint_file, size);
+    string s(size, '\0');
+    if (size)
+        checkpoint_read(checkpoint_file, &s[0], size);
+    return s;
+}
+
+static void save_cache(FILE *checkpoint_file, CACHE *cache)
+{
+    write_value(checkpoint_file, cache->NUM_SET);
+    write_value(checkpoint_file, cache->NUM_WAY);
+    write_value(checkpoint_file, cache->LATENCY);
+    for (uint32_t i=0; i<cache->NUM_SET; i++)
+        checkpoint_write(checkpoint_file, cache->block[i], cache->NUM_WAY*sizeof(BLOCK));
+
+    checkpoint_write(checkpoint_file, cache->ACCESS, sizeof(cache->ACCESS));
+    checkpoint_write(checkpoint_file, cache->HIT, sizeof(cache->HIT));
+    checkpoint_write(checkpoint_file, cache->MISS, sizeof(cache->MISS));
+    checkpoint_write(checkpoint_file, cache->MSHR_MERGED, sizeof(cache->MSHR_MERGED));
+    checkpoint_write(checkpoint_file, cache->STALL, sizeof(cache->STALL));
+    checkpoint_write(checkpoint_file, cache->sim_access, sizeof(cache->sim_access));
+    checkpoint_write(checkpoint_file, cache->sim_hit, sizeof(cache->sim_hit));
+    checkpoint_write(checkpoint_file, cache->sim_miss, sizeof(cache->sim_miss));
+    checkpoint_write(checkpoint_file, cache->roi_access, sizeof(cache->roi_access));
+    checkpoint_write(checkpoint_file, cache->roi_hit, sizeof(cache->roi_hit));
+    checkpoint_write(checkpoint_file, cache->roi_miss, sizeof(cache->roi_miss));
+
+    write_value(checkpoint_file, cache->pf_requested);
+    write_value(checkpoint_file, cache->pf_issued);
+    write_value(checkpoint_file, cache->pf_useful);
+    write_value(checkpoint_file, cache->pf_useless);
+    write_value(checkpoint_file, cache->pf_fill);
+}
+
+static void load_cache(FILE *checkpoint_file, CACHE *cache)
+{
+    uint32_t num_set, num_way;
+    read_value(checkpoint_file, num_set);
+    read_value(checkpoint_file, num_way);
+    if ((num_set != cache->NUM_SET) || (num_way != cache->NUM_WAY)) {
+        cerr << "*** Checkpoint " << cache->NAME << " geometry " << num_set << "x" << num_way;
+        cerr << " does not match " << cache->NUM_SET << "x" << cache->NUM_WAY << " ***" << endl;
+        assert(0);
+    }
+    read_value(checkpoint_file, cache->LATENCY);
+    for (uint32_t i=0; i<cache->NUM_SET; i++)
+        checkpoint_read(checkpoint_file, cache->block[i], cache->NUM_WAY*sizeof(BLOCK));
+    cache->update_tags();
+
+    checkpoint_read(checkpoint_file, cache->ACCESS, sizeof(cache->ACCESS));
+    checkpoint_read(checkpoint_file, cache->HIT, sizeof(cache->HIT));
+    checkpoint_read(checkpoint_file, cache->MISS, sizeof(cache->MISS));
+    checkpoint_read(checkpoint_file, cache->MSHR_MERGED, sizeof(cache->MSHR_MERGED));
+    checkpoint_read(checkpoint_file, cache->STALL, sizeof(cache->STALL));
+    checkpoint_read(checkpoint_file, cache->sim_access, sizeof(cache->sim_access));
+    checkpoint_read(checkpoint_file, cache->sim_hit, sizeof(cache->sim_hit));
+    checkpoint_read(checkpoint_file, cache->sim_miss, sizeof(cache->sim_miss));
+    checkpoint_read(checkpoint_file, cache->roi_access, sizeof(cache->roi_access));
+    checkpoint_read(checkpoint_file, cache->roi_hit, sizeof(cache->roi_hit));
+    checkpoint_read(checkpoint_file, cache->roi_miss, sizeof(cache->roi_miss));
+
+    read_value(checkpoint_file, cache->pf_requested);
+    read_value(checkpoint_file, cache->pf_issued);
+    read_value(checkpoint_file, cache->pf_useful);
+    read_value(checkpoint_file, cache->pf_useless);
+    read_value(checkpoint_file, cache->pf_fill);
+}
+
+static void save_core(FILE *checkpoint_file, uint32_t cpu)
+{
+    O3_CPU *core = &ooo_cpu[cpu];
+
+    // the pipeline is not saved, so the trace resumes at the oldest unretired instruction
+    uint64_t trace_position = core->ROB.occupancy ? core->ROB.entry[core->ROB.head].instr_id : core->instr_unique_id;
+
+    write_value(checkpoint_file, trace_position);
+    write_value(checkpoint_file, core->num_retired);
+    write_value(checkpoint_file, core->begin_sim_cycle);
+    write_value(checkpoint_file, core->begin_sim_instr);
+    write_value(checkpoint_file, core->last_sim_cycle);
+    write_value(checkpoint_file, core->last_sim_instr);
+    write_value(checkpoint_file, core->finish_sim_cycle);
+    write_value(checkpoint_file, core->finish_sim_instr);
+    write_value(checkpoint_file, core->next_print_instruction);
+    write_value(checkpoint_file, core->num_branch);
+    write_value(checkpoint_file, core->branch_mispredictions);
+    write_value(checkpoint_file, current_core_cycle[cpu]);
+    write_value(checkpoint_file, warmup_complete[cpu]);
+    write_value(checkpoint_file, simulation_complete[cpu]);
+
+    save_cache(checkpoint_file, &core->ITLB);
+    save_cache(checkpoint_file, &core->DTLB);
+    save_cache(checkpoint_file, &core->STLB);
+    save_cache(checkpoint_file, &core->L1I);
+    save_cache(checkpoint_file, &core->L1D);
+    save_cache(checkpoint_file, &core->L2C);
+
+    checkpoint_write_map(checkpoint_file, unique_cl[cpu]);
+    write_value(checkpoint_file, num_cl[cpu]);
+    write_value(checkpoint_file, num_page[cpu]);
+    write_value(checkpoint_file, minor_fault[cpu]);
+    write_value(checkpoint_file, major_fault[cpu]);
+}
+
+static void load_core(FILE *checkpoint_file, uint32_t cpu)
+{
+    O3_CPU *core = &ooo_cpu[cpu];
+
+    uint64_t trace_position;
+    read_value(checkpoint_file, trace_position);
+    read_value(checkpoint_file, core->num_retired);
+    read_value(checkpoint_file, core->begin_sim_cycle);
+    read_value(checkpoint_file, core->begin_sim_instr);
+    read_value(checkpoint_file, core->last_sim_cycle);
+    read_value(checkpoint_file, core->last_sim_instr);
+    read_value(checkpoint_file, core->finish_sim_cycle);
+    read_value(checkpoint_file, core->finish_sim_instr);
+    read_value(checkpoint_file, core->next_print_instruction);
+    read_value(checkpoint_file, core->num_branch);
+    read_value(checkpoint_file, core->branch_mispredictions);
+    read_value(checkpoint_file, current_core_cycle[cpu]);
+    read_value(checkpoint_file, warmup_complete[cpu]);
+    read_value(checkpoint_file, simulation_complete[cpu]);
+    stall_cycle[cpu] = current_core_cycle[cpu];
+
+    load_cache(checkpoint_file, &core->ITLB);
+    load_cache(checkpoint_file, &core->DTLB);
+    load_cache(checkpoint_file, &core->STLB);
+    load_cache(checkpoint_file, &core->L1I);
+    load_cache(checkpoint_file, &core->L1D);
+    load_cache(checkpoint_file, &core->L2C);
+
+    checkpoint_read_map(checkpoint_file, unique_cl[cpu]);
+    read_value(checkpoint_file, num_cl[cpu]);
+    read_value(checkpoint_file, num_page[cpu]);
+    read_value(checkpoint_file, minor_fault[cpu]);
+    read_value(checkpoint_file, major_fault[cpu]);
+
+    core->skip_trace(trace_position);
+    core->instr_unique_id = trace_position;
+}
+
+static void save_dram(FILE *checkpoint_file)
+{
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+        write_value(checkpoint_file, uncore->DRAM.RQ[i].ROW_BUFFER_HIT);
+        write_value(checkpoint_file, uncore->DRAM.RQ[i].ROW_BUFFER_MISS);
+        write_value(checkpoint_file, uncore->DRAM.WQ[i].ROW_BUFFER_HIT);
+        write_value(checkpoint_file, uncore->DRAM.WQ[i].ROW_BUFFER_MISS);
+        write_value(checkpoint_file, uncore->DRAM.WQ[i].FULL);
+        write_value(checkpoint_file, uncore->DRAM.dbus_cycle_congested[i]);
+
+        // open rows are the only long-lived bank state
+        for (uint32_t j=0; j<DRAM_RANKS; j++)
+            for (uint32_t k=0; k<DRAM_BANKS; k++)
+                write_value(checkpoint_file, uncore->DRAM.bank_request[i][j][k].open_row);
+    }
+    checkpoint_write(checkpoint_file, uncore->DRAM.dbus_congested, sizeof(uncore->DRAM.dbus_congested));
+}
+
+static void load_dram(FILE *checkpoint_file)
+{
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+        read_value(checkpoint_file, uncore->DRAM.RQ[i].ROW_BUFFER_HIT);
+        read_value(checkpoint_file, uncore->DRAM.RQ[i].ROW_BUFFER_MISS);
+        read_value(checkpoint_file, uncore->DRAM.WQ[i].ROW_BUFFER_HIT);
+        read_value(checkpoint_file, uncore->DRAM.WQ[i].ROW_BUFFER_MISS);
+        read_value(checkpoint_file, uncore->DRAM.WQ[i].FULL);
+        read_value(checkpoint_file, uncore->DRAM.dbus_cycle_congested[i]);
+
+        for (uint32_t j=0; j<DRAM_RANKS; j++)
+            for (uint32_t k=0; k<DRAM_BANKS; k++)
+                read_value(checkpoint_file, uncore->DRAM.bank_request[i][j][k].open_row);
+    }
+    checkpoint_read(checkpoint_file, uncore->DRAM.dbus_congested, sizeof(uncore->DRAM.dbus_congested));
+}
+
+void write_checkpoint(const char *file_name)
+{
+    // write to a temporary file first so that a preempted write never destroys the last good checkpoint
+    string temp_name = string(file_name) + ".tmp";
+    FILE *checkpoint_file = fopen(temp_name.c_str(), "wb");
+    if (checkpoint_file == NULL) {
+        cerr << "*** Cannot open checkpoint file: " << temp_name << " ***" << endl;
+        assert(0);
+    }
+
+    write_value(checkpoint_file, (uint64_t)CHECKPOINT_MAGIC);
+    write_value(checkpoint_file, (uint32_t)CHECKPOINT_VERSION);
+    write_value(checkpoint_file, (uint32_t)NUM_CPUS);
+    write_value(checkpoint_file, knob_cloudsuite);
+
+    // shared state
+    write_value(checkpoint_file, all_warmup_complete);
+    write_value(checkpoint_file, all_simulation_complete);
+    write_value(checkpoint_file, SCHEDULING_LATENCY);
+    write_value(checkpoint_file, EXEC_LATENCY);
+    write_value(checkpoint_file, PAGE_TABLE_LATENCY);
+    write_value(checkpoint_file, SWAP_LATENCY);
+
+    checkpoint_write_map(checkpoint_file, page_table);
+    checkpoint_write_map(checkpoint_file, inverse_table);
+    checkpoint_write_map(checkpoint_file, recent_page);
+    queue <uint64_t> pages = page_queue;
+    write_value(checkpoint_file, (uint64_t)pages.size());
+    while (!pages.empty()) {
+        write_value(checkpoint_file, pages.front());
+        pages.pop();
+    }
+    write_value(checkpoint_file, previous_ppage);
+    write_value(checkpoint_file, num_adjacent_page);
+    write_value(checkpoint_file, allocated_pages);
+
+    ostringstream rand_state;
+    rand_state << champsim_rand.engine;
+    write_string(checkpoint_file, rand_state.str());
+
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        save_core(checkpoint_file, i);
+    save_cache(checkpoint_file, &uncore->LLC);
+    save_dram(checkpoint_file);
+
+    // policy state, each section is prefixed with its name and size so that unknown sections can be skipped
+    write_value(checkpoint_file, (uint32_t)checkpoint_sections.size());
+    for (uint32_t i=0; i<checkpoint_sections.size(); i++) {
+        CHECKPOINT_SECTION *section = &checkpoint_sections[i];
+        write_string(checkpoint_file, section->name);
+
+        if (section->save) {
+            long size_offset = ftell(checkpoint_file);
+            write_value(checkpoint_file, (uint64_t)0);
+            section->save(checkpoint_file);
+            long end_offset = ftell(checkpoint_file);
+            fseek(checkpoint_file, size_offset, SEEK_SET);
+            write_value(checkpoint_file, (uint64_t)(end_offset - size_offset - sizeof(uint64_t)));
+            fseek(checkpoint_file, end_offset, SEEK_SET);
+        }
+        else {
+            write_value(checkpoint_file, (uint64_t)section->size);
+            checkpoint_write(checkpoint_file, section->data, section->size);
+        }
+    }
+
+    fclose(checkpoint_file);
+    if (rename(temp_name.c_str(), file_name)) {
+        cerr << "*** Cannot rename checkpoint file to: " << file_name << " ***" << endl;
+        assert(0);
+    }
+
+    cout << "Checkpoint written: " << file_name;
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        cout << " CPU " << i << " instructions: " << ooo_cpu[i].num_retired << " cycles: " << current_core_cycle[i];
+    cout << endl;
+}
+
+void read_checkpoint(const char *file_name)
+{
+    FILE *checkpoint_file = fopen(file_name, "rb");
+    if (checkpoint_file == NULL) {
+        cerr << "*** Cannot open checkpoint file: " << file_name << " ***" << endl;
+        assert(0);
+    }
+
+    uint64_t magic;
+    uint32_t version, num_cpus;
+    uint8_t cloudsuite;
+    read_value(checkpoint_file, magic);
+    read_value(checkpoint_file, version);
+    read_value(checkpoint_file, num_cpus);
+    read_value(checkpoint_file, cloudsuite);
+    if ((magic != CHECKPOINT_MAGIC) || (version != CHECKPOINT_VERSION)) {
+        cerr << "*** Not a ChampSim checkpoint (or an incompatible version): " << file_name << " ***" << endl;
+        assert(0);
+    }
+    if ((num_cpus != NUM_CPUS) || (cloudsuite != knob_cloudsuite)) {
+        cerr << "*** Checkpoint was taken with " << num_cpus << " CPUs" << (cloudsuite ? " (cloudsuite)" : "") << " ***" << endl;
+        assert(0);
+    }
+
+    read_value(checkpoint_file, all_warmup_complete);
+    read_value(checkpoint_file, all_simulation_complete);
+    read_value(checkpoint_file, SCHEDULING_LATENCY);
+    read_value(checkpoint_file, EXEC_LATENCY);
+    read_value(checkpoint_file, PAGE_TABLE_LATENCY);
+    read_value(checkpoint_file, SWAP_LATENCY);
+
+    checkpoint_read_map(checkpoint_file, page_table);
+    checkpoint_read_map(checkpoint_file, inverse_table);
+    checkpoint_read_map(checkpoint_file, recent_page);
+    uint64_t num_pages;
+    read_value(checkpoint_file, num_pages);
+    page_queue = queue <uint64_t> ();
+    for (uint64_t i=0; i<num_pages; i++) {
+        uint64_t vpage;
+        read_value(checkpoint_file, vpage);
+        page_queue.push(vpage);
+    }
+    read_value(checkpoint_file, previous_ppage);
+    read_value(checkpoint_file, num_adjacent_page);
+    read_value(checkpoint_file, allocated_pages);
+
+    istringstream rand_state(read_string(checkpoint_file));
+    rand_state >> champsim_rand.engine;
+
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        load_core(checkpoint_file, i);
+    load_cache(checkpoint_file, &uncore->LLC);
+    load_dram(checkpoint_file);
+
+    uint32_t num_sections;
+    read_value(checkpoint_file, num_sections);
+    for (uint32_t i=0; i<num_sections; i++) {
+        string name = read_string(checkpoint_file);
+        uint64_t size;
+        read_value(checkpoint_file, size);
+
+        CHECKPOINT_SECTION *section = NULL;
+        for (uint32_t j=0; j<checkpoint_sections.size(); j++) {
+            if (checkpoint_sections[j].name == name)
+                section = &checkpoint_sections[j];
+        }
+
+        // state of a policy that is not built into this binary
+        if (section == NULL) {
+            cout << "Checkpoint section " << name << " is not used by this binary" << endl;
+            fseek(checkpoint_file, size, SEEK_CUR);
+            continue;
+        }
+
+        long start_offset = ftell(checkpoint_file);
+        if (section->load)
+            section->load(checkpoint_file);
+        else if (section->size == size)
+            checkpoint_read(checkpoint_file, section->data, section->size);
+
+        if ((uint64_t)(ftell(checkpoint_file) - start_offset) != size) {
+            cerr << "*** Checkpoint section " << name << " has " << size << " bytes, which does not match this binary ***" << endl;
+            assert(0);
+        }
+    }
+
+    fclose(checkpoint_file);
+
+    cout << "Checkpoint restored: " << file_name;
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        cout << " CPU " << i << " instructions: " << ooo_cpu[i].num_retired << " cycles: " << current_core_cycle[i];
+    cout << endl;
+}
@@ -0,0 +1,347 @@
+#include "compact_trace.h"
+#include "ooo_cpu.h"
+
+#include <vector>
+#include <zlib.h>
+
+char convert_trace_out[1024];
+
+static inline uint8_t *put_varint(uint8_t *out, uint64_t value)
+{
+    while (value >= 0x80) {
+        *out++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *out++ = value;
+
+    return out;
+}
+
+static inline uint64_t get_varint(const uint8_t *in, uint64_t &position)
+{
+    uint64_t value = 0;
+    for (uint32_t shift=0; ; shift+=7) {
+        uint8_t byte = in[position++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+}
+
+static inline uint64_t zigzag(uint64_t delta)
+{
+    return (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+}
+
+static inline uint64_t unzigzag(uint64_t value)
+{
+    return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+COMPACT_TRACE::COMPACT_TRACE(const char *name, uint32_t record_size, uint8_t recover) : file_name(name), recover(recover)
+{
+    failed = 0;
+    index = NULL;
+    compressed = NULL;
+    encoded = NULL;
+
+    file = fopen(file_name, "rb");
+    if (file == NULL) {
+        fail("cannot open");
+        return;
+    }
+
+    if ((fread(&header, sizeof(header), 1, file) != 1) || memcmp(header.magic, COMPACT_MAGIC, sizeof(header.magic))) {
+        fail("not a compact trace");
+        return;
+    }
+    if (header.record_size != record_size) {
+        fail(knob_cloudsuite ? "not a cloudsuite trace" : "cloudsuite trace, run with -cloudsuite");
+        return;
+    }
+    if (header.num_instructions == 0) {
+        fail("empty trace");
+        return;
+    }
+
+    index = new COMPACT_CHUNK[header.num_chunks];
+    if (fseek(file, header.index_offset, SEEK_SET) || (fread(index, sizeof(COMPACT_CHUNK), header.num_chunks, file) != header.num_chunks)) {
+        fail("truncated chunk index");
+        return;
+    }
+
+    uint32_t max_compressed = 0;
+    for (uint64_t i=0; i<header.num_chunks; i++)
+        max_compressed = max(max_compressed, index[i].compressed_size);
+    compressed = new uint8_t[max_compressed];
+    encoded = new uint8_t[header.chunk_size * COMPACT_MAX_RECORD_BYTES];
+
+    next_chunk = 0;
+    encoded_position = 0;
+    chunk_records = 0;
+    last_ip = 0;
+    last_address = 0;
+}
+
+COMPACT_TRACE::~COMPACT_TRACE()
+{
+    if (file)
+        fclose(file);
+    delete[] index;
+    delete[] compressed;
+    delete[] encoded;
+}
+
+void COMPACT_TRACE::fail(const char *what)
+{
+    cerr << "*** Trace " << file_name << ": " << what << " ***" << endl;
+    failed = 1;
+    if (!recover)
+        assert(0);
+}
+
+void COMPACT_TRACE::load_chunk(uint64_t chunk)
+{
+    COMPACT_CHUNK *entry = &index[chunk];
+    if (fseek(file, entry->offset, SEEK_SET) || (fread(compressed, 1, entry->compressed_size, file) != entry->compressed_size))
+        return fail("truncated chunk");
+
+    uLongf encoded_size = header.chunk_size * COMPACT_MAX_RECORD_BYTES;
+    if ((uncompress(encoded, &encoded_size, compressed, entry->compressed_size) != Z_OK) || (encoded_size != entry->encoded_size))
+        return fail("corrupted chunk");
+
+    next_chunk = chunk + 1;
+    encoded_position = 0;
+    chunk_records = (chunk + 1 == header.num_chunks) ? header.num_instructions - chunk * header.chunk_size : header.chunk_size;
+    last_ip = 0;
+    last_address = 0;
+}
+
+// only the chunk holding the instruction is decompressed, the records before it in that chunk are dropped
+void COMPACT_TRACE::seek(uint64_t instr)
+{
+    if (failed)
+        return;
+
+    instr %= header.num_instructions;
+    load_chunk(instr / header.chunk_size);
+    if (failed)
+        return;
+
+    cloudsuite_instr record; // large enough for either format
+    for (uint64_t i=0; i<instr % header.chunk_size; i++)
+        decode_record((char *)&record);
+}
+
+static inline void decode_asid(input_instr *instr, const uint8_t *encoded, uint64_t &position)
+{
+}
+
+static inline void decode_asid(cloudsuite_instr *instr, const uint8_t *encoded, uint64_t &position)
+{
+    instr->asid[0] = encoded[position++];
+    instr->asid[1] = encoded[position++];
+}
+
+template <class INSTR> void COMPACT_TRACE::decode_fields(INSTR *instr)
+{
+    uint8_t flags = encoded[encoded_position++],
+            register_mask = encoded[encoded_position++],
+            memory_mask = encoded[encoded_position++];
+
+    instr->is_branch = (flags & COMPACT_BRANCH) ? 1 : 0;
+    instr->branch_taken = (flags & COMPACT_TAKEN) ? 1 : 0;
+
+    for (uint32_t i=0; i<sizeof(instr->destination_registers); i++) {
+        if (register_mask & (1 << i))
+            instr->destination_registers[i] = encoded[encoded_position++];
+    }
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++) {
+        if (register_mask & (1 << (COMPACT_SOURCE_SHIFT + i)))
+            instr->source_registers[i] = encoded[encoded_position++];
+    }
+
+    last_ip += unzigzag(get_varint(encoded, encoded_position));
+    instr->ip = last_ip;
+
+    for (uint32_t i=0; i<sizeof(instr->destination_registers); i++) {
+        if (memory_mask & (1 << i)) {
+            last_address += unzigzag(get_varint(encoded, encoded_position));
+            instr->destination_memory[i] = last_address;
+        }
+    }
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++) {
+        if (memory_mask & (1 << (COMPACT_SOURCE_SHIFT + i))) {
+            last_address += unzigzag(get_varint(encoded, encoded_position));
+            instr->source_memory[i] = last_address;
+        }
+    }
+
+    decode_asid(instr, encoded, encoded_position);
+}
+
+void COMPACT_TRACE::decode_record(char *record)
+{
+    // absent operands are zero, the asid of cloudsuite records is always encoded
+    memset(record, 0, header.record_size);
+    if (header.record_size == sizeof(cloudsuite_instr))
+        decode_fields((cloudsuite_instr *)record);
+    else
+        decode_fields((input_instr *)record);
+
+    chunk_records--;
+}
+
+uint64_t COMPACT_TRACE::read(char *data, uint64_t size)
+{
+    uint64_t bytes = 0;
+    while (!failed && (bytes + header.record_size <= size)) {
+        if (chunk_records == 0) {
+            if (next_chunk == header.num_chunks)
+                break;
+            load_chunk(next_chunk);
+            if (failed)
+                break;
+        }
+
+        decode_record(data + bytes);
+        bytes += header.record_size;
+    }
+
+    return bytes;
+}
+
+static inline uint8_t *encode_asid(input_instr *instr, uint8_t *out)
+{
+    return out;
+}
+
+static inline uint8_t *encode_asid(cloudsuite_instr *instr, uint8_t *out)
+{
+    *out++ = instr->asid[0];
+    *out++ = instr->asid[1];
+
+    return out;
+}
+
+template <class INSTR> static uint8_t *encode_record(INSTR *instr, uint8_t *out, uint64_t &last_ip, uint64_t &last_address)
+{
+    if ((instr->is_branch > 1) || (instr->branch_taken > 1)) {
+        cerr << "*** Cannot convert branch flags other than 0 or 1, ip: " << hex << instr->ip << dec << " ***" << endl;
+        assert(0);
+    }
+
+    uint8_t *flags = out++, *register_mask = out++, *memory_mask = out++;
+    *flags = (instr->is_branch ? COMPACT_BRANCH : 0) | (instr->branch_taken ? COMPACT_TAKEN : 0);
+    *register_mask = 0;
+    *memory_mask = 0;
+
+    for (uint32_t i=0; i<sizeof(instr->destination_registers); i++) {
+        if (instr->destination_registers[i]) {
+            *register_mask |= 1 << i;
+            *out++ = instr->destination_registers[i];
+        }
+    }
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++) {
+        if (instr->source_registers[i]) {
+            *register_mask |= 1 << (COMPACT_SOURCE_SHIFT + i);
+            *out++ = instr->source_registers[i];
+        }
+    }
+
+    out = put_varint(out, zigzag(instr->ip - last_ip));
+    last_ip = instr->ip;
+
+    for (uint32_t i=0; i<sizeof(instr->destination_registers); i++) {
+        if (instr->destination_memory[i]) {
+            *memory_mask |= 1 << i;
+            out = put_varint(out, zigzag(instr->destination_memory[i] - last_address));
+            last_address = instr->destination_memory[i];
+        }
+    }
+    for (uint32_t i=0; i<NUM_INSTR_SOURCES; i++) {
+        if (instr->source_memory[i]) {
+            *memory_mask |= 1 << (COMPACT_SOURCE_SHIFT + i);
+            out = put_varint(out, zigzag(instr->source_memory[i] - last_address));
+            last_address = instr->source_memory[i];
+        }
+    }
+
+    return encode_asid(instr, out);
+}
+
+// one pass over the trace of CPU 0, the trace is not simulated
+void convert_trace(O3_CPU *core, const char *file_name)
+{
+    FILE *out = fopen(file_name, "wb");
+    if (out == NULL) {
+        cerr << "*** Cannot open compact trace for writing: " << file_name << " ***" << endl;
+        assert(0);
+    }
+
+    COMPACT_HEADER header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPACT_MAGIC, sizeof(header.magic));
+    header.record_size = knob_cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr);
+    header.chunk_size = COMPACT_CHUNK_SIZE;
+    fwrite(&header, sizeof(header), 1, out);
+
+    vector <COMPACT_CHUNK> index;
+    uint64_t encoded_capacity = COMPACT_CHUNK_SIZE * COMPACT_MAX_RECORD_BYTES;
+    uLongf compressed_capacity = compressBound(encoded_capacity);
+    uint8_t *encoded = new uint8_t[encoded_capacity],
+            *compressed = new uint8_t[compressed_capacity],
+            *position = encoded;
+    uint64_t chunk_records = 0, last_ip = 0, last_address = 0, offset = sizeof(header);
+
+    void *record = knob_cloudsuite ? (void *)&core->current_cloudsuite_instr : (void *)&core->current_instr;
+
+    uint8_t end_of_trace = 0;
+    while (!end_of_trace) {
+        end_of_trace = !core->trace.read(record);
+        if (!end_of_trace) {
+            if (knob_cloudsuite)
+                position = encode_record(&core->current_cloudsuite_instr, position, last_ip, last_address);
+            else
+                position = encode_record(&core->current_instr, position, last_ip, last_address);
+            chunk_records++;
+            header.num_instructions++;
+        }
+
+        if ((chunk_records == COMPACT_CHUNK_SIZE) || (end_of_trace && chunk_records)) {
+            COMPACT_CHUNK chunk;
+            uLongf compressed_size = compressed_capacity;
+            if (compress2(compressed, &compressed_size, encoded, position - encoded, Z_BEST_COMPRESSION) != Z_OK) {
+                cerr << "*** Cannot compress chunk " << index.size() << " ***" << endl;
+                assert(0);
+            }
+            chunk.offset = offset;
+            chunk.compressed_size = compressed_size;
+            chunk.encoded_size = position - encoded;
+            fwrite(compressed, 1, compressed_size, out);
+            offset += compressed_size;
+            index.push_back(chunk);
+
+            position = encoded;
+            chunk_records = 0;
+            last_ip = 0;
+            last_address = 0;
+        }
+    }
+
+    header.num_chunks = index.size();
+    header.index_offset = offset;
+    fwrite(index.data(), sizeof(COMPACT_CHUNK), index.size(), out);
+    rewind(out);
+    fwrite(&header, sizeof(header), 1, out);
+    if (fclose(out)) {
+        cerr << "*** Cannot write compact trace: " << file_name << " ***" << endl;
+        assert(0);
+    }
+    delete[] encoded;
+    delete[] compressed;
+
+    uint64_t file_size = offset + header.num_chunks * sizeof(COMPACT_CHUNK);
+    cout << "Compact trace: " << file_name << " instructions: " << header.num_instructions << " chunks: " << header.num_chunks;
+    cout << " bytes: " << file_size << " bytes per instruction: " << (double)file_size / header.num_instructions << endl;
+}
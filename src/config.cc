@@ -0,0 +1,196 @@
+#include "config.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+#include "policy.h"
+
+class CONFIG_PARAMETER {
+  public:
+    const char *name;
+    uint32_t *value;
+};
+
+#define PARAMETER(x) {#x, &x}
+
+static CONFIG_PARAMETER config_parameters[] = {
+    // core
+    PARAMETER(ROB_SIZE), PARAMETER(LQ_SIZE), PARAMETER(SQ_SIZE),
+    PARAMETER(FETCH_WIDTH), PARAMETER(DECODE_WIDTH), PARAMETER(EXEC_WIDTH),
+    PARAMETER(LQ_WIDTH), PARAMETER(SQ_WIDTH), PARAMETER(RETIRE_WIDTH), PARAMETER(SCHEDULER_SIZE),
+
+    // TLBs and caches
+    PARAMETER(ITLB_SET), PARAMETER(ITLB_WAY), PARAMETER(ITLB_RQ_SIZE), PARAMETER(ITLB_WQ_SIZE), PARAMETER(ITLB_PQ_SIZE), PARAMETER(ITLB_MSHR_SIZE), PARAMETER(ITLB_LATENCY),
+    PARAMETER(DTLB_SET), PARAMETER(DTLB_WAY), PARAMETER(DTLB_RQ_SIZE), PARAMETER(DTLB_WQ_SIZE), PARAMETER(DTLB_PQ_SIZE), PARAMETER(DTLB_MSHR_SIZE), PARAMETER(DTLB_LATENCY),
+    PARAMETER(STLB_SET), PARAMETER(STLB_WAY), PARAMETER(STLB_RQ_SIZE), PARAMETER(STLB_WQ_SIZE), PARAMETER(STLB_PQ_SIZE), PARAMETER(STLB_MSHR_SIZE), PARAMETER(STLB_LATENCY),
+    PARAMETER(L1I_SET), PARAMETER(L1I_WAY), PARAMETER(L1I_RQ_SIZE), PARAMETER(L1I_WQ_SIZE), PARAMETER(L1I_PQ_SIZE), PARAMETER(L1I_MSHR_SIZE), PARAMETER(L1I_LATENCY),
+    PARAMETER(L1D_SET), PARAMETER(L1D_WAY), PARAMETER(L1D_RQ_SIZE), PARAMETER(L1D_WQ_SIZE), PARAMETER(L1D_PQ_SIZE), PARAMETER(L1D_MSHR_SIZE), PARAMETER(L1D_LATENCY),
+    PARAMETER(L2C_SET), PARAMETER(L2C_WAY), PARAMETER(L2C_RQ_SIZE), PARAMETER(L2C_WQ_SIZE), PARAMETER(L2C_PQ_SIZE), PARAMETER(L2C_MSHR_SIZE), PARAMETER(L2C_LATENCY),
+    PARAMETER(LLC_SET), PARAMETER(LLC_WAY), PARAMETER(LLC_RQ_SIZE), PARAMETER(LLC_WQ_SIZE), PARAMETER(LLC_PQ_SIZE), PARAMETER(LLC_MSHR_SIZE), PARAMETER(LLC_LATENCY),
+
+    // DRAM
+    PARAMETER(DRAM_RQ_SIZE), PARAMETER(DRAM_WQ_SIZE), PARAMETER(DRAM_MTPS),
+    PARAMETER(tRP_DRAM_CYCLE), PARAMETER(tRCD_DRAM_CYCLE), PARAMETER(tCAS_DRAM_CYCLE)
+};
+
+#define NUM_CONFIG_PARAMETERS (sizeof(config_parameters) / sizeof(config_parameters[0]))
+
+void read_config(const char *file_name)
+{
+    FILE *config_file = fopen(file_name, "r");
+    if (config_file == NULL) {
+        cerr << "*** Cannot open config file: " << file_name << " ***" << endl;
+        assert(0);
+    }
+
+    cout << "Config: " << file_name << endl;
+
+    char line[1024];
+    uint32_t line_number = 0;
+    while (fgets(line, sizeof(line), config_file)) {
+        line_number++;
+
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        for (char *ch = line; *ch; ch++) {
+            if (*ch == '=')
+                *ch = ' ';
+        }
+
+        char name[256], value[256], extra[256];
+        int num_fields = sscanf(line, "%255s %255s %255s", name, value, extra);
+        if ((num_fields <= 0) || (name[0] == '['))
+            continue;
+
+        // policies are chosen by name
+        int kind = policy_parameter(name);
+        if ((kind >= 0) && (num_fields == 2)) {
+            select_policy(kind, value);
+            cout << "  " << name << " = " << value << endl;
+            continue;
+        }
+
+        char *end;
+        unsigned long parsed = (num_fields == 2) ? strtoul(value, &end, 0) : 0;
+        if ((num_fields != 2) || *end || (parsed > UINT32_MAX)) {
+            cerr << "*** Malformed config line " << line_number << " in " << file_name << " ***" << endl;
+            assert(0);
+        }
+
+        uint32_t i;
+        for (i=0; i<NUM_CONFIG_PARAMETERS; i++) {
+            if (strcmp(config_parameters[i].name, name) == 0)
+                break;
+        }
+        if (i == NUM_CONFIG_PARAMETERS) {
+            cerr << "*** Unknown config parameter: " << name << " (line " << line_number << " in " << file_name << ") ***" << endl;
+            assert(0);
+        }
+
+        *config_parameters[i].value = parsed;
+        cout << "  " << name << " = " << parsed << endl;
+    }
+
+    fclose(config_file);
+}
+
+static void check_power_of_two(const char *name, uint32_t value)
+{
+    if ((value == 0) || (value & (value - 1))) {
+        cerr << "*** " << name << " must be a power of two: " << value << " ***" << endl;
+        assert(0);
+    }
+}
+
+static void check_nonzero(const char *name, uint32_t value)
+{
+    if (value == 0) {
+        cerr << "*** " << name << " must be at least one ***" << endl;
+        assert(0);
+    }
+}
+
+// a cache stalls forever without room in its RQ, WQ or MSHR, and the next level stalls without room in its PQ
+// TLBs are never prefetched into, so their PQ_SIZE may be 0
+static void check_queues(const char *cache_name, uint32_t rq_size, uint32_t wq_size, uint32_t pq_size, uint32_t mshr_size, bool prefetched)
+{
+    char name[64];
+
+    snprintf(name, sizeof(name), "%s_RQ_SIZE", cache_name);
+    check_nonzero(name, rq_size);
+    snprintf(name, sizeof(name), "%s_WQ_SIZE", cache_name);
+    check_nonzero(name, wq_size);
+    if (prefetched) {
+        snprintf(name, sizeof(name), "%s_PQ_SIZE", cache_name);
+        check_nonzero(name, pq_size);
+    }
+    snprintf(name, sizeof(name), "%s_MSHR_SIZE", cache_name);
+    check_nonzero(name, mshr_size);
+}
+
+// fill in derived defaults and reject configurations the model cannot run
+void check_config()
+{
+    if (LLC_RQ_SIZE == 0)
+        LLC_RQ_SIZE = NUM_CPUS*L2C_MSHR_SIZE;
+    if (LLC_WQ_SIZE == 0)
+        LLC_WQ_SIZE = NUM_CPUS*L2C_MSHR_SIZE;
+    if (LLC_PQ_SIZE == 0)
+        LLC_PQ_SIZE = NUM_CPUS*L2C_MSHR_SIZE;
+
+    if ((ROB_SIZE > MAX_ROB_SIZE) || (LQ_SIZE > MAX_ROB_SIZE) || (SQ_SIZE > MAX_ROB_SIZE)) {
+        cerr << "*** ROB_SIZE, LQ_SIZE and SQ_SIZE must not exceed MAX_ROB_SIZE: " << MAX_ROB_SIZE << " ***" << endl;
+        assert(0);
+    }
+    check_nonzero("ROB_SIZE", ROB_SIZE);
+    check_nonzero("LQ_SIZE", LQ_SIZE);
+    check_nonzero("SQ_SIZE", SQ_SIZE);
+    check_nonzero("FETCH_WIDTH", FETCH_WIDTH);
+    check_nonzero("DECODE_WIDTH", DECODE_WIDTH);
+    check_nonzero("EXEC_WIDTH", EXEC_WIDTH);
+    check_nonzero("LQ_WIDTH", LQ_WIDTH);
+    check_nonzero("SQ_WIDTH", SQ_WIDTH);
+    check_nonzero("RETIRE_WIDTH", RETIRE_WIDTH);
+    check_nonzero("SCHEDULER_SIZE", SCHEDULER_SIZE);
+
+    // sets are indexed with a mask
+    check_power_of_two("ITLB_SET", ITLB_SET);
+    check_power_of_two("DTLB_SET", DTLB_SET);
+    check_power_of_two("STLB_SET", STLB_SET);
+    check_power_of_two("L1I_SET", L1I_SET);
+    check_power_of_two("L1D_SET", L1D_SET);
+    check_power_of_two("L2C_SET", L2C_SET);
+    check_power_of_two("LLC_SET", LLC_SET);
+    check_nonzero("ITLB_WAY", ITLB_WAY);
+    check_nonzero("DTLB_WAY", DTLB_WAY);
+    check_nonzero("STLB_WAY", STLB_WAY);
+    check_nonzero("L1I_WAY", L1I_WAY);
+    check_nonzero("L1D_WAY", L1D_WAY);
+    check_nonzero("L2C_WAY", L2C_WAY);
+    check_nonzero("LLC_WAY", LLC_WAY);
+
+    check_queues("ITLB", ITLB_RQ_SIZE, ITLB_WQ_SIZE, ITLB_PQ_SIZE, ITLB_MSHR_SIZE, false);
+    check_queues("DTLB", DTLB_RQ_SIZE, DTLB_WQ_SIZE, DTLB_PQ_SIZE, DTLB_MSHR_SIZE, false);
+    check_queues("STLB", STLB_RQ_SIZE, STLB_WQ_SIZE, STLB_PQ_SIZE, STLB_MSHR_SIZE, false);
+    check_queues("L1I", L1I_RQ_SIZE, L1I_WQ_SIZE, L1I_PQ_SIZE, L1I_MSHR_SIZE, true);
+    check_queues("L1D", L1D_RQ_SIZE, L1D_WQ_SIZE, L1D_PQ_SIZE, L1D_MSHR_SIZE, true);
+    check_queues("L2C", L2C_RQ_SIZE, L2C_WQ_SIZE, L2C_PQ_SIZE, L2C_MSHR_SIZE, true);
+    check_queues("LLC", LLC_RQ_SIZE, LLC_WQ_SIZE, LLC_PQ_SIZE, LLC_MSHR_SIZE, true);
+
+    check_nonzero("DRAM_RQ_SIZE", DRAM_RQ_SIZE);
+    check_nonzero("DRAM_WQ_SIZE", DRAM_WQ_SIZE);
+    check_nonzero("DRAM_MTPS", DRAM_MTPS);
+    // the data bus is timed in whole core cycles
+    if (DRAM_MTPS > CPU_FREQ) {
+        cerr << "*** DRAM_MTPS must not exceed CPU_FREQ: " << CPU_FREQ << " ***" << endl;
+        assert(0);
+    }
+
+    // a miss through every level and a DRAM row miss, in core cycles, must leave room for queueing and page faults
+    // before the ROB head reaches DEADLOCK_CYCLE
+    uint64_t miss_latency = (uint64_t)max(ITLB_LATENCY, DTLB_LATENCY) + STLB_LATENCY + max(L1I_LATENCY, L1D_LATENCY) + L2C_LATENCY + LLC_LATENCY
+                            + ((uint64_t)tRP_DRAM_CYCLE + tRCD_DRAM_CYCLE + tCAS_DRAM_CYCLE) * (CPU_FREQ / DRAM_IO_FREQ);
+    if (miss_latency >= DEADLOCK_CYCLE/2) {
+        cerr << "*** The *_LATENCY and t*_DRAM_CYCLE values add up to " << miss_latency << " cycles, they must stay below " << DEADLOCK_CYCLE/2 << " ***" << endl;
+        assert(0);
+    }
+}
@@ -1,7 +1,12 @@
 #include "dram_controller.h"
 
+// default DRAM configuration
+uint32_t DRAM_WQ_SIZE = 48, DRAM_RQ_SIZE = 48,
+         tRP_DRAM_CYCLE = 11, tRCD_DRAM_CYCLE = 11, tCAS_DRAM_CYCLE = 11,
+         DRAM_MTPS = 1600;
+
 // initialized in main.cc
-uint32_t DRAM_MTPS, DRAM_DBUS_RETURN_TIME,
+uint32_t DRAM_DBUS_RETURN_TIME,
          tRP, tRCD, tCAS;
 
 void MEMORY_CONTROLLER::reset_remain_requests(PACKET_QUEUE *queue, uint32_t channel)
@@ -459,7 +464,7 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet)
         return index; // merged index
 
     // search for the empty index
-    for (index=0; index<DRAM_RQ_SIZE; index++) {
+    for (index=0; index<(int)DRAM_RQ_SIZE; index++) {
         if (RQ[channel].entry[index].address == 0) {
             
             RQ[channel].entry[index] = *packet;
@@ -501,7 +506,7 @@ int MEMORY_CONTROLLER::add_wq(PACKET *packet)
         return index; // merged index
 
     // search for the empty index
-    for (index=0; index<DRAM_WQ_SIZE; index++) {
+    for (index=0; index<(int)DRAM_WQ_SIZE; index++) {
         if (WQ[channel].entry[index].address == 0) {
             
             WQ[channel].entry[index] = *packet;
@@ -701,3 +706,56 @@ void MEMORY_CONTROLLER::increment_WQ_FULL(uint64_t address)
     uint32_t channel = dram_get_channel(address);
     WQ[channel].FULL++;
 }
+
+uint64_t MEMORY_CONTROLLER::next_queue_event(PACKET_QUEUE *queue)
+{
+    uint64_t next_cycle = UINT64_MAX;
+
+    // schedule() cannot pick anything while every pending request waits for a busy bank
+    if (queue->next_schedule_index < queue->SIZE) {
+        for (uint32_t i=0; i<queue->SIZE; i++) {
+            uint64_t op_addr = queue->entry[i].address;
+            if ((op_addr == 0) || queue->entry[i].scheduled)
+                continue;
+
+            if (bank_request[dram_get_channel(op_addr)][dram_get_rank(op_addr)][dram_get_bank(op_addr)].working == 0) {
+                next_cycle = queue->next_schedule_cycle;
+                break;
+            }
+        }
+    }
+
+    // process() waits for both the request and its bank
+    if (queue->next_process_index < queue->SIZE) {
+        uint64_t op_addr = queue->entry[queue->next_process_index].address,
+                 process_cycle = queue->next_process_cycle,
+                 bank_cycle = bank_request[dram_get_channel(op_addr)][dram_get_rank(op_addr)][dram_get_bank(op_addr)].cycle_available;
+
+        if (bank_cycle > process_cycle)
+            process_cycle = bank_cycle;
+        if (process_cycle < next_cycle)
+            next_cycle = process_cycle;
+    }
+
+    return next_cycle;
+}
+
+uint64_t MEMORY_CONTROLLER::next_event_cycle()
+{
+    // earliest cycle at which operate() can change any state
+    uint64_t next_cycle = UINT64_MAX;
+
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+        // read/write mode switch happens on the next operate()
+        if ((write_mode[i] == 0) && (WQ[i].occupancy >= DRAM_WRITE_HIGH_WM))
+            return 0;
+        if (write_mode[i] && ((WQ[i].occupancy == 0) || (RQ[i].occupancy && (WQ[i].occupancy < DRAM_WRITE_LOW_WM))))
+            return 0;
+
+        uint64_t channel_cycle = write_mode[i] ? next_queue_event(&WQ[i]) : next_queue_event(&RQ[i]);
+        if (channel_cycle < next_cycle)
+            next_cycle = channel_cycle;
+    }
+
+    return next_cycle;
+}
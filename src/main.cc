@@ -1,8 +1,20 @@
 #define _BSD_SOURCE
 
 #include <getopt.h>
+#include <atomic>
+#include <thread>
 #include "ooo_cpu.h"
 #include "uncore.h"
+#include "checkpoint.h"
+#include "simpoint.h"
+#include "compact_trace.h"
+#include "trace_server.h"
+#include "config.h"
+#include "variant.h"
+#include "sampling.h"
+#include "profiler.h"
+#include "miss_stream.h"
+#include "policy.h"
 
 
 uint8_t warmup_complete[NUM_CPUS], 
@@ -11,13 +23,31 @@ uint8_t warmup_complete[NUM_CPUS],
         all_simulation_complete = 0,
         MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS,
         knob_cloudsuite = 0,
-        knob_low_bandwidth = 0;
+        knob_low_bandwidth = 0,
+        knob_skip_idle = 0,
+        knob_threads = 0,
+        knob_functional_warmup = 0,
+        show_heartbeat = 1;
 
 uint64_t warmup_instructions     = 1000000,
          simulation_instructions = 10000000,
+         sim_quantum = 1,
+         skip_instructions = 0,
          champsim_seed;
 
 time_t start_time;
+uint64_t skipped_cycles = 0;
+
+// checkpoint
+char checkpoint_in[1024];
+uint64_t next_checkpoint_instr = 0;
+uint8_t warmup_checkpoint_written = 0;
+volatile sig_atomic_t checkpoint_signal = 0;
+
+// host threads, one per core
+std::atomic<uint64_t> quantum_epoch(0);
+std::atomic<uint32_t> cores_done(0);
+std::atomic<uint8_t> stop_threads(0);
 
 // PAGE TABLE
 uint32_t PAGE_TABLE_LATENCY = 0, SWAP_LATENCY = 0;
@@ -89,6 +119,12 @@ void print_mlp(CACHE *cache)
     }
 }
 
+// in percent, 0 for a cache that saw no accesses of a type
+double hit_rate(uint64_t hit, uint64_t access)
+{
+    return access ? 100*((double)hit/(double)access) : 0;
+}
+
 void print_roi_stats(uint32_t cpu, CACHE *cache)
 {
     uint64_t TOTAL_ACCESS = 0, TOTAL_HIT = 0, TOTAL_MISS = 0;
@@ -100,7 +136,7 @@ void print_roi_stats(uint32_t cpu, CACHE *cache)
     }
 
     cout << cache->NAME;
-    cout << " TOTAL     ACCESS: " << setw(10) << TOTAL_ACCESS << "  HIT: " << setw(10) << TOTAL_HIT << "  MISS: " << setw(10) << TOTAL_MISS << " HIT RATE: " << setw(10) << 100*((double)TOTAL_HIT/(double)TOTAL_ACCESS) << endl;
+    cout << " TOTAL     ACCESS: " << setw(10) << TOTAL_ACCESS << "  HIT: " << setw(10) << TOTAL_HIT << "  MISS: " << setw(10) << TOTAL_MISS << " HIT RATE: " << setw(10) << hit_rate(TOTAL_HIT, TOTAL_ACCESS) << endl;
 
     cout << cache->NAME;
     cout << " LOAD      ACCESS: " << setw(10) << cache->roi_access[cpu][0] << "  HIT: " << setw(10) << cache->roi_hit[cpu][0] << "  MISS: " << setw(10) << cache->roi_miss[cpu][0] << endl;
@@ -150,19 +186,19 @@ void print_sim_stats(uint32_t cpu, CACHE *cache)
     }
 
     cout << cache->NAME;
-    cout << " TOTAL     ACCESS: " << setw(10) << TOTAL_ACCESS << "  HIT: " << setw(10) << TOTAL_HIT << "  MISS: " << setw(10) << TOTAL_MISS << " HIT RATE: " << setw(10) << (double)(TOTAL_HIT/TOTAL_ACCESS) << endl;
+    cout << " TOTAL     ACCESS: " << setw(10) << TOTAL_ACCESS << "  HIT: " << setw(10) << TOTAL_HIT << "  MISS: " << setw(10) << TOTAL_MISS << " HIT RATE: " << setw(10) << hit_rate(TOTAL_HIT, TOTAL_ACCESS) << endl;
 
     cout << cache->NAME;
-    cout << " LOAD      ACCESS: " << setw(10) << cache->sim_access[cpu][0] << "  HIT: " << setw(10) << cache->sim_hit[cpu][0] << "  MISS: " << setw(10) << cache->sim_miss[cpu][0] << " HIT RATE: " << setw(10) << (double)(cache->sim_hit[cpu][0]/cache->sim_access[cpu][0]) << endl;
+    cout << " LOAD      ACCESS: " << setw(10) << cache->sim_access[cpu][0] << "  HIT: " << setw(10) << cache->sim_hit[cpu][0] << "  MISS: " << setw(10) << cache->sim_miss[cpu][0] << " HIT RATE: " << setw(10) << hit_rate(cache->sim_hit[cpu][0], cache->sim_access[cpu][0]) << endl;
 
     cout << cache->NAME;
-    cout << " RFO       ACCESS: " << setw(10) << cache->sim_access[cpu][1] << "  HIT: " << setw(10) << cache->sim_hit[cpu][1] << "  MISS: " << setw(10) << cache->sim_miss[cpu][1] << " HIT RATE: " << setw(10) << (double)(cache->sim_hit[cpu][1]/cache->sim_access[cpu][1]) << endl;
+    cout << " RFO       ACCESS: " << setw(10) << cache->sim_access[cpu][1] << "  HIT: " << setw(10) << cache->sim_hit[cpu][1] << "  MISS: " << setw(10) << cache->sim_miss[cpu][1] << " HIT RATE: " << setw(10) << hit_rate(cache->sim_hit[cpu][1], cache->sim_access[cpu][1]) << endl;
 
     cout << cache->NAME;
-    cout << " PREFETCH  ACCESS: " << setw(10) << cache->sim_access[cpu][2] << "  HIT: " << setw(10) << cache->sim_hit[cpu][2] << "  MISS: " << setw(10) << cache->sim_miss[cpu][2] << " HIT RATE: " << setw(10) << (double)(cache->sim_hit[cpu][2]/cache->sim_access[cpu][2]) << endl;
+    cout << " PREFETCH  ACCESS: " << setw(10) << cache->sim_access[cpu][2] << "  HIT: " << setw(10) << cache->sim_hit[cpu][2] << "  MISS: " << setw(10) << cache->sim_miss[cpu][2] << " HIT RATE: " << setw(10) << hit_rate(cache->sim_hit[cpu][2], cache->sim_access[cpu][2]) << endl;
 
     cout << cache->NAME;
-    cout << " WRITEBACK ACCESS: " << setw(10) << cache->sim_access[cpu][3] << "  HIT: " << setw(10) << cache->sim_hit[cpu][3] << "  MISS: " << setw(10) << cache->sim_miss[cpu][3] << " HIT RATE: " << setw(10) << (double)(cache->sim_hit[cpu][3]/cache->sim_access[cpu][3]) << endl;
+    cout << " WRITEBACK ACCESS: " << setw(10) << cache->sim_access[cpu][3] << "  HIT: " << setw(10) << cache->sim_hit[cpu][3] << "  MISS: " << setw(10) << cache->sim_miss[cpu][3] << " HIT RATE: " << setw(10) << hit_rate(cache->sim_hit[cpu][3], cache->sim_access[cpu][3]) << endl;
 }
 
 void print_branch_stats()
@@ -170,7 +206,7 @@ void print_branch_stats()
     for (uint32_t i=0; i<NUM_CPUS; i++) {
         cout << endl << "CPU " << i << " Branch Prediction Accuracy: ";
         cout << (100.0*(ooo_cpu[i].num_branch - ooo_cpu[i].branch_mispredictions)) / ooo_cpu[i].num_branch;
-        cout << "% MPKI: " << (1000.0*ooo_cpu[i].branch_mispredictions)/(ooo_cpu[i].num_retired - ooo_cpu[i].warmup_instructions) << endl;
+        cout << "% MPKI: " << (1000.0*ooo_cpu[i].branch_mispredictions)/(ooo_cpu[i].num_retired - ooo_cpu[i].warmup_instructions - fast_forward_instr[i]) << endl;
     }
 }
 
@@ -180,19 +216,19 @@ void print_dram_stats()
     cout << "DRAM Statistics" << endl;
     for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
         cout << " CHANNEL " << i << endl;
-        cout << " RQ ROW_BUFFER_HIT: " << setw(10) << uncore.DRAM.RQ[i].ROW_BUFFER_HIT << "  ROW_BUFFER_MISS: " << setw(10) << uncore.DRAM.RQ[i].ROW_BUFFER_MISS << endl;
-        cout << " DBUS_CONGESTED: " << setw(10) << uncore.DRAM.dbus_congested[NUM_TYPES][NUM_TYPES] << endl; 
-        cout << " WQ ROW_BUFFER_HIT: " << setw(10) << uncore.DRAM.WQ[i].ROW_BUFFER_HIT << "  ROW_BUFFER_MISS: " << setw(10) << uncore.DRAM.WQ[i].ROW_BUFFER_MISS;
-        cout << "  FULL: " << setw(10) << uncore.DRAM.WQ[i].FULL << endl; 
+        cout << " RQ ROW_BUFFER_HIT: " << setw(10) << uncore->DRAM.RQ[i].ROW_BUFFER_HIT << "  ROW_BUFFER_MISS: " << setw(10) << uncore->DRAM.RQ[i].ROW_BUFFER_MISS << endl;
+        cout << " DBUS_CONGESTED: " << setw(10) << uncore->DRAM.dbus_congested[NUM_TYPES][NUM_TYPES] << endl; 
+        cout << " WQ ROW_BUFFER_HIT: " << setw(10) << uncore->DRAM.WQ[i].ROW_BUFFER_HIT << "  ROW_BUFFER_MISS: " << setw(10) << uncore->DRAM.WQ[i].ROW_BUFFER_MISS;
+        cout << "  FULL: " << setw(10) << uncore->DRAM.WQ[i].FULL << endl; 
         cout << endl;
     }
 
     uint64_t total_congested_cycle = 0;
     for (uint32_t i=0; i<DRAM_CHANNELS; i++)
-        total_congested_cycle += uncore.DRAM.dbus_cycle_congested[i];
+        total_congested_cycle += uncore->DRAM.dbus_cycle_congested[i];
     
-    if (uncore.DRAM.dbus_congested[NUM_TYPES][NUM_TYPES])
-        cout << " AVG_CONGESTED_CYCLE: " << (total_congested_cycle / uncore.DRAM.dbus_congested[NUM_TYPES][NUM_TYPES]) << endl;
+    if (uncore->DRAM.dbus_congested[NUM_TYPES][NUM_TYPES])
+        cout << " AVG_CONGESTED_CYCLE: " << (total_congested_cycle / uncore->DRAM.dbus_congested[NUM_TYPES][NUM_TYPES]) << endl;
     else
         cout << " AVG_CONGESTED_CYCLE: 0" << endl;
 }
@@ -296,16 +332,16 @@ void finish_warmup()
         reset_cache_stats(i, &ooo_cpu[i].DTLB);
         reset_cache_stats(i, &ooo_cpu[i].ITLB);
         reset_cache_stats(i, &ooo_cpu[i].STLB);
-        reset_cache_stats(i, &uncore.LLC);
+        reset_cache_stats(i, &uncore->LLC);
     }
     cout << endl;
 
     // reset DRAM stats
     for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
-        uncore.DRAM.RQ[i].ROW_BUFFER_HIT = 0;
-        uncore.DRAM.RQ[i].ROW_BUFFER_MISS = 0;
-        uncore.DRAM.WQ[i].ROW_BUFFER_HIT = 0;
-        uncore.DRAM.WQ[i].ROW_BUFFER_MISS = 0;
+        uncore->DRAM.RQ[i].ROW_BUFFER_HIT = 0;
+        uncore->DRAM.RQ[i].ROW_BUFFER_MISS = 0;
+        uncore->DRAM.WQ[i].ROW_BUFFER_HIT = 0;
+        uncore->DRAM.WQ[i].ROW_BUFFER_MISS = 0;
     }
 
     // set actual cache latency
@@ -317,7 +353,10 @@ void finish_warmup()
         ooo_cpu[i].L1D.LATENCY  = L1D_LATENCY;
         ooo_cpu[i].L2C.LATENCY  = L2C_LATENCY;
     }
-    uncore.LLC.LATENCY = LLC_LATENCY;
+    uncore->LLC.LATENCY = LLC_LATENCY;
+
+    if (miss_recorder)
+        miss_recorder->mark(MISS_MARK_WARMUP, 0);
 }
 
 void print_deadlock(uint32_t i)
@@ -356,8 +395,29 @@ void print_deadlock(uint32_t i)
     assert(0);
 }
 
+// option values go into fixed buffers, one that does not fit is an error rather than a truncated path
+void copy_option(char *buffer, size_t size, const char *value)
+{
+    if ((size_t)snprintf(buffer, size, "%s", value) >= size) {
+        cerr << "*** Option value too long: " << value << " ***" << endl;
+        assert(0);
+    }
+}
+
 void signal_handler(int signal) 
 {
+    // the checkpoint is written once the current cycle or functional instruction is complete
+    // until every core has read its first instruction, e.g., while -skip_instructions decodes the trace, there is nothing to save
+    uint8_t started = 1;
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        if (ooo_cpu[i].instr_unique_id == 0)
+            started = 0;
+    }
+    if (checkpoint_out[0] && started) {
+        checkpoint_signal = signal;
+        return;
+    }
+
 	cout << "Caught signal: " << signal << endl;
 	exit(1);
 }
@@ -394,6 +454,9 @@ uint64_t rotr64 (uint64_t n, unsigned int c)
 RANDOM champsim_rand(champsim_seed);
 uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_vpage)
 {
+    // page table and page allocator are shared by all cores
+    UNCORE_LOCK lock(cpu);
+
 #ifdef SANITY_CHECK
     if (va == 0) 
         assert(0);
@@ -480,7 +543,7 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
                 ooo_cpu[cpu].L1I.invalidate_entry(cl_addr);
                 ooo_cpu[cpu].L1D.invalidate_entry(cl_addr);
                 ooo_cpu[cpu].L2C.invalidate_entry(cl_addr);
-                uncore.LLC.invalidate_entry(cl_addr);
+                uncore->LLC.invalidate_entry(cl_addr);
             }
 
             // swap complete
@@ -571,6 +634,207 @@ uint64_t va_to_pa(uint32_t cpu, uint64_t instr_id, uint64_t va, uint64_t unique_
     return pa;
 }
 
+void operate_core(uint32_t i)
+{
+    // proceed one cycle
+    current_core_cycle[i]++;
+
+    //cout << "Trying to process instr_id: " << ooo_cpu[i].instr_unique_id << " fetch_stall: " << +ooo_cpu[i].fetch_stall;
+    //cout << " stall_cycle: " << stall_cycle[i] << " current: " << current_core_cycle[i] << endl;
+
+    // core might be stalled due to page fault or branch misprediction
+    if (stall_cycle[i] <= current_core_cycle[i]) {
+
+        // fetch unit
+        if (ooo_cpu[i].ROB.occupancy < ooo_cpu[i].ROB.SIZE) {
+            // handle branch
+            if ((ooo_cpu[i].fetch_stall == 0) && (sample_drain == 0)) {
+                profile_enter(PROFILE_HANDLE_BRANCH);
+                ooo_cpu[i].handle_branch();
+                profile_exit();
+            }
+        }
+
+        // fetch
+        profile_enter(PROFILE_FETCH);
+        ooo_cpu[i].fetch_instruction();
+        profile_exit();
+
+
+        // schedule (including decode latency)
+        uint32_t schedule_index = ooo_cpu[i].ROB.next_schedule;
+        if ((ooo_cpu[i].ROB.entry[schedule_index].scheduled == 0) && (ooo_cpu[i].ROB.entry[schedule_index].event_cycle <= current_core_cycle[i])) {
+            profile_enter(PROFILE_SCHEDULE);
+            ooo_cpu[i].schedule_instruction();
+            profile_exit();
+        }
+
+        // execute
+        profile_enter(PROFILE_EXECUTE);
+        ooo_cpu[i].execute_instruction();
+        profile_exit();
+
+        // memory operation
+        profile_enter(PROFILE_LSQ);
+        ooo_cpu[i].schedule_memory_instruction();
+        profile_exit();
+        ooo_cpu[i].execute_memory_instruction();
+
+        // complete 
+        profile_enter(PROFILE_UPDATE_ROB);
+        ooo_cpu[i].update_rob();
+        profile_exit();
+
+        // retire
+        if ((ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].executed == COMPLETED) && (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle <= current_core_cycle[i])) {
+            profile_enter(PROFILE_RETIRE_ROB);
+            ooo_cpu[i].retire_rob();
+            profile_exit();
+        }
+    }
+}
+
+void print_simulation_time()
+{
+    uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time),
+             elapsed_minute = elapsed_second / 60,
+             elapsed_hour = elapsed_minute / 60;
+    elapsed_minute -= elapsed_hour*60;
+    elapsed_second -= (elapsed_hour*3600 + elapsed_minute*60);
+
+    cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute << " min " << elapsed_second << " sec) " << endl;
+}
+
+void check_core(uint32_t i)
+{
+    // heartbeat information
+    if (show_heartbeat && (ooo_cpu[i].num_retired >= ooo_cpu[i].next_print_instruction)) {
+        float cumulative_ipc;
+        if (warmup_complete[i])
+            cumulative_ipc = (1.0*detailed_instructions(i)) / (current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle);
+        else
+            cumulative_ipc = (1.0*ooo_cpu[i].num_retired) / current_core_cycle[i];
+        float heartbeat_ipc = (1.0*ooo_cpu[i].num_retired - ooo_cpu[i].last_sim_instr) / (current_core_cycle[i] - ooo_cpu[i].last_sim_cycle);
+
+        cout << "Heartbeat CPU " << i << " instructions: " << ooo_cpu[i].num_retired << " cycles: " << current_core_cycle[i];
+        cout << " heartbeat IPC: " << heartbeat_ipc << " cumulative IPC: " << cumulative_ipc; 
+        print_simulation_time();
+        ooo_cpu[i].next_print_instruction += STAT_PRINTING_PERIOD;
+
+        ooo_cpu[i].last_sim_instr = ooo_cpu[i].num_retired;
+        ooo_cpu[i].last_sim_cycle = current_core_cycle[i];
+    }
+
+    // check for deadlock
+    if (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].ip && (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle + DEADLOCK_CYCLE) <= current_core_cycle[i])
+        print_deadlock(i);
+
+    // check for warmup
+    // warmup complete
+    if ((warmup_complete[i] == 0) && (ooo_cpu[i].num_retired > warmup_instructions)) {
+        warmup_complete[i] = 1;
+        all_warmup_complete++;
+    }
+    if (all_warmup_complete == NUM_CPUS) { // this part is called only once when all cores are warmed up
+        all_warmup_complete++;
+        finish_warmup();
+    }
+
+    /*
+    if (all_warmup_complete == 0) { 
+        all_warmup_complete = 1;
+        finish_warmup();
+    }
+    if (ooo_cpu[1].num_retired > 0)
+        warmup_complete[1] = 1;
+    */
+    
+    // simulation complete
+    if ((all_warmup_complete > NUM_CPUS) && (simulation_complete[i] == 0) && (ooo_cpu[i].num_retired >= (ooo_cpu[i].begin_sim_instr + ooo_cpu[i].simulation_instructions))) {
+        simulation_complete[i] = 1;
+        ooo_cpu[i].finish_sim_instr = detailed_instructions(i);
+        ooo_cpu[i].finish_sim_cycle = current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle;
+
+        cout << "Finished CPU " << i << " instructions: " << ooo_cpu[i].finish_sim_instr << " cycles: " << ooo_cpu[i].finish_sim_cycle;
+        cout << " cumulative IPC: " << ((float) ooo_cpu[i].finish_sim_instr / ooo_cpu[i].finish_sim_cycle);
+        print_simulation_time();
+
+        record_roi_stats(i, &ooo_cpu[i].L1D);
+        record_roi_stats(i, &ooo_cpu[i].L1I);
+        record_roi_stats(i, &ooo_cpu[i].L2C);
+        record_roi_stats(i, &ooo_cpu[i].DTLB);
+        record_roi_stats(i, &ooo_cpu[i].ITLB);
+        record_roi_stats(i, &ooo_cpu[i].STLB);
+        record_roi_stats(i, &uncore->LLC);
+
+        if (miss_recorder)
+            miss_recorder->mark(MISS_MARK_ROI_END, i);
+
+        all_simulation_complete++;
+    }
+}
+
+void core_thread(uint32_t i)
+{
+    uint64_t epoch = 0;
+    uncore_thread_begin();
+
+    while (1) {
+        // wait for the main thread to open the next quantum
+        while (quantum_epoch.load() == epoch)
+            std::this_thread::yield();
+        epoch = quantum_epoch.load();
+
+        if (stop_threads.load())
+            return;
+
+        for (uint64_t q=0; q<sim_quantum; q++) {
+            operate_core(i);
+            uncore_pass(i);
+        }
+
+        cores_done++;
+    }
+}
+
+uint64_t next_event_cycle()
+{
+    // all cores advance in lockstep, so one clock is enough to compare against
+    // cores are checked first since a busy core ends the search right away
+    uint64_t now = current_core_cycle[0],
+             next_cycle = UINT64_MAX,
+             event_cycle;
+
+    for (int i=0; i<NUM_CPUS; i++) {
+        event_cycle = ooo_cpu[i].next_event_cycle();
+
+        // nothing runs while the core is stalled by a page fault
+        if (stall_cycle[i] > event_cycle)
+            event_cycle = stall_cycle[i];
+
+        // the deadlock check runs even during stalls
+        if (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].ip && ((ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle + DEADLOCK_CYCLE) < event_cycle))
+            event_cycle = ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle + DEADLOCK_CYCLE;
+
+        if (event_cycle < next_cycle)
+            next_cycle = event_cycle;
+        if (next_cycle <= (now + 1))
+            return next_cycle;
+    }
+
+    event_cycle = uncore->LLC.next_event_cycle();
+    if (event_cycle < next_cycle)
+        next_cycle = event_cycle;
+    if (next_cycle <= (now + 1))
+        return next_cycle;
+
+    event_cycle = uncore->DRAM.next_event_cycle();
+    if (event_cycle < next_cycle)
+        next_cycle = event_cycle;
+
+    return next_cycle;
+}
+
 int main(int argc, char** argv)
 {
 	// interrupt signal hanlder
@@ -579,12 +843,10 @@ int main(int argc, char** argv)
 	sigemptyset(&sigIntHandler.sa_mask);
 	sigIntHandler.sa_flags = 0;
 	sigaction(SIGINT, &sigIntHandler, NULL);
+	sigaction(SIGTERM, &sigIntHandler, NULL);
 
     cout << endl << "*** ChampSim Multicore Out-of-Order Simulator ***" << endl << endl;
 
-    // initialize knobs
-    uint8_t show_heartbeat = 1;
-
     uint32_t seed_number = 0;
 
     // check to see if knobs changed using getopt_long()
@@ -597,6 +859,36 @@ int main(int argc, char** argv)
             {"hide_heartbeat", no_argument, 0, 'h'},
             {"cloudsuite", no_argument, 0, 'c'},
             {"low_bandwidth",  no_argument, 0, 'b'},
+            {"skip_idle",  no_argument, 0, 's'},
+            {"threads",  no_argument, 0, 'p'},
+            {"quantum",  required_argument, 0, 'q'},
+            {"checkpoint_in",  required_argument, 0, 'r'},
+            {"checkpoint_out",  required_argument, 0, 'o'},
+            {"checkpoint_interval",  required_argument, 0, 'k'},
+            {"functional_warmup",  no_argument, 0, 'f'},
+            {"skip_instructions",  required_argument, 0, 'j'},
+            {"simpoint_profile",  required_argument, 0, 'x'},
+            {"simpoint_interval",  required_argument, 0, 'n'},
+            {"simpoint_max_k",  required_argument, 0, 'm'},
+            {"convert_trace",  required_argument, 0, 'z'},
+            {"trace_cache",  required_argument, 0, 'd'},
+            {"trace_server",  required_argument, 0, 'T'},
+            {"serve_traces",  required_argument, 0, 'S'},
+            {"config",  required_argument, 0, 'g'},
+            {"variant",  required_argument, 0, 'v'},
+            {"sample_period",  required_argument, 0, 'a'},
+            {"sample_warmup",  required_argument, 0, 'y'},
+            {"sample_size",  required_argument, 0, 'u'},
+            {"sample_error",  required_argument, 0, 'e'},
+            {"profile",  required_argument, 0, 'l'},
+            {"record_misses",  required_argument, 0, 'M'},
+            {"record_level",  required_argument, 0, 'L'},
+            {"replay_misses",  required_argument, 0, 'P'},
+            {"replay_mlp",  required_argument, 0, 'C'},
+            {"branch_predictor",  required_argument, 0, 'B'},
+            {"l1d_prefetcher",  required_argument, 0, 'D'},
+            {"l2c_prefetcher",  required_argument, 0, 'K'},
+            {"llc_replacement",  required_argument, 0, 'R'},
             {"traces",  no_argument, 0, 't'},
             {0, 0, 0, 0}      
         };
@@ -628,6 +920,108 @@ int main(int argc, char** argv)
             case 'b':
                 knob_low_bandwidth = 1;
                 break;
+            case 's':
+                knob_skip_idle = 1;
+                break;
+            case 'p':
+                knob_threads = 1;
+                break;
+            case 'q':
+                sim_quantum = atol(optarg);
+                break;
+            case 'r':
+                copy_option(checkpoint_in, sizeof(checkpoint_in), optarg);
+                break;
+            case 'o':
+                copy_option(checkpoint_out, sizeof(checkpoint_out), optarg);
+                break;
+            case 'k':
+                checkpoint_interval = atol(optarg);
+                break;
+            case 'f':
+                knob_functional_warmup = 1;
+                break;
+            case 'j':
+                skip_instructions = atol(optarg);
+                break;
+            case 'x':
+                copy_option(simpoint_profile_out, sizeof(simpoint_profile_out), optarg);
+                break;
+            case 'n':
+                simpoint_interval = atol(optarg);
+                break;
+            case 'm':
+                simpoint_max_k = atol(optarg);
+                break;
+            case 'z':
+                copy_option(convert_trace_out, sizeof(convert_trace_out), optarg);
+                break;
+            case 'd':
+                copy_option(trace_cache_dir, sizeof(trace_cache_dir), optarg);
+                break;
+            case 'T':
+                copy_option(trace_server_name, sizeof(trace_server_name), optarg);
+                break;
+            case 'S':
+                copy_option(serve_traces_name, sizeof(serve_traces_name), optarg);
+                break;
+            case 'g':
+                read_config(optarg);
+                break;
+            case 'v':
+                if (num_variants == MAX_VARIANTS) {
+                    cout << "Too many variants, at most " << MAX_VARIANTS << "!" << endl;
+                    assert(0);
+                }
+                copy_option(variant_config[num_variants], sizeof(variant_config[num_variants]), optarg);
+                num_variants++;
+                break;
+            case 'a':
+                sample_period = atol(optarg);
+                break;
+            case 'y':
+                sample_warmup = atol(optarg);
+                break;
+            case 'u':
+                sample_size = atol(optarg);
+                break;
+            case 'e':
+                sample_error = atof(optarg);
+                break;
+            case 'l':
+                profile_period = atol(optarg);
+                break;
+            case 'M':
+                copy_option(record_misses_out, sizeof(record_misses_out), optarg);
+                break;
+            case 'L':
+                if (strcmp(optarg, "L2C") == 0)
+                    record_misses_level = FILL_L2;
+                else if (strcmp(optarg, "LLC") == 0)
+                    record_misses_level = FILL_LLC;
+                else {
+                    cout << "Misses can only be recorded below L2C or LLC!" << endl;
+                    assert(0);
+                }
+                break;
+            case 'P':
+                copy_option(replay_misses_in, sizeof(replay_misses_in), optarg);
+                break;
+            case 'C':
+                replay_mlp = atol(optarg);
+                break;
+            case 'B':
+                select_policy(BRANCH_PREDICTOR, optarg);
+                break;
+            case 'D':
+                select_policy(L1D_PREFETCHER, optarg);
+                break;
+            case 'K':
+                select_policy(L2C_PREFETCHER, optarg);
+                break;
+            case 'R':
+                select_policy(LLC_REPLACEMENT, optarg);
+                break;
             case 't':
                 traces_encountered = 1;
                 break;
@@ -639,18 +1033,101 @@ int main(int argc, char** argv)
             break;
     }
 
+    // a trace server only serves traces to other simulators
+    if (serve_traces_name[0]) {
+        serve_traces(serve_traces_name);
+        return 0;
+    }
+
+    // every variant continues from here as its own simulator, the parent only feeds the traces
+    if (num_variants)
+        variant_fork(argc, argv);
+
     // consequences of knobs
+    check_config();
+    load_policies();
     cout << "Warmup Instructions: " << warmup_instructions << endl;
     cout << "Simulation Instructions: " << simulation_instructions << endl;
     //cout << "Scramble Loads: " << (knob_scramble_loads ? "ture" : "false") << endl;
+    cout << "Skip Idle Cycles: " << (knob_skip_idle ? "true" : "false") << endl;
+    cout << "Functional Warmup: " << (knob_functional_warmup ? "true" : "false") << endl;
+    if (sim_quantum == 0) {
+        cout << "Quantum must be at least one cycle!" << endl;
+        assert(0);
+    }
+    if (knob_threads)
+        cout << "Host Threads: " << NUM_CPUS << " Quantum: " << sim_quantum << (sim_quantum == 1 ? " (lock-step)" : " (relaxed, nondeterministic)") << endl;
+    if (checkpoint_in[0])
+        cout << "Restore Checkpoint: " << checkpoint_in << endl;
+    if (checkpoint_out[0]) {
+        cout << "Write Checkpoint: " << checkpoint_out;
+        if (checkpoint_interval)
+            cout << " every " << checkpoint_interval << " instructions";
+        cout << endl;
+    }
+    else if (checkpoint_interval) {
+        cout << "Checkpoint interval requires -checkpoint_out!" << endl;
+        assert(0);
+    }
+    if (skip_instructions) {
+        cout << "Skip Instructions: " << skip_instructions << endl;
+        if (checkpoint_in[0]) {
+            cout << "Skip instructions cannot be combined with -checkpoint_in!" << endl;
+            assert(0);
+        }
+    }
+    if (simpoint_profile_out[0]) {
+        cout << "SimPoint Profile: " << simpoint_profile_out << " interval: " << simpoint_interval << " max k: " << simpoint_max_k << endl;
+        if ((simpoint_interval == 0) || (simpoint_max_k == 0)) {
+            cout << "SimPoint interval and max k must be at least one!" << endl;
+            assert(0);
+        }
+    }
+    if (convert_trace_out[0]) {
+        cout << "Convert Trace: " << convert_trace_out << endl;
+        if (simpoint_profile_out[0]) {
+            cout << "Trace conversion cannot be combined with -simpoint_profile!" << endl;
+            assert(0);
+        }
+    }
+    if (trace_cache_dir[0])
+        cout << "Trace Cache: " << trace_cache_dir << endl;
+    if (trace_server_name[0])
+        cout << "Trace Server: " << trace_server_name << (trace_cache_dir[0] ? " (cached traces are mapped instead)" : "") << endl;
+    if (sample_period) {
+        cout << "Sampling Period: " << sample_period << " detailed warmup: " << sample_warmup << " sample size: " << sample_size << " error: " << sample_error << endl;
+        if ((sample_size == 0) || (sample_period <= sample_warmup + sample_size)) {
+            cout << "Sample size must be at least one and the period longer than detailed warmup plus sample size!" << endl;
+            assert(0);
+        }
+    }
+    if (profile_period) {
+        cout << "Profile: one cycle in " << profile_period << endl;
+        if (knob_threads) {
+            cout << "Profiling cannot be combined with -threads!" << endl;
+            assert(0);
+        }
+    }
+    if (record_misses_out[0]) {
+        cout << "Record Misses: " << record_misses_out << " below " << ((record_misses_level == FILL_L2) ? "L2C" : "LLC") << endl;
+        if (replay_misses_in[0] || sample_period) {
+            cout << "Recording misses cannot be combined with -replay_misses or -sample_period!" << endl;
+            assert(0);
+        }
+    }
+    if (replay_misses_in[0]) {
+        cout << "Replay Misses: " << replay_misses_in << " pacing: ";
+        if (replay_mlp)
+            cout << "closed loop, at most " << replay_mlp << " demand reads in flight per core" << endl;
+        else
+            cout << "open loop" << endl;
+    }
     cout << "Number of CPUs: " << NUM_CPUS << endl;
     cout << "LLC sets: " << LLC_SET << endl;
     cout << "LLC ways: " << LLC_WAY << endl;
 
     if (knob_low_bandwidth)
         DRAM_MTPS = 400;
-    else
-        DRAM_MTPS = 1600;
 
     // DRAM access latency
     tRP  = tRP_DRAM_CYCLE  * (CPU_FREQ / DRAM_IO_FREQ); 
@@ -667,6 +1144,10 @@ int main(int argc, char** argv)
 
     // end consequence of knobs
 
+    // the simulated machine is sized by the configuration
+    ooo_cpu = new O3_CPU[NUM_CPUS];
+    uncore = new UNCORE;
+
     // search through the argv for "-traces"
     int found_traces = 0;
     int count_traces = 0;
@@ -675,19 +1156,7 @@ int main(int argc, char** argv)
         if (found_traces) {
             printf("CPU %d runs %s\n", count_traces, argv[i]);
 
-            sprintf(ooo_cpu[count_traces].trace_string, "%s", argv[i]);
-
-            char *full_name = ooo_cpu[count_traces].trace_string,
-                 *last_dot = strrchr(ooo_cpu[count_traces].trace_string, '.');
-
-            if (full_name[last_dot - full_name + 1] == 'g') // gzip format
-                sprintf(ooo_cpu[count_traces].gunzip_command, "gunzip -c %s", argv[i]);
-            else if (full_name[last_dot - full_name + 1] == 'x') // xz
-                sprintf(ooo_cpu[count_traces].gunzip_command, "xz -dc %s", argv[i]);
-            else {
-                cout << "ChampSim does not support traces other than gz or xz compression!" << endl; 
-                assert(0);
-            }
+            copy_option(ooo_cpu[count_traces].trace_string, sizeof(ooo_cpu[count_traces].trace_string), argv[i]);
 
             char *pch[100];
             int count_str = 0;
@@ -708,11 +1177,12 @@ int main(int argc, char** argv)
                 j++;
             }
 
-            ooo_cpu[count_traces].trace_file = popen(ooo_cpu[count_traces].gunzip_command, "r");
-            if (ooo_cpu[count_traces].trace_file == NULL) {
-                printf("\n*** Trace file not found: %s ***\n\n", argv[i]);
-                assert(0);
-            }
+            // the trace format is taken from the file extension (gz, xz or zst)
+            uint32_t instr_size = knob_cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr);
+            if (num_variants)
+                ooo_cpu[count_traces].trace.open_pipe(fdopen(variant_trace_fd[count_traces], "r"), instr_size);
+            else
+                ooo_cpu[count_traces].trace.open(ooo_cpu[count_traces].trace_string, instr_size);
 
             count_traces++;
             if (count_traces > NUM_CPUS) {
@@ -725,7 +1195,8 @@ int main(int argc, char** argv)
         }
     }
 
-    if (count_traces != NUM_CPUS) {
+    // a miss stream replay has no cores to feed
+    if ((count_traces != NUM_CPUS) && (replay_misses_in[0] == 0)) {
         printf("\n*** Not enough traces for the configured number of cores ***\n\n");
         assert(0);
     }
@@ -787,23 +1258,23 @@ int main(int argc, char** argv)
         ooo_cpu[i].L2C.fill_level = FILL_L2;
         ooo_cpu[i].L2C.upper_level_icache[i] = &ooo_cpu[i].L1I;
         ooo_cpu[i].L2C.upper_level_dcache[i] = &ooo_cpu[i].L1D;
-        ooo_cpu[i].L2C.lower_level = &uncore.LLC;
+        ooo_cpu[i].L2C.lower_level = &uncore->LLC;
         ooo_cpu[i].L2C.l2c_prefetcher_initialize();
 
         // SHARED CACHE
-        uncore.LLC.cache_type = IS_LLC;
-        uncore.LLC.fill_level = FILL_LLC;
-        uncore.LLC.upper_level_icache[i] = &ooo_cpu[i].L2C;
-        uncore.LLC.upper_level_dcache[i] = &ooo_cpu[i].L2C;
-        uncore.LLC.lower_level = &uncore.DRAM;
+        uncore->LLC.cache_type = IS_LLC;
+        uncore->LLC.fill_level = FILL_LLC;
+        uncore->LLC.upper_level_icache[i] = &ooo_cpu[i].L2C;
+        uncore->LLC.upper_level_dcache[i] = &ooo_cpu[i].L2C;
+        uncore->LLC.lower_level = &uncore->DRAM;
 
         // OFF-CHIP DRAM
-        uncore.DRAM.fill_level = FILL_DRAM;
-        uncore.DRAM.upper_level_icache[i] = &uncore.LLC;
-        uncore.DRAM.upper_level_dcache[i] = &uncore.LLC;
+        uncore->DRAM.fill_level = FILL_DRAM;
+        uncore->DRAM.upper_level_icache[i] = &uncore->LLC;
+        uncore->DRAM.upper_level_dcache[i] = &uncore->LLC;
         for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
-            uncore.DRAM.RQ[i].is_RQ = 1;
-            uncore.DRAM.WQ[i].is_WQ = 1;
+            uncore->DRAM.RQ[i].is_RQ = 1;
+            uncore->DRAM.WQ[i].is_WQ = 1;
         }
 
         warmup_complete[i] = 0;
@@ -821,133 +1292,199 @@ int main(int argc, char** argv)
         major_fault[i] = 0;
     }
 
-    uncore.LLC.llc_initialize_replacement();
+    uncore->LLC.llc_initialize_replacement();
 
-    // simulation entry point
-    start_time = time(NULL);
-    uint8_t run_simulation = 1;
-    while (run_simulation) {
+    if (replay_misses_in[0]) {
+        start_time = time(NULL);
+        replay_misses(replay_misses_in);
+        return 0;
+    }
 
-        uint64_t elapsed_second = (uint64_t)(time(NULL) - start_time),
-                 elapsed_minute = elapsed_second / 60,
-                 elapsed_hour = elapsed_minute / 60;
-        elapsed_minute -= elapsed_hour*60;
-        elapsed_second -= (elapsed_hour*3600 + elapsed_minute*60);
+    // SimPoint phase analysis only reads the trace of CPU 0
+    if (simpoint_profile_out[0]) {
+        simpoint_profile(&ooo_cpu[0], simpoint_profile_out);
+        return 0;
+    }
 
-        for (int i=0; i<NUM_CPUS; i++) {
-            // proceed one cycle
-            current_core_cycle[i]++;
+    // conversion to the compact trace format only reads the trace of CPU 0
+    if (convert_trace_out[0]) {
+        convert_trace(&ooo_cpu[0], convert_trace_out);
+        return 0;
+    }
 
-            //cout << "Trying to process instr_id: " << ooo_cpu[i].instr_unique_id << " fetch_stall: " << +ooo_cpu[i].fetch_stall;
-            //cout << " stall_cycle: " << stall_cycle[i] << " current: " << current_core_cycle[i] << endl;
+    // fast-forward to the region of interest, e.g., a simulation point
+    if (skip_instructions) {
+        for (int i=0; i<NUM_CPUS; i++)
+            ooo_cpu[i].skip_trace(skip_instructions);
+    }
 
-            // core might be stalled due to page fault or branch misprediction
-            if (stall_cycle[i] <= current_core_cycle[i]) {
+    if (checkpoint_in[0]) {
+        read_checkpoint(checkpoint_in);
+        if (all_warmup_complete > NUM_CPUS)
+            warmup_checkpoint_written = 1;
+    }
+    if (checkpoint_interval)
+        next_checkpoint_instr = ooo_cpu[0].num_retired + checkpoint_interval;
 
-                // fetch unit
-                if (ooo_cpu[i].ROB.occupancy < ooo_cpu[i].ROB.SIZE) {
-                    // handle branch
-                    if (ooo_cpu[i].fetch_stall == 0) 
-                        ooo_cpu[i].handle_branch();
+    // simulation entry point
+    start_time = time(NULL);
+    profile_start();
+
+    // functional warmup, cores take turns one instruction at a time
+    // the timing model takes over at the first check_core(), which calls finish_warmup()
+    if (knob_functional_warmup) {
+        profile_functional_begin();
+        uint8_t functional_cores = NUM_CPUS;
+        while (functional_cores && (checkpoint_signal == 0)) {
+            functional_cores = 0;
+            for (int i=0; i<NUM_CPUS; i++) {
+                if (ooo_cpu[i].num_retired > warmup_instructions)
+                    continue;
+
+                ooo_cpu[i].functional_instruction();
+                functional_cores++;
+
+                if (show_heartbeat && (ooo_cpu[i].num_retired >= ooo_cpu[i].next_print_instruction)) {
+                    cout << "Functional warmup CPU " << i << " instructions: " << ooo_cpu[i].num_retired;
+                    print_simulation_time();
+                    ooo_cpu[i].next_print_instruction += STAT_PRINTING_PERIOD;
                 }
+            }
+        }
 
-                // fetch
-                ooo_cpu[i].fetch_instruction();
-
+        for (int i=0; i<NUM_CPUS; i++)
+            ooo_cpu[i].last_sim_instr = ooo_cpu[i].num_retired;
+        profile_functional_end();
 
-                // schedule (including decode latency)
-                uint32_t schedule_index = ooo_cpu[i].ROB.next_schedule;
-                if ((ooo_cpu[i].ROB.entry[schedule_index].scheduled == 0) && (ooo_cpu[i].ROB.entry[schedule_index].event_cycle <= current_core_cycle[i]))
-                    ooo_cpu[i].schedule_instruction();
+        // nothing is in flight, so the checkpoint resumes the functional warmup where it stopped
+        if (checkpoint_signal) {
+            cout << "Caught signal: " << checkpoint_signal << endl;
+            write_checkpoint(checkpoint_out);
+            exit(1);
+        }
+    }
+    uint8_t run_simulation = 1;
+    std::thread core_threads[NUM_CPUS];
+    if (knob_threads) {
+        for (int i=0; i<NUM_CPUS; i++) {
+            uncore_port[i].cpu = i;
+            uncore_port[i].lower_level = &uncore->LLC;
+            ooo_cpu[i].L2C.lower_level = &uncore_port[i];
+            core_threads[i] = std::thread(core_thread, i);
+        }
+    }
 
-                // execute
-                ooo_cpu[i].execute_instruction();
+    // the recorder sits right above the next level, below the uncore ports of core threads
+    if (record_misses_out[0]) {
+        miss_recorder = new MISS_RECORDER;
+        miss_recorder->open(record_misses_out, record_misses_level);
+        if (record_misses_level == FILL_L2) {
+            miss_recorder->lower_level = &uncore->LLC;
+            for (int i=0; i<NUM_CPUS; i++) {
+                if (knob_threads)
+                    uncore_port[i].lower_level = miss_recorder;
+                else
+                    ooo_cpu[i].L2C.lower_level = miss_recorder;
+            }
+        }
+        else {
+            miss_recorder->lower_level = &uncore->DRAM;
+            uncore->LLC.lower_level = miss_recorder;
+        }
 
-                // memory operation
-                ooo_cpu[i].schedule_memory_instruction();
-                ooo_cpu[i].execute_memory_instruction();
+        // e.g., restored from a checkpoint taken after the warmup
+        if (all_warmup_complete > NUM_CPUS)
+            miss_recorder->mark(MISS_MARK_WARMUP, 0);
+    }
 
-                // complete 
-                ooo_cpu[i].update_rob();
+    while (run_simulation) {
+        profile_cycle_begin();
+
+        if (knob_threads) {
+            // every core runs one quantum on its own host thread
+            uint64_t quantum_start = current_core_cycle[0];
+            cores_done.store(0);
+            quantum_epoch++;
+            while (cores_done.load() < NUM_CPUS)
+                std::this_thread::yield();
+            uncore_reset_turn();
+
+            for (int i=0; i<NUM_CPUS; i++)
+                check_core(i);
+
+            // then the uncore catches up cycle by cycle
+            for (uint64_t cycle=quantum_start+1; cycle<=quantum_start+sim_quantum; cycle++) {
+                if (sim_quantum > 1) {
+                    for (int i=0; i<NUM_CPUS; i++)
+                        current_core_cycle[i] = cycle;
+                }
 
-                // retire
-                if ((ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].executed == COMPLETED) && (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle <= current_core_cycle[i]))
-                    ooo_cpu[i].retire_rob();
+                uncore->LLC.operate();
+                profile_enter(PROFILE_DRAM);
+                uncore->DRAM.operate();
+                profile_exit();
+            }
+        }
+        else {
+            for (int i=0; i<NUM_CPUS; i++) {
+                operate_core(i);
+                check_core(i);
             }
 
-            // heartbeat information
-            if (show_heartbeat && (ooo_cpu[i].num_retired >= ooo_cpu[i].next_print_instruction)) {
-                float cumulative_ipc;
-                if (warmup_complete[i])
-                    cumulative_ipc = (1.0*(ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr)) / (current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle);
-                else
-                    cumulative_ipc = (1.0*ooo_cpu[i].num_retired) / current_core_cycle[i];
-                float heartbeat_ipc = (1.0*ooo_cpu[i].num_retired - ooo_cpu[i].last_sim_instr) / (current_core_cycle[i] - ooo_cpu[i].last_sim_cycle);
-
-                cout << "Heartbeat CPU " << i << " instructions: " << ooo_cpu[i].num_retired << " cycles: " << current_core_cycle[i];
-                cout << " heartbeat IPC: " << heartbeat_ipc << " cumulative IPC: " << cumulative_ipc; 
-                cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute << " min " << elapsed_second << " sec) " << endl;
-                ooo_cpu[i].next_print_instruction += STAT_PRINTING_PERIOD;
+            // TODO: should it be backward?
+            uncore->LLC.operate();
+            profile_enter(PROFILE_DRAM);
+            uncore->DRAM.operate();
+            profile_exit();
+        }
 
-                ooo_cpu[i].last_sim_instr = ooo_cpu[i].num_retired;
-                ooo_cpu[i].last_sim_cycle = current_core_cycle[i];
-            }
+        // periodic sampling switches between detailed and functional simulation between cycles
+        if (sample_period && (all_warmup_complete > NUM_CPUS))
+            sampling_operate();
 
-            // check for deadlock
-            if (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].ip && (ooo_cpu[i].ROB.entry[ooo_cpu[i].ROB.head].event_cycle + DEADLOCK_CYCLE) <= current_core_cycle[i])
-                print_deadlock(i);
+        if (all_simulation_complete == NUM_CPUS)
+            run_simulation = 0;
 
-            // check for warmup
-            // warmup complete
-            if ((warmup_complete[i] == 0) && (ooo_cpu[i].num_retired > warmup_instructions)) {
-                warmup_complete[i] = 1;
-                all_warmup_complete++;
-            }
-            if (all_warmup_complete == NUM_CPUS) { // this part is called only once when all cores are warmed up
-                all_warmup_complete++;
-                finish_warmup();
+        // checkpoints are taken between cycles, after the uncore has operated
+        if (checkpoint_out[0] && run_simulation) {
+            if (checkpoint_signal) {
+                cout << "Caught signal: " << checkpoint_signal << endl;
+                write_checkpoint(checkpoint_out);
+                run_simulation = 0;
             }
-
-            /*
-            if (all_warmup_complete == 0) { 
-                all_warmup_complete = 1;
-                finish_warmup();
+            else if ((warmup_checkpoint_written == 0) && (all_warmup_complete > NUM_CPUS)) {
+                write_checkpoint(checkpoint_out);
+                warmup_checkpoint_written = 1;
             }
-            if (ooo_cpu[1].num_retired > 0)
-                warmup_complete[1] = 1;
-            */
-            
-            // simulation complete
-            if ((all_warmup_complete > NUM_CPUS) && (simulation_complete[i] == 0) && (ooo_cpu[i].num_retired >= (ooo_cpu[i].begin_sim_instr + ooo_cpu[i].simulation_instructions))) {
-                simulation_complete[i] = 1;
-                ooo_cpu[i].finish_sim_instr = ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr;
-                ooo_cpu[i].finish_sim_cycle = current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle;
-
-                cout << "Finished CPU " << i << " instructions: " << ooo_cpu[i].finish_sim_instr << " cycles: " << ooo_cpu[i].finish_sim_cycle;
-                cout << " cumulative IPC: " << ((float) ooo_cpu[i].finish_sim_instr / ooo_cpu[i].finish_sim_cycle);
-                cout << " (Simulation time: " << elapsed_hour << " hr " << elapsed_minute << " min " << elapsed_second << " sec) " << endl;
-
-                record_roi_stats(i, &ooo_cpu[i].L1D);
-                record_roi_stats(i, &ooo_cpu[i].L1I);
-                record_roi_stats(i, &ooo_cpu[i].L2C);
-                record_roi_stats(i, &ooo_cpu[i].DTLB);
-                record_roi_stats(i, &ooo_cpu[i].ITLB);
-                record_roi_stats(i, &ooo_cpu[i].STLB);
-                record_roi_stats(i, &uncore.LLC);
-
-                all_simulation_complete++;
+            else if (checkpoint_interval && (ooo_cpu[0].num_retired >= next_checkpoint_instr)) {
+                write_checkpoint(checkpoint_out);
+                next_checkpoint_instr += checkpoint_interval;
             }
+        }
 
-            if (all_simulation_complete == NUM_CPUS){
-		run_simulation = 0;
-	    }
+        // jump all clocks to the next cycle in which something can happen
+        if (knob_skip_idle && run_simulation) {
+            uint64_t next_cycle = next_event_cycle();
+            if ((next_cycle != UINT64_MAX) && (next_cycle > (current_core_cycle[0] + 1))) {
+                skipped_cycles += next_cycle - current_core_cycle[0] - 1;
+                for (int i=0; i<NUM_CPUS; i++)
+                    current_core_cycle[i] = next_cycle - 1;
+            }
         }
 
-        // TODO: should it be backward?
-        uncore.LLC.operate();
-        uncore.DRAM.operate();
+        profile_cycle_end();
     }
 
+    if (knob_threads) {
+        stop_threads.store(1);
+        quantum_epoch++;
+        for (int i=0; i<NUM_CPUS; i++)
+            core_threads[i].join();
+    }
+
+    if (checkpoint_signal)
+        exit(1);
+
 #ifndef CRC2_COMPILE
     print_branch_stats();
 #endif
@@ -958,11 +1495,17 @@ int main(int argc, char** argv)
     elapsed_second -= (elapsed_hour*3600 + elapsed_minute*60);
     
     cout << endl << "ChampSim completed all CPUs" << endl;
+    if (knob_skip_idle)
+        cout << "Skipped idle cycles: " << skipped_cycles << endl;
+    if (miss_recorder) {
+        miss_recorder->close();
+        cout << "Recorded misses: " << miss_recorder->num_records << endl;
+    }
     if (NUM_CPUS > 1) {
         cout << endl << "Total Simulation Statistics (not including warmup)" << endl;
         for (uint32_t i=0; i<NUM_CPUS; i++) {
-            cout << endl << "CPU " << i << " cumulative IPC: " << (float) (ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr) / (current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle); 
-            cout << " instructions: " << ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr << " cycles: " << current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle << endl;
+            cout << endl << "CPU " << i << " cumulative IPC: " << (float) detailed_instructions(i) / (current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle); 
+            cout << " instructions: " << detailed_instructions(i) << " cycles: " << current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle << endl;
 #ifndef CRC2_COMPILE
             print_sim_stats(i, &ooo_cpu[i].L1D);
             print_sim_stats(i, &ooo_cpu[i].L1I);
@@ -970,7 +1513,7 @@ int main(int argc, char** argv)
             ooo_cpu[i].L1D.l1d_prefetcher_final_stats();
             ooo_cpu[i].L2C.l2c_prefetcher_final_stats();
 #endif
-            print_sim_stats(i, &uncore.LLC);
+            print_sim_stats(i, &uncore->LLC);
         }
     }
 
@@ -983,7 +1526,7 @@ int main(int argc, char** argv)
         print_roi_stats(i, &ooo_cpu[i].L1I);
         print_roi_stats(i, &ooo_cpu[i].L2C);
 #endif
-        print_roi_stats(i, &uncore.LLC);
+        print_roi_stats(i, &uncore->LLC);
         print_roi_stats(i, &ooo_cpu[i].DTLB);
         print_roi_stats(i, &ooo_cpu[i].ITLB);
         print_roi_stats(i, &ooo_cpu[i].STLB);
@@ -995,10 +1538,14 @@ int main(int argc, char** argv)
         ooo_cpu[i].L2C.l2c_prefetcher_final_stats();
     }
 
+    if (sample_period)
+        print_sampling_stats();
+
 #ifndef CRC2_COMPILE
-    uncore.LLC.llc_replacement_final_stats();
+    uncore->LLC.llc_replacement_final_stats();
     print_dram_stats();
 #endif
+    print_profile_stats();
 
     // check inclusive policy
     // ooo_cpu[0].L1D.check_inclusive();
@@ -0,0 +1,505 @@
+#include "miss_stream.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+#include <deque>
+
+char record_misses_out[1024], replay_misses_in[1024];
+uint32_t record_misses_level = FILL_L2;
+uint64_t replay_mlp = 0;
+
+MISS_RECORDER *miss_recorder = NULL;
+MISS_REPLAY_PORT replay_port[NUM_CPUS];
+
+static inline uint8_t *put_varint(uint8_t *out, uint64_t value)
+{
+    while (value >= 0x80) {
+        *out++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *out++ = value;
+
+    return out;
+}
+
+static inline uint64_t get_varint(const uint8_t *in, uint64_t &position)
+{
+    uint64_t value = 0;
+    for (uint32_t shift=0; ; shift+=7) {
+        uint8_t byte = in[position++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+}
+
+static inline uint64_t zigzag(uint64_t delta)
+{
+    return (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+}
+
+static inline uint64_t unzigzag(uint64_t value)
+{
+    return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+void MISS_RECORDER::open(const char *file_name, uint32_t level)
+{
+    file = gzopen(file_name, "wb");
+    if (file == NULL) {
+        cerr << "*** Cannot open miss stream for writing: " << file_name << " ***" << endl;
+        assert(0);
+    }
+
+    MISS_STREAM_HEADER header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MISS_STREAM_MAGIC, sizeof(header.magic));
+    header.level = level;
+    header.num_cpus = NUM_CPUS;
+    gzwrite(file, &header, sizeof(header));
+
+    buffer = new uint8_t[MISS_STREAM_BUFFER];
+    position = buffer;
+}
+
+void MISS_RECORDER::flush()
+{
+    int size = position - buffer;
+    if (size && (gzwrite(file, buffer, size) != size)) {
+        cerr << "*** Cannot write miss stream ***" << endl;
+        assert(0);
+    }
+    position = buffer;
+}
+
+void MISS_RECORDER::close()
+{
+    flush();
+    if (gzclose(file) != Z_OK) {
+        cerr << "*** Cannot write miss stream ***" << endl;
+        assert(0);
+    }
+    file = NULL;
+    delete[] buffer;
+    buffer = NULL;
+}
+
+void MISS_RECORDER::record(uint8_t queue, PACKET *packet)
+{
+    assert(packet->type < NUM_TYPES);
+    if ((position - buffer) > (MISS_STREAM_BUFFER - MISS_MAX_RECORD_BYTES))
+        flush();
+
+    uint8_t flags = queue | (packet->type << MISS_TYPE_SHIFT);
+    if (packet->instruction)
+        flags |= MISS_INSTRUCTION;
+    if (warmup_complete[packet->cpu])
+        flags |= MISS_WARMUP_COMPLETE;
+    if (packet->address != (packet->full_addr >> LOG2_BLOCK_SIZE))
+        flags |= MISS_BLOCK_ADDRESS;
+
+    uint64_t cycle = current_core_cycle[packet->cpu];
+    *position++ = flags;
+    position = put_varint(position, packet->cpu);
+    position = put_varint(position, zigzag((int64_t)packet->fill_level));
+    position = put_varint(position, zigzag(cycle - last_cycle));
+    position = put_varint(position, zigzag(packet->full_addr - last_addr));
+    position = put_varint(position, zigzag(packet->ip - last_ip));
+    if (flags & MISS_BLOCK_ADDRESS)
+        position = put_varint(position, packet->address);
+
+    last_cycle = cycle;
+    last_addr = packet->full_addr;
+    last_ip = packet->ip;
+    num_records++;
+}
+
+void MISS_RECORDER::mark(uint8_t kind, uint32_t cpu)
+{
+    if ((position - buffer) > (MISS_STREAM_BUFFER - MISS_MAX_RECORD_BYTES))
+        flush();
+
+    uint64_t cycle = current_core_cycle[cpu];
+    *position++ = MISS_MARKER | (kind << MISS_TYPE_SHIFT);
+    position = put_varint(position, cpu);
+    position = put_varint(position, zigzag(cycle - last_cycle));
+
+    last_cycle = cycle;
+}
+
+class MISS_STREAM_READER {
+  public:
+    const char *file_name;
+    gzFile file;
+    MISS_STREAM_HEADER header;
+    uint8_t *buffer, end_of_file;
+    uint64_t position, size, num_requests;
+    uint64_t last_cycle, last_addr, last_ip;
+
+    MISS_STREAM_READER(const char *name) : file_name(name) {
+        file = gzopen(file_name, "rb");
+        if ((file == NULL) || (gzread(file, &header, sizeof(header)) != (int)sizeof(header)) || memcmp(header.magic, MISS_STREAM_MAGIC, sizeof(header.magic))) {
+            cerr << "*** Cannot read miss stream: " << file_name << " ***" << endl;
+            assert(0);
+        }
+
+        buffer = new uint8_t[MISS_STREAM_BUFFER];
+        end_of_file = 0;
+        position = 0;
+        size = 0;
+        num_requests = 0;
+        last_cycle = 0;
+        last_addr = 0;
+        last_ip = 0;
+    };
+
+    ~MISS_STREAM_READER() {
+        gzclose(file);
+        delete[] buffer;
+    };
+
+    // keeps at least one whole record in the buffer
+    void refill() {
+        if (end_of_file || ((size - position) >= MISS_MAX_RECORD_BYTES))
+            return;
+
+        memmove(buffer, buffer + position, size - position);
+        size -= position;
+        position = 0;
+
+        int room = MISS_STREAM_BUFFER - size,
+            bytes = gzread(file, buffer + size, room);
+        if (bytes < 0) {
+            cerr << "*** Cannot read miss stream: " << file_name << " ***" << endl;
+            assert(0);
+        }
+        size += bytes;
+        if (bytes < room)
+            end_of_file = 1;
+    };
+
+    // returns 0 at the end of the stream
+    uint8_t next(MISS_RECORD *record) {
+        refill();
+        if (position == size)
+            return 0;
+
+        record->flags = buffer[position++];
+        record->queue = record->flags & MISS_QUEUE_MASK;
+        record->type = (record->flags >> MISS_TYPE_SHIFT) & MISS_TYPE_MASK;
+        record->cpu = get_varint(buffer, position);
+        record->seq = num_requests;
+        if (record->cpu >= NUM_CPUS) {
+            cerr << "*** Corrupt miss stream: " << file_name << " ***" << endl;
+            assert(0);
+        }
+
+        if (record->queue == MISS_MARKER) {
+            last_cycle += unzigzag(get_varint(buffer, position));
+            record->cycle = last_cycle;
+            return 1;
+        }
+
+        record->fill_level = unzigzag(get_varint(buffer, position));
+        last_cycle += unzigzag(get_varint(buffer, position));
+        last_addr += unzigzag(get_varint(buffer, position));
+        last_ip += unzigzag(get_varint(buffer, position));
+        record->cycle = last_cycle;
+        record->full_addr = last_addr;
+        record->ip = last_ip;
+        if (record->flags & MISS_BLOCK_ADDRESS)
+            record->address = get_varint(buffer, position);
+        else
+            record->address = last_addr >> LOG2_BLOCK_SIZE;
+        num_requests++;
+
+        return 1;
+    };
+};
+
+void MISS_REPLAY_PORT::return_data(PACKET *packet)
+{
+    // misses of different cores to one block are merged below, all of them are done
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        auto wait = replay_port[i].inflight.find(packet->address);
+        if (wait == replay_port[i].inflight.end())
+            continue;
+
+        replay_port[i].returned += wait->second.count;
+        replay_port[i].total_latency += wait->second.count * (current_core_cycle[i] - wait->second.issue_cycle);
+        replay_port[i].outstanding -= wait->second.count;
+        replay_port[i].inflight.erase(wait);
+    }
+}
+
+static MEMORY *replay_target;
+static int replay_fill_level;
+static uint64_t replay_begin_cycle = 0;
+
+// returns 0 if the request has to wait
+static uint8_t replay_request(MISS_RECORD *record, uint64_t now)
+{
+    MISS_REPLAY_PORT *port = &replay_port[record->cpu];
+    uint8_t demand = (record->queue == MISS_RQ) && (record->type != PREFETCH) && (record->fill_level < replay_fill_level);
+
+    if (demand && replay_mlp && (port->outstanding >= replay_mlp)) {
+        port->blocked = 2;
+        return 0;
+    }
+
+    PACKET packet;
+    packet.cpu = record->cpu;
+    packet.type = record->type;
+    packet.instruction = (record->flags & MISS_INSTRUCTION) ? 1 : 0;
+    packet.fill_level = record->fill_level;
+    packet.address = record->address;
+    packet.full_addr = record->full_addr;
+    packet.ip = record->ip;
+    packet.instr_id = record->seq;
+    packet.event_cycle = now;
+
+    // waits before the request goes out, DRAM answers with a dummy response inside add_rq() before the warmup
+    if (demand) {
+        MISS_INFLIGHT &wait = port->inflight[packet.address];
+        if (wait.count == 0)
+            wait.issue_cycle = now;
+        wait.count++;
+        port->outstanding++;
+    }
+
+    int result;
+    if (record->queue == MISS_RQ)
+        result = replay_target->add_rq(&packet);
+    else if (record->queue == MISS_WQ)
+        result = replay_target->add_wq(&packet);
+    else
+        result = replay_target->add_pq(&packet);
+
+    if (result == -2) {
+        if (demand) {
+            auto wait = port->inflight.find(packet.address);
+            wait->second.count--;
+            port->outstanding--;
+            if (wait->second.count == 0)
+                port->inflight.erase(wait);
+        }
+        port->blocked = 1;
+        return 0;
+    }
+
+    if ((record->flags & MISS_WARMUP_COMPLETE) && (warmup_complete[record->cpu] == 0)) {
+        warmup_complete[record->cpu] = 1;
+        all_warmup_complete++;
+    }
+
+    port->blocked = 0;
+    port->issued[record->type]++;
+    return 1;
+}
+
+static void replay_marker(MISS_RECORD *marker, uint64_t now)
+{
+    if (marker->type == MISS_MARK_WARMUP) {
+        for (uint32_t i=0; i<NUM_CPUS; i++)
+            warmup_complete[i] = 1;
+        all_warmup_complete = NUM_CPUS + 1;
+        replay_begin_cycle = now;
+
+        cout << endl << "Warmup complete replay cycles: " << now;
+        print_simulation_time();
+        cout << endl;
+
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            reset_cache_stats(i, &uncore->LLC);
+
+            for (uint32_t j=0; j<NUM_TYPES; j++)
+                replay_port[i].issued[j] = 0;
+            replay_port[i].returned = 0;
+            replay_port[i].total_latency = 0;
+            replay_port[i].full_cycles = 0;
+            replay_port[i].mlp_cycles = 0;
+        }
+
+        for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+            uncore->DRAM.RQ[i].ROW_BUFFER_HIT = 0;
+            uncore->DRAM.RQ[i].ROW_BUFFER_MISS = 0;
+            uncore->DRAM.WQ[i].ROW_BUFFER_HIT = 0;
+            uncore->DRAM.WQ[i].ROW_BUFFER_MISS = 0;
+        }
+
+        uncore->LLC.LATENCY = LLC_LATENCY;
+    }
+    else if (simulation_complete[marker->cpu] == 0) {
+        simulation_complete[marker->cpu] = 1;
+        all_simulation_complete++;
+        replay_port[marker->cpu].roi_cycles = now - replay_begin_cycle;
+        record_roi_stats(marker->cpu, &uncore->LLC);
+
+        cout << "Finished CPU " << marker->cpu << " replay cycles: " << replay_port[marker->cpu].roi_cycles;
+        print_simulation_time();
+    }
+}
+
+void replay_misses(const char *file_name)
+{
+    MISS_STREAM_READER reader(file_name);
+    if (reader.header.num_cpus != NUM_CPUS) {
+        cerr << "*** The miss stream was recorded with " << reader.header.num_cpus << " CPUs ***" << endl;
+        assert(0);
+    }
+
+    // the replay ports take the place of the caches above the recorded level
+    if (reader.header.level == FILL_L2) {
+#ifdef INCLUSIVE_CACHE
+        cerr << "*** An inclusive LLC back-invalidates the private caches, which a miss stream replay does not have ***" << endl;
+        assert(0);
+#endif
+        replay_target = &uncore->LLC;
+        replay_fill_level = uncore->LLC.fill_level;
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            uncore->LLC.upper_level_icache[i] = &replay_port[i];
+            uncore->LLC.upper_level_dcache[i] = &replay_port[i];
+        }
+    }
+    else if (reader.header.level == FILL_LLC) {
+        replay_target = &uncore->DRAM;
+        replay_fill_level = uncore->DRAM.fill_level;
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            uncore->DRAM.upper_level_icache[i] = &replay_port[i];
+            uncore->DRAM.upper_level_dcache[i] = &replay_port[i];
+        }
+    }
+    else {
+        cerr << "*** Corrupt miss stream: " << file_name << " ***" << endl;
+        assert(0);
+    }
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        replay_port[i].cpu = i;
+
+    cout << "Replaying misses below " << ((reader.header.level == FILL_L2) ? "L2C" : "LLC") << endl;
+
+    deque <MISS_RECORD> pending[NUM_CPUS], markers;
+    MISS_RECORD record;
+    uint8_t more = reader.next(&record);
+    uint64_t now = 0, num_issued = 0, skipped = 0, next_heartbeat = STAT_PRINTING_PERIOD;
+
+    while (1) {
+        now++;
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            current_core_cycle[i] = now;
+            replay_port[i].blocked = 0;
+        }
+
+        while (more && (record.cycle <= now)) {
+            if (record.queue == MISS_MARKER)
+                markers.push_back(record);
+            else
+                pending[record.cpu].push_back(record);
+            more = reader.next(&record);
+        }
+
+        // requests of a core go out in order, a marker holds back the requests behind it until everything before it went out
+        uint8_t applied = 1;
+        while (applied) {
+            applied = 0;
+            uint64_t barrier = markers.empty() ? UINT64_MAX : markers.front().seq;
+
+            for (uint32_t i=0; i<NUM_CPUS; i++) {
+                uint64_t slip = replay_mlp ? replay_port[i].slip : 0;
+                while (!pending[i].empty() && (pending[i].front().seq < barrier) && ((pending[i].front().cycle + slip) <= now)) {
+                    if (!replay_request(&pending[i].front(), now))
+                        break;
+                    pending[i].pop_front();
+                    num_issued++;
+                }
+            }
+
+            if (!markers.empty() && (num_issued >= markers.front().seq) && (markers.front().cycle <= now)) {
+                replay_marker(&markers.front(), now);
+                markers.pop_front();
+                applied = 1;
+            }
+        }
+
+        // closed loop, a waiting request pushes back the rest of the stream of its core
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            if (replay_port[i].blocked == 1)
+                replay_port[i].full_cycles++;
+            else if (replay_port[i].blocked == 2)
+                replay_port[i].mlp_cycles++;
+            if (replay_port[i].blocked && replay_mlp)
+                replay_port[i].slip++;
+        }
+
+        if (reader.header.level == FILL_L2)
+            uncore->LLC.operate();
+        uncore->DRAM.operate();
+
+        if (show_heartbeat && (num_issued >= next_heartbeat)) {
+            cout << "Heartbeat replay requests: " << num_issued << " cycles: " << now;
+            print_simulation_time();
+            next_heartbeat += STAT_PRINTING_PERIOD;
+        }
+
+        uint8_t done = !more && markers.empty();
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            if (!pending[i].empty())
+                done = 0;
+        }
+        if (done)
+            break;
+
+        // jump to the next request or uncore event, a core waiting on the uncore is checked every cycle
+        if (knob_skip_idle) {
+            uint64_t next_cycle = more ? record.cycle : UINT64_MAX;
+            if (!markers.empty() && (markers.front().cycle < next_cycle))
+                next_cycle = markers.front().cycle;
+            for (uint32_t i=0; i<NUM_CPUS; i++) {
+                if (replay_port[i].blocked)
+                    next_cycle = now + 1;
+                else if (!pending[i].empty() && ((pending[i].front().cycle + (replay_mlp ? replay_port[i].slip : 0)) < next_cycle))
+                    next_cycle = pending[i].front().cycle + (replay_mlp ? replay_port[i].slip : 0);
+            }
+            if ((reader.header.level == FILL_L2) && (uncore->LLC.next_event_cycle() < next_cycle))
+                next_cycle = uncore->LLC.next_event_cycle();
+            if (uncore->DRAM.next_event_cycle() < next_cycle)
+                next_cycle = uncore->DRAM.next_event_cycle();
+
+            if ((next_cycle != UINT64_MAX) && (next_cycle > (now + 1))) {
+                skipped += next_cycle - now - 1;
+                now = next_cycle - 1;
+            }
+        }
+    }
+
+    // a recording that was cut short has no end of the region of interest
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        if (simulation_complete[i] == 0) {
+            replay_port[i].roi_cycles = now - replay_begin_cycle;
+            record_roi_stats(i, &uncore->LLC);
+        }
+    }
+
+    cout << endl << "ChampSim completed miss stream replay" << endl;
+    cout << "Replayed requests: " << num_issued << " cycles: " << now << " recorded cycles: " << reader.last_cycle;
+    print_simulation_time();
+    if (knob_skip_idle)
+        cout << "Skipped idle cycles: " << skipped << endl;
+
+    cout << endl << "Region of Interest Statistics" << endl;
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        MISS_REPLAY_PORT *port = &replay_port[i];
+        cout << endl << "CPU " << i << " replay cycles: " << port->roi_cycles;
+        cout << " LOAD: " << port->issued[LOAD] << " RFO: " << port->issued[RFO] << " PREFETCH: " << port->issued[PREFETCH] << " WRITEBACK: " << port->issued[WRITEBACK] << endl;
+        cout << "CPU " << i << " demand reads returned: " << port->returned << " average latency: " << (port->returned ? ((double)port->total_latency / port->returned) : 0);
+        cout << " queue full cycles: " << port->full_cycles << " MLP stall cycles: " << port->mlp_cycles << " slip: " << port->slip << endl;
+        if (reader.header.level == FILL_L2)
+            print_roi_stats(i, &uncore->LLC);
+    }
+
+#ifndef CRC2_COMPILE
+    if (reader.header.level == FILL_L2)
+        uncore->LLC.llc_replacement_final_stats();
+    print_dram_stats();
+#endif
+}
@@ -1,5 +1,6 @@
 #include "ooo_cpu.h"
 #include "set.h"
+#include "profiler.h"
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -10,15 +11,104 @@ using namespace std;
 //ofstream fout("trace_essential.txt");
 
 // out-of-order core
-O3_CPU ooo_cpu[NUM_CPUS]; 
+O3_CPU *ooo_cpu; 
 uint64_t current_core_cycle[NUM_CPUS], stall_cycle[NUM_CPUS];
 uint32_t SCHEDULING_LATENCY = 0, EXEC_LATENCY = 0;
 
+// default core configuration
+uint32_t ROB_SIZE = 256, LQ_SIZE = 72, SQ_SIZE = 56,
+         FETCH_WIDTH = 4, DECODE_WIDTH = 4, EXEC_WIDTH = 6, LQ_WIDTH = 2, SQ_WIDTH = 1, RETIRE_WIDTH = 4,
+         SCHEDULER_SIZE = 100;
+
 void O3_CPU::initialize_core()
 {
 
 }
 
+// convert the next batch of trace records into the performance model's instruction format
+// instr_id and STA are left to the consumer, which is the only one that knows the instruction order
+void O3_CPU::decode_batch()
+{
+    decode_head = 0;
+    decode_tail = 0;
+
+    while (decode_tail < DECODE_BATCH_SIZE) {
+        if (!trace.read(knob_cloudsuite ? (void *)&current_cloudsuite_instr : (void *)&current_instr)) {
+            // the batch stops at the end of the trace, next_decoded_instr() reports it once the batch is used up
+            decode_end_of_trace = 1;
+            break;
+        }
+
+        ooo_model_instr *arch_instr = &decode_buffer[decode_tail++];
+        uint8_t *destination_registers, *source_registers;
+        uint64_t *destination_memory, *source_memory;
+
+        *arch_instr = ooo_model_instr();
+        if (knob_cloudsuite) {
+            arch_instr->ip = current_cloudsuite_instr.ip;
+            arch_instr->is_branch = current_cloudsuite_instr.is_branch;
+            arch_instr->branch_taken = current_cloudsuite_instr.branch_taken;
+            arch_instr->asid[0] = current_cloudsuite_instr.asid[0];
+            arch_instr->asid[1] = current_cloudsuite_instr.asid[1];
+
+            destination_registers = current_cloudsuite_instr.destination_registers;
+            destination_memory = current_cloudsuite_instr.destination_memory;
+            source_registers = current_cloudsuite_instr.source_registers;
+            source_memory = current_cloudsuite_instr.source_memory;
+        }
+        else {
+            arch_instr->ip = current_instr.ip;
+            arch_instr->is_branch = current_instr.is_branch;
+            arch_instr->branch_taken = current_instr.branch_taken;
+            arch_instr->asid[0] = cpu;
+            arch_instr->asid[1] = cpu;
+
+            destination_registers = current_instr.destination_registers;
+            destination_memory = current_instr.destination_memory;
+            source_registers = current_instr.source_registers;
+            source_memory = current_instr.source_memory;
+        }
+
+        int num_reg_ops = 0, num_mem_ops = 0;
+        for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+            arch_instr->destination_registers[i] = destination_registers[i];
+            arch_instr->destination_memory[i] = destination_memory[i];
+            arch_instr->destination_virtual_address[i] = destination_memory[i];
+
+            num_reg_ops += (destination_registers[i] != 0);
+            num_mem_ops += (destination_memory[i] != 0);
+        }
+
+        for (int i=0; i<NUM_INSTR_SOURCES; i++) {
+            arch_instr->source_registers[i] = source_registers[i];
+            arch_instr->source_memory[i] = source_memory[i];
+            arch_instr->source_virtual_address[i] = source_memory[i];
+
+            num_reg_ops += (source_registers[i] != 0);
+            num_mem_ops += (source_memory[i] != 0);
+        }
+
+        arch_instr->num_reg_ops = num_reg_ops;
+        arch_instr->num_mem_ops = num_mem_ops;
+        if (num_mem_ops > 0)
+            arch_instr->is_memory = 1;
+    }
+}
+
+ooo_model_instr *O3_CPU::next_decoded_instr()
+{
+    while (decode_head == decode_tail) {
+        if (decode_end_of_trace) {
+            // reached end of file for this trace, the next batch starts over
+            cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl; 
+            decode_end_of_trace = 0;
+        }
+        decode_batch();
+    }
+
+    return &decode_buffer[decode_head++];
+}
+
 void O3_CPU::handle_branch()
 {
     // actual processors do not work like this but for easier implementation,
@@ -29,293 +119,194 @@ void O3_CPU::handle_branch()
     uint32_t num_reads = 0;
     instrs_to_read_this_cycle = FETCH_WIDTH;
 
-    // first, read PIN trace
+    // first, take the next instructions decoded from the PIN trace
     while (continue_reading) {
+        ooo_model_instr *arch_instr = next_decoded_instr();
+        arch_instr->instr_id = instr_unique_id;
 
-        size_t instr_size = knob_cloudsuite ? sizeof(cloudsuite_instr) : sizeof(input_instr);
-
-        if (knob_cloudsuite) {
-            if (!fread(&current_cloudsuite_instr, instr_size, 1, trace_file)) {
-                // reached end of file for this trace
-                cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl; 
-
-                // close the trace file and re-open it
-                pclose(trace_file);
-                trace_file = popen(gunzip_command, "r");
-                if (trace_file == NULL) {
-                    cerr << endl << "*** CANNOT REOPEN TRACE FILE: " << trace_string << " ***" << endl;
-                    assert(0);
+        // update STA, this structure is required to execute store instructios properly without deadlock
+        for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+            if (arch_instr->destination_memory[i]) {
+#ifdef SANITY_CHECK
+                if (STA[STA_tail] < UINT64_MAX) {
+                    if (STA_head != STA_tail)
+                        assert(0);
                 }
-            } else { // successfully read the trace
+#endif
+                STA[STA_tail] = instr_unique_id;
+                STA_tail++;
 
-                // copy the instruction into the performance model's instruction format
-                ooo_model_instr arch_instr;
-                int num_reg_ops = 0, num_mem_ops = 0;
+                if (STA_tail == STA_SIZE)
+                    STA_tail = 0;
+            }
+        }
 
-                arch_instr.instr_id = instr_unique_id;
-                arch_instr.ip = current_cloudsuite_instr.ip;
-                arch_instr.is_branch = current_cloudsuite_instr.is_branch;
-                arch_instr.branch_taken = current_cloudsuite_instr.branch_taken;
+        // virtually add this instruction to the ROB
+        if (ROB.occupancy < ROB.SIZE) {
+            uint32_t rob_index = add_to_rob(arch_instr);
+            num_reads++;
 
-                arch_instr.asid[0] = current_cloudsuite_instr.asid[0];
-                arch_instr.asid[1] = current_cloudsuite_instr.asid[1];
+            // branch prediction
+            if (arch_instr->is_branch) {
 
-                for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
-                    arch_instr.destination_registers[i] = current_cloudsuite_instr.destination_registers[i];
-                    arch_instr.destination_memory[i] = current_cloudsuite_instr.destination_memory[i];
-                    arch_instr.destination_virtual_address[i] = current_cloudsuite_instr.destination_memory[i];
+                DP( if (warmup_complete[cpu]) {
+                cout << "[BRANCH] instr_id: " << instr_unique_id << " ip: " << hex << arch_instr->ip << dec << " taken: " << +arch_instr->branch_taken << endl; });
 
-                    if (arch_instr.destination_registers[i])
-                        num_reg_ops++;
-                    if (arch_instr.destination_memory[i]) {
-                        num_mem_ops++;
+                num_branch++;
 
-                        // update STA, this structure is required to execute store instructios properly without deadlock
-                        if (num_mem_ops > 0) {
-#ifdef SANITY_CHECK
-                            if (STA[STA_tail] < UINT64_MAX) {
-                                if (STA_head != STA_tail)
-                                    assert(0);
-                            }
-#endif
-                            STA[STA_tail] = instr_unique_id;
-                            STA_tail++;
-
-                            if (STA_tail == STA_SIZE)
-                                STA_tail = 0;
-                        }
-                    }
-                }
+                /*
+                uint8_t branch_prediction;
+                // for faster simulation, force perfect prediction during the warmup
+                // note that branch predictor is still learning with real branch results
+                if (all_warmup_complete == 0)
+                    branch_prediction = arch_instr->branch_taken; 
+                else
+                    branch_prediction = predict_branch(arch_instr->ip);
+                */
+                profile_enter(PROFILE_BRANCH_PREDICTOR);
+                uint8_t branch_prediction = predict_branch(arch_instr->ip);
+                profile_exit();
+                
+                if (arch_instr->branch_taken != branch_prediction) {
+                    branch_mispredictions++;
 
-                for (int i=0; i<NUM_INSTR_SOURCES; i++) {
-                    arch_instr.source_registers[i] = current_cloudsuite_instr.source_registers[i];
-                    arch_instr.source_memory[i] = current_cloudsuite_instr.source_memory[i];
-                    arch_instr.source_virtual_address[i] = current_cloudsuite_instr.source_memory[i];
+                    DP( if (warmup_complete[cpu]) {
+                    cout << "[BRANCH] MISPREDICTED instr_id: " << instr_unique_id << " ip: " << hex << arch_instr->ip << dec;
+                    cout << " taken: " << +arch_instr->branch_taken << " predicted: " << +branch_prediction << endl; });
 
-                    if (arch_instr.source_registers[i])
-                        num_reg_ops++;
-                    if (arch_instr.source_memory[i])
-                        num_mem_ops++;
-                }
+                    // halt any further fetch this cycle
+                    instrs_to_read_this_cycle = 0;
 
-                arch_instr.num_reg_ops = num_reg_ops;
-                arch_instr.num_mem_ops = num_mem_ops;
-                if (num_mem_ops > 0) 
-                    arch_instr.is_memory = 1;
-
-                // virtually add this instruction to the ROB
-                if (ROB.occupancy < ROB.SIZE) {
-                    uint32_t rob_index = add_to_rob(&arch_instr);
-                    num_reads++;
-
-                    // branch prediction
-                    if (arch_instr.is_branch) {
-
-                        DP( if (warmup_complete[cpu]) {
-                        cout << "[BRANCH] instr_id: " << instr_unique_id << " ip: " << hex << arch_instr.ip << dec << " taken: " << +arch_instr.branch_taken << endl; });
-
-                        num_branch++;
-
-                        /*
-                        uint8_t branch_prediction;
-                        // for faster simulation, force perfect prediction during the warmup
-                        // note that branch predictor is still learning with real branch results
-                        if (all_warmup_complete == 0)
-                            branch_prediction = arch_instr.branch_taken; 
-                        else
-                            branch_prediction = predict_branch(arch_instr.ip);
-                        */
-                        uint8_t branch_prediction = predict_branch(arch_instr.ip);
-                        
-                        if (arch_instr.branch_taken != branch_prediction) {
-                            branch_mispredictions++;
-
-                            DP( if (warmup_complete[cpu]) {
-                            cout << "[BRANCH] MISPREDICTED instr_id: " << instr_unique_id << " ip: " << hex << arch_instr.ip << dec;
-                            cout << " taken: " << +arch_instr.branch_taken << " predicted: " << +branch_prediction << endl; });
-
-                            // halt any further fetch this cycle
-                            instrs_to_read_this_cycle = 0;
-
-                            // and stall any additional fetches until the branch is executed
-                            fetch_stall = 1; 
-
-                            ROB.entry[rob_index].branch_mispredicted = 1;
-                        }
-                        else {
-                            if (branch_prediction == 1) {
-                                // if we are accurately predicting a branch to be taken, then we can't possibly fetch down that path this cycle,
-                                // so we have to wait until the next cycle to fetch those
-                                instrs_to_read_this_cycle = 0;
-                            }
-
-                            DP( if (warmup_complete[cpu]) {
-                            cout << "[BRANCH] PREDICTED    instr_id: " << instr_unique_id << " ip: " << hex << arch_instr.ip << dec;
-                            cout << " taken: " << +arch_instr.branch_taken << " predicted: " << +branch_prediction << endl; });
-                        }
+                    // and stall any additional fetches until the branch is executed
+                    fetch_stall = 1; 
 
-                        last_branch_result(arch_instr.ip, arch_instr.branch_taken);
+                    ROB.entry[rob_index].branch_mispredicted = 1;
+                }
+                else {
+                    if (branch_prediction == 1) {
+                        // if we are accurately predicting a branch to be taken, then we can't possibly fetch down that path this cycle,
+                        // so we have to wait until the next cycle to fetch those
+                        instrs_to_read_this_cycle = 0;
                     }
 
-                    //if ((num_reads == FETCH_WIDTH) || (ROB.occupancy == ROB.SIZE))
-                    if ((num_reads >= instrs_to_read_this_cycle) || (ROB.occupancy == ROB.SIZE))
-                        continue_reading = 0;
+                    DP( if (warmup_complete[cpu]) {
+                    cout << "[BRANCH] PREDICTED    instr_id: " << instr_unique_id << " ip: " << hex << arch_instr->ip << dec;
+                    cout << " taken: " << +arch_instr->branch_taken << " predicted: " << +branch_prediction << endl; });
                 }
-                instr_unique_id++;
-            }
-        } else {
-            if (!fread(&current_instr, instr_size, 1, trace_file)) {
-                // reached end of file for this trace
-				//fout.close();
-                cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl; 
-
-                // close the trace file and re-open it
-                pclose(trace_file);
-                trace_file = popen(gunzip_command, "r");
-                if (trace_file == NULL) {
-                    cerr << endl << "*** CANNOT REOPEN TRACE FILE: " << trace_string << " ***" << endl;
-                    assert(0);
-                }
-            } else { // successfully read the trace
-			   	/* 
-				 if (current_instr.destination_memory[0]) {		//store instr			
-					fout << "ip: " << to_string(current_instr.ip);
-					for( int i = 0; i < NUM_INSTR_DESTINATIONS && current_instr.destination_memory[i]; i++ ) {
-						fout << " dest_mem[" << i << "]: " << to_string(current_instr.destination_memory[i]);
-					}		
-					fout << endl;
-				}
-			    
-                if(current_instr.source_memory[0]) {		//load instr
-					fout << "ip: " << to_string(current_instr.ip);
-					for( int i = 0; i < NUM_INSTR_SOURCES && current_instr.source_memory[i]; i++ ) {
-						fout << " src_mem[" << i << "]: " << to_string(current_instr.source_memory[i]);
-					}
-					fout << endl;
-				}	
-				*/
-
-				
-					
-                // copy the instruction into the performance model's instruction format
-                ooo_model_instr arch_instr;
-                int num_reg_ops = 0, num_mem_ops = 0;
-
-                arch_instr.instr_id = instr_unique_id;
-                arch_instr.ip = current_instr.ip;
-                arch_instr.is_branch = current_instr.is_branch;
-                arch_instr.branch_taken = current_instr.branch_taken;
-
-                arch_instr.asid[0] = cpu;
-                arch_instr.asid[1] = cpu;
 
-                for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
-                    arch_instr.destination_registers[i] = current_instr.destination_registers[i];
-                    arch_instr.destination_memory[i] = current_instr.destination_memory[i];
-                    arch_instr.destination_virtual_address[i] = current_instr.destination_memory[i];
+                profile_enter(PROFILE_BRANCH_PREDICTOR);
+                last_branch_result(arch_instr->ip, arch_instr->branch_taken);
+                profile_exit();
+            }
 
-                    if (arch_instr.destination_registers[i])
-                        num_reg_ops++;
-                    if (arch_instr.destination_memory[i]) {
-                        num_mem_ops++;
+            //if ((num_reads == FETCH_WIDTH) || (ROB.occupancy == ROB.SIZE))
+            if ((num_reads >= instrs_to_read_this_cycle) || (ROB.occupancy == ROB.SIZE))
+                continue_reading = 0;
+        }
+        instr_unique_id++;
+    }
 
-                        // update STA, this structure is required to execute store instructios properly without deadlock
-                        if (num_mem_ops > 0) {
-#ifdef SANITY_CHECK
-                            if (STA[STA_tail] < UINT64_MAX) {
-                                if (STA_head != STA_tail)
-                                    assert(0);
-                            }
-#endif
-                            STA[STA_tail] = instr_unique_id;
-                            STA_tail++;
+    //instrs_to_fetch_this_cycle = num_reads;
+}
 
-                            if (STA_tail == STA_SIZE)
-                                STA_tail = 0;
-                        }
-                    }
-                }
+// functional warmup: read one instruction and run it through the branch predictor, TLBs and caches
+// with zero latency, the ROB and LSQ are bypassed and the instruction is retired right away
+void O3_CPU::functional_instruction()
+{
+    ooo_model_instr *arch_instr = next_decoded_instr();
+    arch_instr->instr_id = instr_unique_id;
+
+    // instruction fetch, consecutive instructions in the same block are merged as in the ITLB/L1I RQ
+    if ((arch_instr->ip >> LOG2_BLOCK_SIZE) != functional_fetch_block) {
+        uint64_t instruction_pa = functional_translate(&ITLB, arch_instr, arch_instr->ip, LOAD);
+        functional_fetch(&L1I, arch_instr, instruction_pa, LOAD);
+        functional_fetch_block = arch_instr->ip >> LOG2_BLOCK_SIZE;
+    }
 
-                for (int i=0; i<NUM_INSTR_SOURCES; i++) {
-                    arch_instr.source_registers[i] = current_instr.source_registers[i];
-                    arch_instr.source_memory[i] = current_instr.source_memory[i];
-                    arch_instr.source_virtual_address[i] = current_instr.source_memory[i];
+    // branch prediction, trains the predictor but is not counted in the ROI statistics
+    if (arch_instr->is_branch) {
+        predict_branch(arch_instr->ip);
+        last_branch_result(arch_instr->ip, arch_instr->branch_taken);
+    }
 
-                    if (arch_instr.source_registers[i])
-                        num_reg_ops++;
-                    if (arch_instr.source_memory[i])
-                        num_mem_ops++;
-                }
+    // loads
+    for (int i=0; i<NUM_INSTR_SOURCES; i++) {
+        if (arch_instr->source_memory[i]) {
+            uint64_t physical_address = functional_translate(&DTLB, arch_instr, arch_instr->source_memory[i], LOAD);
+            functional_fetch(&L1D, arch_instr, physical_address, LOAD);
+        }
+    }
 
-                arch_instr.num_reg_ops = num_reg_ops;
-                arch_instr.num_mem_ops = num_mem_ops;
-                if (num_mem_ops > 0) 
-                    arch_instr.is_memory = 1;
-
-                // virtually add this instruction to the ROB
-                if (ROB.occupancy < ROB.SIZE) {
-                    uint32_t rob_index = add_to_rob(&arch_instr);
-                    num_reads++;
-
-                    // branch prediction
-                    if (arch_instr.is_branch) {
-
-                        DP( if (warmup_complete[cpu]) {
-                        cout << "[BRANCH] instr_id: " << instr_unique_id << " ip: " << hex << arch_instr.ip << dec << " taken: " << +arch_instr.branch_taken << endl; });
-
-                        num_branch++;
-
-                        /*
-                        uint8_t branch_prediction;
-                        // for faster simulation, force perfect prediction during the warmup
-                        // note that branch predictor is still learning with real branch results
-                        if (all_warmup_complete == 0)
-                            branch_prediction = arch_instr.branch_taken; 
-                        else
-                            branch_prediction = predict_branch(arch_instr.ip);
-                        */
-                        uint8_t branch_prediction = predict_branch(arch_instr.ip);
-                        
-                        if (arch_instr.branch_taken != branch_prediction) {
-                            branch_mispredictions++;
-
-                            DP( if (warmup_complete[cpu]) {
-                            cout << "[BRANCH] MISPREDICTED instr_id: " << instr_unique_id << " ip: " << hex << arch_instr.ip << dec;
-                            cout << " taken: " << +arch_instr.branch_taken << " predicted: " << +branch_prediction << endl; });
-
-                            // halt any further fetch this cycle
-                            instrs_to_read_this_cycle = 0;
-
-                            // and stall any additional fetches until the branch is executed
-                            fetch_stall = 1; 
-
-                            ROB.entry[rob_index].branch_mispredicted = 1;
-                        }
-                        else {
-                            if (branch_prediction == 1) {
-                                // if we are accurately predicting a branch to be taken, then we can't possibly fetch down that path this cycle,
-                                // so we have to wait until the next cycle to fetch those
-                                instrs_to_read_this_cycle = 0;
-                            }
-
-                            DP( if (warmup_complete[cpu]) {
-                            cout << "[BRANCH] PREDICTED    instr_id: " << instr_unique_id << " ip: " << hex << arch_instr.ip << dec;
-                            cout << " taken: " << +arch_instr.branch_taken << " predicted: " << +branch_prediction << endl; });
-                        }
+    // stores
+    for (uint32_t i=0; i<MAX_INSTR_DESTINATIONS; i++) {
+        if (arch_instr->destination_memory[i]) {
+            uint64_t physical_address = functional_translate(&DTLB, arch_instr, arch_instr->destination_memory[i], RFO);
+            functional_fetch(&L1D, arch_instr, physical_address, RFO);
+        }
+    }
 
-                        last_branch_result(arch_instr.ip, arch_instr.branch_taken);
-                    }
+    instr_unique_id++;
+    num_retired++;
+}
 
-                    //if ((num_reads == FETCH_WIDTH) || (ROB.occupancy == ROB.SIZE))
-                    if ((num_reads >= instrs_to_read_this_cycle) || (ROB.occupancy == ROB.SIZE))
-                        continue_reading = 0;
-                }
-                instr_unique_id++;
-            }
-        }
+uint64_t O3_CPU::functional_translate(CACHE *tlb, ooo_model_instr *arch_instr, uint64_t va, uint8_t type)
+{
+    PACKET tlb_packet;
+    tlb_packet.instruction = (tlb == &ITLB);
+    tlb_packet.tlb_access = 1;
+    tlb_packet.fill_level = FILL_L1;
+    tlb_packet.cpu = cpu;
+    if (knob_cloudsuite) {
+        if (tlb_packet.instruction)
+            tlb_packet.address = ((va >> LOG2_PAGE_SIZE) << 9) | (256 + arch_instr->asid[0]);
+        else
+            tlb_packet.address = ((va >> LOG2_PAGE_SIZE) << 9) | arch_instr->asid[1];
     }
+    else
+        tlb_packet.address = va >> LOG2_PAGE_SIZE;
+    tlb_packet.full_addr = va;
+    tlb_packet.instr_id = arch_instr->instr_id;
+    tlb_packet.ip = arch_instr->ip;
+    tlb_packet.type = type;
+    tlb_packet.asid[0] = arch_instr->asid[0];
+    tlb_packet.asid[1] = arch_instr->asid[1];
 
-    //instrs_to_fetch_this_cycle = num_reads;
+    uint64_t ppage = tlb->functional_access(&tlb_packet);
+
+    return (ppage << LOG2_PAGE_SIZE) | (va & ((1 << LOG2_PAGE_SIZE) - 1)); // translated address
+}
+
+uint64_t O3_CPU::functional_fetch(CACHE *cache, ooo_model_instr *arch_instr, uint64_t pa, uint8_t type)
+{
+    PACKET fetch_packet;
+    fetch_packet.instruction = (cache == &L1I);
+    fetch_packet.fill_level = FILL_L1;
+    fetch_packet.cpu = cpu;
+    fetch_packet.address = pa >> LOG2_BLOCK_SIZE;
+    if (fetch_packet.instruction)
+        fetch_packet.instruction_pa = pa;
+    fetch_packet.full_addr = pa;
+    fetch_packet.instr_id = arch_instr->instr_id;
+    fetch_packet.ip = arch_instr->ip;
+    fetch_packet.type = type;
+    fetch_packet.asid[0] = arch_instr->asid[0];
+    fetch_packet.asid[1] = arch_instr->asid[1];
+
+    return cache->functional_access(&fetch_packet);
+}
+
+// drop instructions the same way handle_branch takes them, including wrap-around
+// compact traces seek past whatever is not decoded yet
+void O3_CPU::skip_trace(uint64_t num_instr)
+{
+    for (; (num_instr > 0) && (decode_head < decode_tail); num_instr--)
+        decode_head++;
+
+    if (trace.skip(num_instr))
+        return;
+
+    for (uint64_t i=0; i<num_instr; i++)
+        next_decoded_instr();
 }
 
 uint32_t O3_CPU::add_to_rob(ooo_model_instr *arch_instr)
@@ -700,6 +691,8 @@ void O3_CPU::execute_instruction()
                     RTE0_head = 0;
                 exec_issued++;
             }
+            else
+                break; // nothing changes until the head is ready
         }
         else {
             //DP (if (warmup_complete[cpu]) {
@@ -725,6 +718,8 @@ void O3_CPU::execute_instruction()
                     RTE1_head = 0;
                 exec_issued++;
             }
+            else
+                break; // nothing changes until the head is ready
         }
         else {
             //DP (if (warmup_complete[cpu]) {
@@ -807,7 +802,9 @@ void O3_CPU::schedule_memory_instruction()
 
 void O3_CPU::execute_memory_instruction()
 {
+    profile_enter(PROFILE_LSQ);
     operate_lsq();
+    profile_exit();
     operate_cache();
 }
 
@@ -1168,6 +1165,8 @@ void O3_CPU::operate_lsq()
 
                 store_issued++;
             }
+            else
+                break; // nothing changes until the head is ready
         }
         else {
             //DP (if (warmup_complete[cpu]) {
@@ -1194,6 +1193,8 @@ void O3_CPU::operate_lsq()
 
                 store_issued++;
             }
+            else
+                break; // nothing changes until the head is ready
         }
         else {
             //DP (if (warmup_complete[cpu]) {
@@ -1250,6 +1251,8 @@ void O3_CPU::operate_lsq()
 
                 load_issued++;
             }
+            else
+                break; // nothing changes until the head is ready
         }
         else {
             //DP (if (warmup_complete[cpu]) {
@@ -1278,6 +1281,8 @@ void O3_CPU::operate_lsq()
                     load_issued++;
                 }
             }
+            else
+                break; // nothing changes until the head is ready
         }
         else {
             //DP (if (warmup_complete[cpu]) {
@@ -1939,3 +1944,141 @@ void O3_CPU::retire_rob()
         num_retired++;
     }
 }
+
+uint64_t O3_CPU::next_event_cycle()
+{
+    // earliest cycle at which any stage of this core (including its TLBs and private caches) can do work
+    // the checks below mirror the conditions used by each stage and the cheap ones go first
+    // so that a busy core returns as soon as possible
+    uint64_t busy_cycle = current_core_cycle[cpu] + 1, next_cycle = UINT64_MAX, cache_cycle;
+
+    // handle_branch
+    if ((ROB.occupancy < ROB.SIZE) && (fetch_stall == 0))
+        return 0;
+
+    // fetch_instruction
+    uint32_t read_index = (ROB.last_read == (ROB.SIZE-1)) ? 0 : (ROB.last_read + 1);
+    if (ROB.entry[read_index].ip && ((ROB.entry[read_index].translated == 0) || (read_index != ROB.head)))
+        return 0;
+
+    uint32_t fetch_index = (ROB.last_fetch == (ROB.SIZE-1)) ? 0 : (ROB.last_fetch + 1);
+    if ((ROB.entry[fetch_index].translated == COMPLETED) && ((ROB.entry[fetch_index].fetched == 0) || (fetch_index != ROB.head)))
+        if (ROB.entry[fetch_index].event_cycle < next_cycle)
+            next_cycle = ROB.entry[fetch_index].event_cycle;
+
+    if (ROB.occupancy) {
+        // execute_instruction
+        if ((RTE0[RTE0_head] < ROB_SIZE) && (ROB.entry[RTE0[RTE0_head]].event_cycle < next_cycle))
+            next_cycle = ROB.entry[RTE0[RTE0_head]].event_cycle;
+        if ((RTE1[RTE1_head] < ROB_SIZE) && (ROB.entry[RTE1[RTE1_head]].event_cycle < next_cycle))
+            next_cycle = ROB.entry[RTE1[RTE1_head]].event_cycle;
+
+        // retire_rob
+        if ((ROB.entry[ROB.head].executed == COMPLETED) && (ROB.entry[ROB.head].event_cycle < next_cycle))
+            next_cycle = ROB.entry[ROB.head].event_cycle;
+    }
+
+    // operate_lsq
+    if ((RTS0[RTS0_head] < SQ_SIZE) && (SQ.entry[RTS0[RTS0_head]].event_cycle < next_cycle))
+        next_cycle = SQ.entry[RTS0[RTS0_head]].event_cycle;
+    if ((RTS1[RTS1_head] < SQ_SIZE) && (SQ.entry[RTS1[RTS1_head]].event_cycle < next_cycle))
+        next_cycle = SQ.entry[RTS1[RTS1_head]].event_cycle;
+    if ((RTL0[RTL0_head] < LQ_SIZE) && (LQ.entry[RTL0[RTL0_head]].event_cycle < next_cycle))
+        next_cycle = LQ.entry[RTL0[RTL0_head]].event_cycle;
+    if ((RTL1[RTL1_head] < LQ_SIZE) && (LQ.entry[RTL1[RTL1_head]].event_cycle < next_cycle))
+        next_cycle = LQ.entry[RTL1[RTL1_head]].event_cycle;
+
+    // update_rob
+    PACKET_QUEUE *processed[4] = {&ITLB.PROCESSED, &L1I.PROCESSED, &DTLB.PROCESSED, &L1D.PROCESSED};
+    for (uint32_t i=0; i<4; i++) {
+        if (processed[i]->occupancy && (processed[i]->entry[processed[i]->head].event_cycle < next_cycle))
+            next_cycle = processed[i]->entry[processed[i]->head].event_cycle;
+    }
+
+    if (next_cycle <= busy_cycle)
+        return next_cycle;
+
+    // operate_cache
+    CACHE *cache[6] = {&ITLB, &DTLB, &STLB, &L1I, &L1D, &L2C};
+    for (uint32_t i=0; i<6; i++) {
+        cache_cycle = cache[i]->next_event_cycle();
+        if (cache_cycle < next_cycle)
+            next_cycle = cache_cycle;
+    }
+
+    if ((next_cycle <= busy_cycle) || (ROB.occupancy == 0))
+        return next_cycle;
+
+    // schedule_instruction
+    uint32_t schedule_index = ROB.next_schedule;
+    if (ROB.entry[schedule_index].scheduled == 0) {
+        uint64_t ready_cycle = ROB.entry[schedule_index].event_cycle;
+        uint32_t limit = ROB.next_fetch[1],
+                 num_entries = (ROB.head < limit) ? (limit - ROB.head) : (ROB.SIZE - ROB.head + limit);
+        for (uint32_t n=0; (n<num_entries) && (n<SCHEDULER_SIZE) && (ready_cycle<next_cycle); n++) {
+            uint32_t i = (ROB.head + n) % ROB.SIZE;
+            if (ROB.entry[i].fetched != COMPLETED)
+                break;
+            if (ROB.entry[i].event_cycle > ready_cycle)
+                ready_cycle = ROB.entry[i].event_cycle;
+            if (ROB.entry[i].scheduled == 0) {
+                if (ready_cycle < next_cycle)
+                    next_cycle = ready_cycle;
+                break;
+            }
+        }
+    }
+
+    // schedule_memory_instruction, only entries that can get an LSQ slot make progress
+    uint64_t ready_cycle = 0;
+    uint32_t limit = ROB.next_schedule,
+             num_entries = (ROB.head < limit) ? (limit - ROB.head) : (ROB.SIZE - ROB.head + limit);
+    for (uint32_t n=0; (n<num_entries) && (ready_cycle<next_cycle); n++) {
+        uint32_t i = (ROB.head + n) % ROB.SIZE;
+        if (ROB.entry[i].is_memory == 0)
+            continue;
+        if (ROB.entry[i].fetched != COMPLETED)
+            break;
+        if (ROB.entry[i].event_cycle > ready_cycle)
+            ready_cycle = ROB.entry[i].event_cycle;
+        if ((ROB.entry[i].reg_ready == 0) || (ROB.entry[i].scheduled != INFLIGHT))
+            continue;
+
+        uint32_t num_mem_ops = 0, num_added = 0, can_add = 0;
+        for (uint32_t j=0; j<NUM_INSTR_SOURCES; j++) {
+            if (ROB.entry[i].source_memory[j]) {
+                num_mem_ops++;
+                if (ROB.entry[i].source_added[j])
+                    num_added++;
+                else if (LQ.occupancy < LQ.SIZE)
+                    can_add = 1;
+            }
+        }
+        for (uint32_t j=0; j<MAX_INSTR_DESTINATIONS; j++) {
+            if (ROB.entry[i].destination_memory[j]) {
+                num_mem_ops++;
+                if (ROB.entry[i].destination_added[j])
+                    num_added++;
+                else if ((SQ.occupancy < SQ.SIZE) && (STA[STA_head] == ROB.entry[i].instr_id))
+                    can_add = 1;
+            }
+        }
+
+        if (can_add || (num_added == num_mem_ops)) {
+            if (ready_cycle < next_cycle)
+                next_cycle = ready_cycle;
+            break;
+        }
+    }
+
+    // update_rob
+    if ((inflight_reg_executions > 0) || (inflight_mem_executions > 0)) {
+        for (uint32_t i=0; (i<ROB.SIZE) && (next_cycle>busy_cycle); i++) {
+            if ((ROB.entry[i].executed == INFLIGHT) && ((ROB.entry[i].is_memory == 0) || (ROB.entry[i].num_mem_ops == 0)))
+                if (ROB.entry[i].event_cycle < next_cycle)
+                    next_cycle = ROB.entry[i].event_cycle;
+        }
+    }
+
+    return next_cycle;
+}
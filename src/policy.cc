@@ -0,0 +1,169 @@
+#include "policy.h"
+
+#ifdef POLICY_PLUGINS
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
+
+POLICY_KIND policy_kinds[NUM_POLICY_KINDS] = {
+    {"-branch_predictor", "BRANCH_PREDICTOR", "bpred", "champsim_branch_predictor", "bimodal"},
+    {"-l1d_prefetcher", "L1D_PREFETCHER", "l1d_pref", "champsim_l1d_prefetcher", "no"},
+    {"-l2c_prefetcher", "L2C_PREFETCHER", "l2c_pref", "champsim_l2c_prefetcher", "no"},
+    {"-llc_replacement", "LLC_REPLACEMENT", "llc_repl", "champsim_llc_replacement", "lru"}
+};
+
+POLICY_TABLE policies;
+
+int policy_parameter(const char *parameter)
+{
+    for (int kind=0; kind<NUM_POLICY_KINDS; kind++) {
+        if (strcmp(policy_kinds[kind].parameter, parameter) == 0)
+            return kind;
+    }
+
+    return -1;
+}
+
+void select_policy(uint32_t kind, const char *name)
+{
+#ifndef POLICY_PLUGINS
+    cerr << "*** " << policy_kinds[kind].option << " needs a build with plugins=1, this binary has its policies compiled in ***" << endl;
+    assert(0);
+#endif
+
+    if (strlen(name) >= sizeof(policy_kinds[kind].name)) {
+        cerr << "*** Policy name too long: " << name << " ***" << endl;
+        assert(0);
+    }
+    strcpy(policy_kinds[kind].name, name);
+}
+
+#ifdef POLICY_PLUGINS
+// plugins live in policies/ next to the binary, a name with a '/' is taken as the path of the plugin itself
+static string policy_path(POLICY_KIND *kind)
+{
+    if (strchr(kind->name, '/'))
+        return kind->name;
+
+    char binary[4096];
+    ssize_t length = readlink("/proc/self/exe", binary, sizeof(binary) - 1);
+    if (length < 0) {
+        cerr << "*** Cannot find the simulator binary to load policies from ***" << endl;
+        assert(0);
+    }
+    binary[length] = '\0';
+
+    string directory(binary);
+    directory.erase(directory.rfind('/'));
+    return directory + "/policies/" + kind->name + "." + kind->suffix + ".so";
+}
+
+void load_policies()
+{
+    for (uint32_t i=0; i<NUM_POLICY_KINDS; i++) {
+        POLICY_KIND *kind = &policy_kinds[i];
+        string path = policy_path(kind);
+
+        // RTLD_LOCAL keeps the globals of one policy away from the others
+        void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == NULL) {
+            cerr << "*** Cannot load " << kind->option << " " << kind->name << ": " << dlerror() << " ***" << endl;
+            assert(0);
+        }
+
+        policy_entry entry = (policy_entry) dlsym(handle, kind->entry);
+        if (entry == NULL) {
+            cerr << "*** " << path << " is not a " << kind->parameter << " plugin ***" << endl;
+            assert(0);
+        }
+        entry(&policies);
+
+        cout << "Policy " << kind->parameter << ": " << kind->name << endl;
+    }
+}
+
+// the hooks called by the simulator, forwarded to the loaded policies
+void O3_CPU::initialize_branch_predictor()
+{
+    (this->*policies.branch_predictor.initialize)();
+}
+
+uint8_t O3_CPU::predict_branch(uint64_t ip)
+{
+    return (this->*policies.branch_predictor.predict)(ip);
+}
+
+void O3_CPU::last_branch_result(uint64_t ip, uint8_t taken)
+{
+    (this->*policies.branch_predictor.last_result)(ip, taken);
+}
+
+void CACHE::l1d_prefetcher_initialize()
+{
+    (this->*policies.l1d_prefetcher.initialize)();
+}
+
+void CACHE::l1d_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type)
+{
+    (this->*policies.l1d_prefetcher.operate)(addr, ip, cache_hit, type);
+}
+
+void CACHE::l1d_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr)
+{
+    (this->*policies.l1d_prefetcher.cache_fill)(addr, set, way, prefetch, evicted_addr);
+}
+
+void CACHE::l1d_prefetcher_final_stats()
+{
+    (this->*policies.l1d_prefetcher.final_stats)();
+}
+
+void CACHE::l2c_prefetcher_initialize()
+{
+    (this->*policies.l2c_prefetcher.initialize)();
+}
+
+void CACHE::l2c_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type)
+{
+    (this->*policies.l2c_prefetcher.operate)(addr, ip, cache_hit, type);
+}
+
+void CACHE::l2c_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr)
+{
+    (this->*policies.l2c_prefetcher.cache_fill)(addr, set, way, prefetch, evicted_addr);
+}
+
+void CACHE::l2c_prefetcher_final_stats()
+{
+    (this->*policies.l2c_prefetcher.final_stats)();
+}
+
+void CACHE::l2c_prefetcher_reset_stats()
+{
+    (this->*policies.l2c_prefetcher.reset_stats)();
+}
+
+void CACHE::llc_initialize_replacement()
+{
+    (this->*policies.llc_replacement.initialize)();
+}
+
+uint32_t CACHE::llc_find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+{
+    return (this->*policies.llc_replacement.find_victim)(cpu, instr_id, set, current_set, ip, full_addr, type);
+}
+
+void CACHE::llc_update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)
+{
+    (this->*policies.llc_replacement.update_state)(cpu, set, way, full_addr, ip, victim_addr, type, hit);
+}
+
+void CACHE::llc_replacement_final_stats()
+{
+    (this->*policies.llc_replacement.final_stats)();
+}
+#else
+void load_policies()
+{
+}
+#endif
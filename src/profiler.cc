@@ -0,0 +1,173 @@
+#include "profiler.h"
+#include "ooo_cpu.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+uint64_t profile_period = 0;
+uint8_t profile_active = 0;
+
+uint32_t profile_stack[PROFILE_MAX_DEPTH],
+         profile_depth = 0;
+uint64_t profile_ticks[NUM_PROFILE_STAGES],
+         profile_calls[NUM_PROFILE_STAGES],
+         profile_last,
+         profile_cycles = 0,
+         profile_timed_cycles = 0,
+         profile_functional_start,
+         profile_functional_ticks = 0,
+         profile_start_ticks,
+         profile_start_instr = 0;
+struct timespec profile_start_time;
+
+static const char *profile_core_name[PROFILE_CACHE] = {
+    "other", "handle_branch", "branch_predictor", "fetch_instruction", "schedule_instruction",
+    "execute_instruction", "operate_lsq", "update_rob", "retire_rob", "DRAM operate"
+};
+static const char *profile_cache_name[7] = {"ITLB", "DTLB", "STLB", "L1I", "L1D", "L2C", "LLC"};
+static const char *profile_cache_stage_name[PROFILE_CACHE_STAGES] = {
+    "handle_fill", "handle_writeback", "handle_read", "handle_prefetch", "replacement", "prefetcher"
+};
+
+// rdtsc where available, converted to seconds against the wall clock at the end of the run
+static inline uint64_t profile_now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+void profile_push(uint32_t stage)
+{
+    uint64_t now = profile_now();
+    profile_ticks[profile_stack[profile_depth-1]] += now - profile_last;
+    profile_last = now;
+
+    assert(profile_depth < PROFILE_MAX_DEPTH);
+    profile_stack[profile_depth++] = stage;
+    profile_calls[stage]++;
+}
+
+void profile_pop()
+{
+    uint64_t now = profile_now();
+    profile_ticks[profile_stack[profile_depth-1]] += now - profile_last;
+    profile_last = now;
+
+    profile_depth--;
+}
+
+void profile_start()
+{
+    if (profile_period == 0)
+        return;
+
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        profile_start_instr += ooo_cpu[i].num_retired;
+    clock_gettime(CLOCK_MONOTONIC, &profile_start_time);
+    profile_start_ticks = profile_now();
+}
+
+void profile_cycle_begin()
+{
+    if (profile_period == 0)
+        return;
+
+    profile_cycles++;
+    if (profile_cycles % profile_period)
+        return;
+
+    profile_timed_cycles++;
+    profile_active = 1;
+    profile_depth = 1;
+    profile_stack[0] = PROFILE_OTHER;
+    profile_last = profile_now();
+}
+
+void profile_cycle_end()
+{
+    if (profile_active == 0)
+        return;
+
+    assert(profile_depth == 1);
+    profile_pop();
+    profile_active = 0;
+}
+
+// functional instructions run outside of cycles, they are timed in full and kept out of the sampled stages
+void profile_functional_begin()
+{
+    if (profile_period == 0)
+        return;
+
+    profile_functional_start = profile_now();
+    if (profile_active)
+        profile_ticks[profile_stack[profile_depth-1]] += profile_functional_start - profile_last;
+}
+
+void profile_functional_end()
+{
+    if (profile_period == 0)
+        return;
+
+    uint64_t now = profile_now();
+    profile_functional_ticks += now - profile_functional_start;
+    if (profile_active)
+        profile_last = now;
+}
+
+void print_profile_stats()
+{
+    if (profile_period == 0)
+        return;
+
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double seconds = (end_time.tv_sec - profile_start_time.tv_sec) + (end_time.tv_nsec - profile_start_time.tv_nsec) / 1e9,
+           ticks_per_second = (profile_now() - profile_start_ticks) / seconds,
+           functional_seconds = profile_functional_ticks / ticks_per_second;
+
+    uint64_t instr = 0;
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        instr += ooo_cpu[i].num_retired;
+    instr -= profile_start_instr;
+
+    double sampled_ticks = 0, policy_ticks = 0;
+    for (uint32_t i=0; i<NUM_PROFILE_STAGES; i++)
+        sampled_ticks += profile_ticks[i];
+    policy_ticks = profile_ticks[PROFILE_BRANCH_PREDICTOR];
+    for (uint32_t i=0; i<7; i++)
+        policy_ticks += profile_ticks[PROFILE_CACHE_STAGE(i, PROFILE_REPLACEMENT)] + profile_ticks[PROFILE_CACHE_STAGE(i, PROFILE_PREFETCHER)];
+    if (sampled_ticks == 0)
+        sampled_ticks = 1;
+
+    cout << endl << "Simulator Profile" << endl;
+    cout << "Host time: " << seconds << " sec instructions: " << instr << " KIPS: " << instr / seconds / 1000;
+    cout << " cycles: " << profile_cycles << " KCPS: " << profile_cycles / seconds / 1000 << endl;
+    cout << "Timed cycles: " << profile_timed_cycles << " (one in " << profile_period << ")";
+    cout << " functional warmup/fast-forward: " << functional_seconds << " sec" << endl;
+    cout << "Policy hooks (branch predictor, replacement, prefetchers): " << 100 * policy_ticks / sampled_ticks << "% of timed cycles" << endl;
+
+    // estimated seconds scale the timed cycles up to the detailed part of the run
+    double detailed_seconds = seconds - functional_seconds;
+    for (uint32_t i=0; i<NUM_PROFILE_STAGES; i++) {
+        if (profile_ticks[i] == 0)
+            continue;
+
+        string name;
+        if (i < PROFILE_CACHE)
+            name = profile_core_name[i];
+        else
+            name = string(profile_cache_name[(i - PROFILE_CACHE) / PROFILE_CACHE_STAGES]) + " " + profile_cache_stage_name[(i - PROFILE_CACHE) % PROFILE_CACHE_STAGES];
+
+        cout << "  " << setw(22) << left << name << right << setw(8) << fixed << setprecision(2) << 100 * profile_ticks[i] / sampled_ticks << "%";
+        cout << setw(10) << detailed_seconds * profile_ticks[i] / sampled_ticks << " sec  calls: " << profile_calls[i] << endl;
+        cout.unsetf(ios::floatfield);
+        cout << setprecision(6);
+    }
+}
@@ -0,0 +1,239 @@
+#include "sampling.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+#include "profiler.h"
+#include "checkpoint.h"
+
+#include <cmath>
+
+uint64_t sample_period = 0,
+         sample_warmup = 2000,
+         sample_size = 1000;
+double sample_error = 0.03;
+uint8_t sample_drain = 0;
+
+#define SAMPLE_DETAILED_WARMUP 0
+#define SAMPLE_MEASURE 1
+#define SAMPLE_MEASURED 2
+
+uint8_t sample_initialized = 0,
+        sample_converged = 0,
+        sample_phase[NUM_CPUS];
+uint64_t sample_start[NUM_CPUS], // instruction count at which the current period started
+         measure_instr[NUM_CPUS],
+         measure_cycle[NUM_CPUS],
+         measure_miss[NUM_CPUS],
+         fast_forward_instr[NUM_CPUS],
+         num_samples = 0,
+         drain_start_cycle;
+double sum_cpi[NUM_CPUS], sum_cpi2[NUM_CPUS],
+       sum_mpki[NUM_CPUS], sum_mpki2[NUM_CPUS];
+
+static uint64_t llc_misses(uint32_t cpu)
+{
+    uint64_t misses = 0;
+    for (uint32_t i=0; i<NUM_TYPES; i++)
+        misses += uncore->LLC.sim_miss[cpu][i];
+
+    return misses;
+}
+
+// half width of the confidence interval of the mean
+static double half_width(double sum, double sum2, uint64_t n)
+{
+    if (n < 2)
+        return 0;
+
+    double mean = sum / n,
+           variance = (sum2 - n*mean*mean) / (n - 1);
+    if (variance < 0)
+        variance = 0;
+
+    return SAMPLE_Z * sqrt(variance / n);
+}
+
+static uint8_t within_error(double sum, double sum2, uint64_t n)
+{
+    double mean = sum / n;
+
+    return (mean == 0) || (half_width(sum, sum2, n) <= sample_error * mean);
+}
+
+static uint8_t cache_idle(CACHE *cache)
+{
+    return (cache->RQ.occupancy == 0) && (cache->WQ.occupancy == 0) && (cache->PQ.occupancy == 0) && (cache->MSHR.occupancy == 0) && (cache->PROCESSED.occupancy == 0);
+}
+
+// functional accesses bypass the queues, so nothing may be in flight when they start
+// pending DRAM writes do not touch any cache and are left to the write drain policy
+static uint8_t machine_drained()
+{
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        if (ooo_cpu[i].ROB.occupancy || ooo_cpu[i].LQ.occupancy || ooo_cpu[i].SQ.occupancy)
+            return 0;
+        if (!cache_idle(&ooo_cpu[i].ITLB) || !cache_idle(&ooo_cpu[i].DTLB) || !cache_idle(&ooo_cpu[i].STLB) ||
+            !cache_idle(&ooo_cpu[i].L1I) || !cache_idle(&ooo_cpu[i].L1D) || !cache_idle(&ooo_cpu[i].L2C))
+            return 0;
+    }
+    if (!cache_idle(&uncore->LLC))
+        return 0;
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+        if (uncore->DRAM.RQ[i].occupancy)
+            return 0;
+    }
+
+    return 1;
+}
+
+// functional warmup up to the start of the next period, cores take turns one instruction at a time
+// a checkpoint signal stops it early, the main loop then writes the checkpoint
+static void fast_forward()
+{
+    uint8_t functional_cores = NUM_CPUS;
+    while (functional_cores && (checkpoint_signal == 0)) {
+        functional_cores = 0;
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            if (ooo_cpu[i].num_retired >= sample_start[i])
+                continue;
+
+            ooo_cpu[i].functional_instruction();
+            fast_forward_instr[i]++;
+            functional_cores++;
+
+            if (show_heartbeat && (ooo_cpu[i].num_retired >= ooo_cpu[i].next_print_instruction)) {
+                cout << "Fast-forward CPU " << i << " instructions: " << ooo_cpu[i].num_retired << " samples: " << num_samples;
+                print_simulation_time();
+                ooo_cpu[i].next_print_instruction += STAT_PRINTING_PERIOD;
+            }
+        }
+    }
+
+    // the heartbeat IPC only covers detailed simulation
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        ooo_cpu[i].last_sim_instr = ooo_cpu[i].num_retired;
+        ooo_cpu[i].last_sim_cycle = current_core_cycle[i];
+    }
+}
+
+uint64_t detailed_instructions(uint32_t cpu)
+{
+    return ooo_cpu[cpu].num_retired - ooo_cpu[cpu].begin_sim_instr - fast_forward_instr[cpu];
+}
+
+void sampling_operate()
+{
+    if (sample_converged)
+        return;
+
+    if (sample_initialized == 0) {
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            sample_start[i] = ooo_cpu[i].num_retired;
+            sample_phase[i] = SAMPLE_DETAILED_WARMUP;
+        }
+        sample_initialized = 1;
+    }
+
+    if (sample_drain) {
+        if (machine_drained() == 0) {
+            if (current_core_cycle[0] - drain_start_cycle > DEADLOCK_CYCLE) {
+                cerr << "*** Sampling cannot drain the machine after " << DEADLOCK_CYCLE << " cycles ***" << endl;
+                assert(0);
+            }
+            return;
+        }
+
+        // the next period starts one period after the last one, or right away if draining took longer
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            sample_start[i] += sample_period;
+            uint64_t end_instr = ooo_cpu[i].begin_sim_instr + ooo_cpu[i].simulation_instructions;
+            if (sample_start[i] > end_instr)
+                sample_start[i] = end_instr;
+        }
+        profile_functional_begin();
+        fast_forward();
+        profile_functional_end();
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            if (sample_start[i] < ooo_cpu[i].num_retired)
+                sample_start[i] = ooo_cpu[i].num_retired;
+            sample_phase[i] = SAMPLE_DETAILED_WARMUP;
+        }
+        sample_drain = 0;
+        return;
+    }
+
+    uint32_t measured = 0;
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        uint64_t retired = ooo_cpu[i].num_retired - sample_start[i];
+
+        if ((sample_phase[i] == SAMPLE_DETAILED_WARMUP) && (retired >= sample_warmup)) {
+            measure_instr[i] = ooo_cpu[i].num_retired;
+            measure_cycle[i] = current_core_cycle[i];
+            measure_miss[i] = llc_misses(i);
+            sample_phase[i] = SAMPLE_MEASURE;
+        }
+
+        if ((sample_phase[i] == SAMPLE_MEASURE) && (retired >= sample_warmup + sample_size)) {
+            uint64_t instr = ooo_cpu[i].num_retired - measure_instr[i];
+            double cpi = (double)(current_core_cycle[i] - measure_cycle[i]) / instr,
+                   mpki = 1000.0 * (llc_misses(i) - measure_miss[i]) / instr;
+
+            sum_cpi[i] += cpi;
+            sum_cpi2[i] += cpi * cpi;
+            sum_mpki[i] += mpki;
+            sum_mpki2[i] += mpki * mpki;
+            sample_phase[i] = SAMPLE_MEASURED;
+        }
+
+        if (sample_phase[i] == SAMPLE_MEASURED)
+            measured++;
+    }
+
+    // cores that finish their window early keep running until every core has a sample
+    if (measured < NUM_CPUS)
+        return;
+    num_samples++;
+
+    if (num_samples >= SAMPLE_MIN_SAMPLES) {
+        sample_converged = 1;
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            if (!within_error(sum_cpi[i], sum_cpi2[i], num_samples) || !within_error(sum_mpki[i], sum_mpki2[i], num_samples))
+                sample_converged = 0;
+        }
+    }
+
+    // check_core() finishes every core on its next call
+    if (sample_converged) {
+        cout << "Sampling converged after " << num_samples << " samples";
+        print_simulation_time();
+        for (uint32_t i=0; i<NUM_CPUS; i++)
+            ooo_cpu[i].simulation_instructions = ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr;
+        return;
+    }
+
+    sample_drain = 1;
+    drain_start_cycle = current_core_cycle[0];
+}
+
+void print_sampling_stats()
+{
+    cout << endl << "Sampling Statistics" << endl;
+    cout << "Period: " << sample_period << " detailed warmup: " << sample_warmup << " sample size: " << sample_size;
+    cout << " samples: " << num_samples << " converged: " << (sample_converged ? "true" : "false") << endl;
+
+    if (num_samples == 0)
+        return;
+
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        double cpi = sum_cpi[i] / num_samples,
+               cpi_error = half_width(sum_cpi[i], sum_cpi2[i], num_samples),
+               mpki = sum_mpki[i] / num_samples,
+               mpki_error = half_width(sum_mpki[i], sum_mpki2[i], num_samples);
+
+        cout << endl << "CPU " << i << " sampled IPC: " << 1 / cpi << " CPI: " << cpi << " +- " << cpi_error;
+        cout << " (" << 100 * cpi_error / cpi << "%)" << endl;
+        cout << "CPU " << i << " sampled LLC MPKI: " << mpki << " +- " << mpki_error;
+        cout << " (" << ((mpki > 0) ? 100 * mpki_error / mpki : 0) << "%)" << endl;
+        cout << "CPU " << i << " fast-forwarded instructions: " << fast_forward_instr[i];
+        cout << " detailed instructions: " << detailed_instructions(i) << endl;
+    }
+}
@@ -0,0 +1,236 @@
+#include "simpoint.h"
+#include "ooo_cpu.h"
+
+#include <cmath>
+#include <vector>
+
+char simpoint_profile_out[1024];
+uint64_t simpoint_interval = 10000000,
+         simpoint_max_k = 10;
+
+typedef vector <double> BBV;
+
+// every basic block gets a fixed random direction in [-1, 1] derived from its first ip
+static double projection(uint64_t block_ip, uint32_t dim)
+{
+    uint64_t x = block_ip * 0x9E3779B97F4A7C15ULL + (dim + 1) * 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 31;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 29;
+
+    return (2.0 * (x >> 11)) / (double)(1ULL << 53) - 1.0;
+}
+
+static double distance(const BBV &a, const BBV &b)
+{
+    double dist = 0;
+    for (uint32_t d=0; d<SIMPOINT_DIM; d++)
+        dist += (a[d] - b[d]) * (a[d] - b[d]);
+
+    return dist;
+}
+
+// a basic block ends at a branch, its instructions are counted towards the block's first ip
+// vectors are normalized by the interval length, a trailing partial interval is dropped
+static void collect_bbv(O3_CPU *core, vector <BBV> &bbv)
+{
+    BBV current(SIMPOINT_DIM, 0);
+    uint64_t block_ip = 0, block_size = 0, interval_size = 0;
+
+    while (core->trace.read(knob_cloudsuite ? (void *)&core->current_cloudsuite_instr : (void *)&core->current_instr)) {
+        uint64_t ip = knob_cloudsuite ? core->current_cloudsuite_instr.ip : core->current_instr.ip;
+        uint8_t is_branch = knob_cloudsuite ? core->current_cloudsuite_instr.is_branch : core->current_instr.is_branch;
+
+        if (block_size == 0)
+            block_ip = ip;
+        block_size++;
+        interval_size++;
+
+        if (is_branch || (interval_size == simpoint_interval)) {
+            for (uint32_t d=0; d<SIMPOINT_DIM; d++)
+                current[d] += block_size * projection(block_ip, d);
+            block_size = 0;
+        }
+
+        if (interval_size == simpoint_interval) {
+            for (uint32_t d=0; d<SIMPOINT_DIM; d++)
+                current[d] /= simpoint_interval;
+            bbv.push_back(current);
+
+            current.assign(SIMPOINT_DIM, 0);
+            interval_size = 0;
+        }
+    }
+}
+
+// k-means with k-means++ seeding, returns the distortion (sum of squared distances to the centroids)
+static double kmeans(const vector <BBV> &bbv, uint32_t k, vector <uint32_t> &label, vector <BBV> &centroid, std::mt19937_64 &engine)
+{
+    uint32_t num_bbv = bbv.size();
+    vector <double> min_dist(num_bbv);
+
+    centroid.clear();
+    centroid.push_back(bbv[engine() % num_bbv]);
+    while (centroid.size() < k) {
+        double sum = 0;
+        for (uint32_t i=0; i<num_bbv; i++) {
+            min_dist[i] = distance(bbv[i], centroid[0]);
+            for (uint32_t c=1; c<centroid.size(); c++)
+                min_dist[i] = min(min_dist[i], distance(bbv[i], centroid[c]));
+            sum += min_dist[i];
+        }
+
+        uint32_t next = engine() % num_bbv;
+        if (sum > 0) {
+            double target = std::uniform_real_distribution<double>(0, sum)(engine);
+            for (next=0; next<num_bbv-1; next++) {
+                target -= min_dist[next];
+                if (target <= 0)
+                    break;
+            }
+        }
+        centroid.push_back(bbv[next]);
+    }
+
+    label.assign(num_bbv, k);
+    for (uint32_t iter=0; iter<SIMPOINT_ITERATIONS; iter++) {
+        uint8_t changed = 0;
+        for (uint32_t i=0; i<num_bbv; i++) {
+            uint32_t best = 0;
+            for (uint32_t c=1; c<k; c++) {
+                if (distance(bbv[i], centroid[c]) < distance(bbv[i], centroid[best]))
+                    best = c;
+            }
+            if (label[i] != best) {
+                label[i] = best;
+                changed = 1;
+            }
+        }
+        if (!changed)
+            break;
+
+        vector <uint64_t> size(k, 0);
+        for (uint32_t c=0; c<k; c++)
+            centroid[c].assign(SIMPOINT_DIM, 0);
+        for (uint32_t i=0; i<num_bbv; i++) {
+            size[label[i]]++;
+            for (uint32_t d=0; d<SIMPOINT_DIM; d++)
+                centroid[label[i]][d] += bbv[i][d];
+        }
+        for (uint32_t c=0; c<k; c++) {
+            if (size[c] == 0) // empty cluster, keep it on some interval
+                centroid[c] = bbv[engine() % num_bbv];
+            else {
+                for (uint32_t d=0; d<SIMPOINT_DIM; d++)
+                    centroid[c][d] /= size[c];
+            }
+        }
+    }
+
+    double distortion = 0;
+    for (uint32_t i=0; i<num_bbv; i++)
+        distortion += distance(bbv[i], centroid[label[i]]);
+
+    return distortion;
+}
+
+// Bayesian information criterion of a clustering (Pelleg and Moore), as used by SimPoint
+static double bic(uint32_t num_bbv, uint32_t k, const vector <uint32_t> &label, double distortion)
+{
+    double R = num_bbv, M = SIMPOINT_DIM;
+    double variance = (num_bbv > k) ? distortion / (R - k) : 0;
+    if (variance < 1e-12)
+        variance = 1e-12;
+
+    vector <double> size(k, 0);
+    for (uint32_t i=0; i<num_bbv; i++)
+        size[label[i]]++;
+
+    double likelihood = 0;
+    for (uint32_t c=0; c<k; c++) {
+        if (size[c] == 0)
+            continue;
+        likelihood += size[c]*log(size[c]) - size[c]*log(R) - size[c]/2*log(2*M_PI) - size[c]*M/2*log(variance) - (size[c] - k)/2;
+    }
+
+    double parameters = (k - 1) + M*k + 1;
+
+    return likelihood - parameters/2*log(R);
+}
+
+void simpoint_profile(O3_CPU *core, const char *file_name)
+{
+    vector <BBV> bbv;
+    collect_bbv(core, bbv);
+
+    uint32_t num_bbv = bbv.size();
+    if (num_bbv == 0) {
+        cerr << "*** Trace is shorter than one SimPoint interval: " << simpoint_interval << " ***" << endl;
+        assert(0);
+    }
+    cout << "SimPoint intervals: " << num_bbv << " interval: " << simpoint_interval << endl;
+
+    // cluster for every k and keep the best run of each
+    uint32_t max_k = min((uint64_t)num_bbv, simpoint_max_k);
+    vector < vector <uint32_t> > labels(max_k + 1);
+    vector < vector <BBV> > centroids(max_k + 1);
+    vector <double> score(max_k + 1);
+    std::mt19937_64 engine(champsim_seed);
+
+    for (uint32_t k=1; k<=max_k; k++) {
+        double best_distortion = -1;
+        for (uint32_t seed=0; seed<SIMPOINT_SEEDS; seed++) {
+            vector <uint32_t> label;
+            vector <BBV> centroid;
+            double distortion = kmeans(bbv, k, label, centroid, engine);
+            if ((best_distortion < 0) || (distortion < best_distortion)) {
+                best_distortion = distortion;
+                labels[k] = label;
+                centroids[k] = centroid;
+            }
+        }
+        score[k] = bic(num_bbv, k, labels[k], best_distortion);
+
+        cout << "SimPoint k: " << k << " distortion: " << best_distortion << " BIC: " << score[k] << endl;
+    }
+
+    double min_score = score[1], max_score = score[1];
+    for (uint32_t k=2; k<=max_k; k++) {
+        min_score = min(min_score, score[k]);
+        max_score = max(max_score, score[k]);
+    }
+    uint32_t k = 1;
+    while ((k < max_k) && (score[k] < min_score + SIMPOINT_BIC_THRESHOLD*(max_score - min_score)))
+        k++;
+
+    // the interval closest to each centroid represents its cluster
+    vector <uint32_t> point(k, num_bbv);
+    vector <uint64_t> size(k, 0);
+    for (uint32_t i=0; i<num_bbv; i++) {
+        uint32_t c = labels[k][i];
+        size[c]++;
+        if ((point[c] == num_bbv) || (distance(bbv[i], centroids[k][c]) < distance(bbv[point[c]], centroids[k][c])))
+            point[c] = i;
+    }
+
+    map <uint32_t, double> simpoints;
+    for (uint32_t c=0; c<k; c++) {
+        if (size[c])
+            simpoints[point[c]] = (double)size[c] / num_bbv;
+    }
+
+    FILE *simpoint_file = fopen(file_name, "w");
+    if (simpoint_file == NULL) {
+        cerr << "*** Cannot write SimPoint file: " << file_name << " ***" << endl;
+        assert(0);
+    }
+    fprintf(simpoint_file, "# interval: %lu intervals: %u k: %lu\n", simpoint_interval, num_bbv, simpoints.size());
+    fprintf(simpoint_file, "# simpoint weight\n");
+    for (map <uint32_t, double>::iterator it = simpoints.begin(); it != simpoints.end(); ++it) {
+        fprintf(simpoint_file, "%u %.6f\n", it->first, it->second);
+        cout << "SimPoint " << it->first << " start: " << it->first * simpoint_interval << " weight: " << it->second << endl;
+    }
+    fclose(simpoint_file);
+
+    cout << "SimPoint k: " << simpoints.size() << " written to " << file_name << endl;
+}
@@ -0,0 +1,541 @@
+#include "trace_reader.h"
+#include "trace_decoder.h"
+#include "trace_server.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+char trace_cache_dir[1024];
+
+// sources opened by open(), the next core that opens the same trace attaches to it
+static TRACE_SOURCE *shared_source[NUM_CPUS];
+static uint32_t num_shared_sources = 0;
+
+static void trace_reader_thread(TRACE_SOURCE *source)
+{
+    source->read_blocks();
+}
+
+TRACE_SOURCE::TRACE_SOURCE(const char *name, uint8_t format, uint32_t record_size, uint64_t start_record) : format(format), record_size(record_size), start_record(start_record)
+{
+    snprintf(file_name, sizeof(file_name), "%s", name);
+
+    block = NULL;
+    num_blocks = 0;
+    filled = 0;
+    for (uint32_t i=0; i<NUM_CPUS; i++)
+        reader[i] = NULL;
+    num_readers = 0;
+    attached_readers = 0;
+    started = 0;
+    stop = 0;
+}
+
+TRACE_SOURCE::~TRACE_SOURCE()
+{
+    if (decoder.joinable()) {
+        stop = 1;
+        decoder.join();
+    }
+    for (uint32_t i=0; i<num_blocks; i++)
+        delete[] block[i].data;
+    delete[] block;
+
+    for (uint32_t i=0; i<num_shared_sources; i++) {
+        if (shared_source[i] == this)
+            shared_source[i] = shared_source[--num_shared_sources];
+    }
+}
+
+void TRACE_SOURCE::attach(TRACE_READER *trace)
+{
+    reader[num_readers++] = trace;
+    attached_readers++;
+
+    trace->source = this;
+    trace->released = 0;
+    trace->current = NULL;
+    trace->position = 0;
+    trace->drop_records = 0;
+}
+
+// called by the first read of any attached core, the cores that skipped further ahead than the others
+// drop the records in between from the ring
+void TRACE_SOURCE::start()
+{
+    std::lock_guard<std::mutex> lock(start_lock);
+    if (started.load())
+        return;
+
+    start_record = UINT64_MAX;
+    for (uint32_t i=0; i<num_readers; i++) {
+        if (reader[i].load())
+            start_record = min(start_record, reader[i].load()->record_number);
+    }
+    for (uint32_t i=0; i<num_readers; i++) {
+        if (reader[i].load())
+            reader[i].load()->drop_records = reader[i].load()->record_number - start_record;
+    }
+
+    num_blocks = (attached_readers.load() > 1) ? TRACE_SHARED_BLOCKS : TRACE_BLOCKS;
+    uint64_t block_size = TRACE_BLOCK_SIZE - (TRACE_BLOCK_SIZE % record_size);
+    block = new TRACE_BLOCK[num_blocks];
+    for (uint32_t i=0; i<num_blocks; i++) {
+        block[i].data = new char[block_size];
+        block[i].size = 0;
+        block[i].end_of_trace = 0;
+    }
+
+    decoder = std::thread(trace_reader_thread, this);
+    started.store(1, std::memory_order_release);
+}
+
+// blocks released by every attached core, a detached core holds nothing back
+uint64_t TRACE_SOURCE::released()
+{
+    uint64_t slowest = filled.load(std::memory_order_relaxed);
+    for (uint32_t i=0; i<num_readers; i++) {
+        TRACE_READER *trace = reader[i].load(std::memory_order_acquire);
+        if (trace)
+            slowest = min(slowest, trace->released.load(std::memory_order_acquire));
+    }
+
+    return slowest;
+}
+
+// reader thread: decompress whole blocks ahead of the cores, wrapping around at the end of the trace
+void TRACE_SOURCE::read_blocks()
+{
+    TRACE_DECODER decoder(format, file_name, record_size, start_record);
+    uint64_t block_size = TRACE_BLOCK_SIZE - (TRACE_BLOCK_SIZE % record_size);
+
+    // only compact traces can seek, the others decode and drop the records before the start
+    if (format != TRACE_COMPACT) {
+        uint64_t skip_bytes = start_record * record_size, decoded = 0;
+        while (skip_bytes && (stop.load() == 0)) {
+            uint64_t bytes = decoder.decode(block[0].data, min(skip_bytes, block_size));
+            if (bytes == 0) {
+                skip_bytes += decoded % record_size; // a truncated last record is not a record
+                decoded = 0;
+                decoder.rewind();
+                continue;
+            }
+            decoded += bytes;
+            skip_bytes -= bytes;
+        }
+    }
+
+    while (stop.load() == 0) {
+        uint64_t next = filled.load(std::memory_order_relaxed);
+        if (next - released() >= num_blocks) {
+            // the cores need a while to go through a block, no need to spin
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+
+        TRACE_BLOCK *fill = &block[next % num_blocks];
+        fill->size = 0;
+        fill->end_of_trace = 0;
+        while (fill->size < block_size) {
+            uint64_t bytes = decoder.decode(fill->data + fill->size, block_size - fill->size);
+            if (bytes == 0) {
+                // a truncated last record is dropped, as fread() would
+                fill->size -= fill->size % record_size;
+                fill->end_of_trace = 1;
+                decoder.rewind();
+                break;
+            }
+            fill->size += bytes;
+        }
+
+        filled.store(next + 1, std::memory_order_release);
+    }
+}
+
+void TRACE_READER::open(const char *name, uint32_t size)
+{
+    snprintf(file_name, sizeof(file_name), "%s", name);
+    record_size = size;
+
+    const char *last_dot = strrchr(file_name, '.');
+    char extension = last_dot ? last_dot[1] : '\0';
+    if (extension == 'g') { // gzip format
+        format = TRACE_GZIP;
+        snprintf(command, sizeof(command), "gunzip -c %s", file_name);
+    }
+    else if (extension == 'x') { // xz
+        format = TRACE_XZ;
+        snprintf(command, sizeof(command), "xz -dc %s", file_name);
+    }
+    else if (extension == 'z') { // zstd
+        format = TRACE_ZSTD;
+        snprintf(command, sizeof(command), "zstd -dc %s", file_name);
+    }
+    else if (extension == 'c') // compact, decoded in-process only
+        format = TRACE_COMPACT;
+    else {
+        cout << "ChampSim does not support traces other than gz, xz, zst or ct!" << endl;
+        assert(0);
+    }
+
+    if (trace_cache_dir[0]) {
+        open_cache();
+        return;
+    }
+
+#ifndef ZSTD_TRACE
+    // without libzstd, zstd traces go through the command line tool
+    if (format == TRACE_ZSTD) {
+        pipe = popen(command, "r");
+        if (pipe == NULL) {
+            printf("\n*** Trace file not found: %s ***\n\n", file_name);
+            assert(0);
+        }
+        format = TRACE_PIPE;
+        return;
+    }
+#endif
+
+    if (access(file_name, R_OK)) {
+        printf("\n*** Trace file not found: %s ***\n\n", file_name);
+        assert(0);
+    }
+
+    if (trace_server_name[0]) {
+        channel = attach_channel(file_name, format, record_size, channel_slot, channel_data);
+        if (channel)
+            return;
+    }
+
+    // e.g., the same benchmark on every core, decompressed once
+    for (uint32_t i=0; i<num_shared_sources; i++) {
+        TRACE_SOURCE *shared = shared_source[i];
+        if ((strcmp(shared->file_name, file_name) == 0) && (shared->record_size == record_size) && !shared->started.load()) {
+            shared->attach(this);
+            return;
+        }
+    }
+
+    shared_source[num_shared_sources++] = new TRACE_SOURCE(file_name, format, record_size, 0);
+    shared_source[num_shared_sources-1]->attach(this);
+}
+
+// crc32 and adler32 of the compressed trace, a cached copy is found again whatever the trace is named
+static uint64_t hash_trace_file(const char *file_name)
+{
+    FILE *file = fopen(file_name, "rb");
+    if (file == NULL) {
+        printf("\n*** Trace file not found: %s ***\n\n", file_name);
+        assert(0);
+    }
+
+    uint8_t *buffer = new uint8_t[TRACE_INPUT_SIZE];
+    uLong crc = crc32(0, Z_NULL, 0), adler = adler32(0, Z_NULL, 0);
+    size_t bytes;
+    while ((bytes = fread(buffer, 1, TRACE_INPUT_SIZE, file)) > 0) {
+        crc = crc32(crc, buffer, bytes);
+        adler = adler32(adler, buffer, bytes);
+    }
+    fclose(file);
+    delete[] buffer;
+
+    return ((uint64_t)crc << 32) | (adler & 0xffffffff);
+}
+
+// the first run that needs a trace writes its cached copy, the file only appears under its name once complete
+// so that concurrent runs either map a whole copy or write their own
+void TRACE_READER::open_cache()
+{
+    mkdir(trace_cache_dir, 0777); // fails if it exists, anything else shows up below
+
+    char cache_name[1024+64];
+    snprintf(cache_name, sizeof(cache_name), "%s/%016llx-%u.raw", trace_cache_dir, (unsigned long long)hash_trace_file(file_name), record_size);
+    if (access(cache_name, R_OK))
+        write_cache(cache_name);
+
+    int fd = ::open(cache_name, O_RDONLY);
+    struct stat cache_stat;
+    if ((fd < 0) || fstat(fd, &cache_stat)) {
+        cerr << "*** Cannot open trace cache: " << cache_name << " ***" << endl;
+        assert(0);
+    }
+    map_size = cache_stat.st_size;
+    map = (char *)mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        cerr << "*** Cannot map trace cache: " << cache_name << " ***" << endl;
+        assert(0);
+    }
+
+    TRACE_CACHE_HEADER *header = (TRACE_CACHE_HEADER *)map;
+    if ((map_size < sizeof(TRACE_CACHE_HEADER)) || memcmp(header->magic, TRACE_CACHE_MAGIC, sizeof(header->magic))
+        || (header->record_size != record_size) || (map_size != sizeof(TRACE_CACHE_HEADER) + header->num_records * record_size)) {
+        cerr << "*** Corrupted trace cache, delete it: " << cache_name << " ***" << endl;
+        assert(0);
+    }
+    map_records = header->num_records;
+
+    // read front to back, page faults map whole huge pages where the file system supports it
+    madvise(map, map_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(map, map_size, MADV_HUGEPAGE);
+#endif
+
+    format = TRACE_MAPPED;
+    cout << "Trace cache: " << file_name << " -> " << cache_name << endl;
+}
+
+void TRACE_READER::write_cache(const char *cache_name)
+{
+    char temp_name[1024+80];
+    snprintf(temp_name, sizeof(temp_name), "%s.%d", cache_name, getpid());
+    FILE *out = fopen(temp_name, "wb");
+    if (out == NULL) {
+        cerr << "*** Cannot write trace cache: " << temp_name << " ***" << endl;
+        assert(0);
+    }
+
+    TRACE_CACHE_HEADER header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_CACHE_MAGIC, sizeof(header.magic));
+    header.record_size = record_size;
+    fwrite(&header, sizeof(header), 1, out);
+
+    // without libzstd, zstd traces go through the command line tool
+    TRACE_DECODER *decoder = NULL;
+    FILE *input = NULL;
+#ifndef ZSTD_TRACE
+    if (format == TRACE_ZSTD)
+        input = popen(command, "r");
+#endif
+    if (input == NULL)
+        decoder = new TRACE_DECODER(format, file_name, record_size, 0);
+
+    uint64_t block_size = TRACE_BLOCK_SIZE - (TRACE_BLOCK_SIZE % record_size);
+    char *data = new char[block_size];
+    uint8_t end_of_trace = 0;
+    while (!end_of_trace) {
+        uint64_t size = 0;
+        while (size < block_size) {
+            uint64_t bytes = decoder ? decoder->decode(data + size, block_size - size) : fread(data + size, 1, block_size - size, input);
+            if (bytes == 0) {
+                end_of_trace = 1;
+                break;
+            }
+            size += bytes;
+        }
+
+        // a truncated last record is dropped, as fread() would
+        size -= size % record_size;
+        fwrite(data, 1, size, out);
+        header.num_records += size / record_size;
+    }
+    delete[] data;
+    delete decoder;
+    if (input)
+        pclose(input);
+
+    if (header.num_records == 0) {
+        cerr << "*** Trace " << file_name << ": empty trace ***" << endl;
+        assert(0);
+    }
+
+    rewind(out);
+    fwrite(&header, sizeof(header), 1, out);
+    if (fclose(out) || rename(temp_name, cache_name)) {
+        cerr << "*** Cannot write trace cache: " << cache_name << " ***" << endl;
+        unlink(temp_name);
+        assert(0);
+    }
+
+    cout << "Trace cache: " << file_name << " instructions: " << header.num_records << " bytes: " << sizeof(header) + header.num_records * record_size << endl;
+}
+
+// e.g., the trace pipe of a variant, which the parent process never closes
+void TRACE_READER::open_pipe(FILE *stream, uint32_t size)
+{
+    pipe = stream;
+    record_size = size;
+    format = TRACE_PIPE;
+}
+
+// leaves the source, the last core to leave stops its reader thread
+void TRACE_READER::close()
+{
+    if (channel) {
+        detach_channel(channel, channel_slot, channel_data);
+        channel = NULL;
+        channel_data = NULL;
+        current = NULL;
+    }
+    if (map) {
+        munmap(map, map_size);
+        map = NULL;
+    }
+    if (source) {
+        for (uint32_t i=0; i<source->num_readers; i++) {
+            if (source->reader[i].load() == this)
+                source->reader[i].store(NULL, std::memory_order_release);
+        }
+        current = NULL;
+        if (--source->attached_readers == 0)
+            delete source;
+        source = NULL;
+    }
+    if (pipe) {
+        if (command[0])
+            pclose(pipe);
+        else
+            fclose(pipe);
+        pipe = NULL;
+    }
+}
+
+// continues on a reader thread of its own starting at start_record
+void TRACE_READER::detach(uint64_t start_record)
+{
+    close();
+    record_number = start_record;
+    TRACE_SOURCE *own = new TRACE_SOURCE(file_name, format, record_size, start_record);
+    own->attach(this);
+}
+
+uint8_t TRACE_READER::read(void *record)
+{
+    if (format == TRACE_MAPPED) {
+        if (record_number == map_records) {
+            record_number = 0;
+            return 0;
+        }
+        memcpy(record, map + sizeof(TRACE_CACHE_HEADER) + record_number * record_size, record_size);
+        record_number++;
+        return 1;
+    }
+
+    if (format == TRACE_PIPE) {
+        if (fread(record, record_size, 1, pipe)) {
+            record_number++;
+            return 1;
+        }
+        record_number = 0;
+
+        if (command[0] == '\0') {
+            cerr << endl << "*** Trace pipe closed ***" << endl;
+            assert(0);
+        }
+
+        // close the trace file and re-open it
+        pclose(pipe);
+        pipe = popen(command, "r");
+        if (pipe == NULL) {
+            cerr << endl << "*** CANNOT REOPEN TRACE FILE: " << file_name << " ***" << endl;
+            assert(0);
+        }
+        return 0;
+    }
+
+    while (1) {
+        if ((current == NULL) && channel) {
+            uint64_t next = released.load(std::memory_order_relaxed);
+            for (uint64_t spins=1; channel && (channel->filled.load(std::memory_order_acquire) == next); spins++) {
+                // as with cores of this simulator, never wait for a client a whole ring behind, nor for a server
+                // that went away or cannot read the trace
+                if ((next - channel->released() >= TRACE_SERVER_BLOCKS) || (channel->state.load() == CHANNEL_FAILED)
+                    || (((spins % 4096) == 0) && !trace_server_alive()))
+                    detach(record_number);
+                else
+                    std::this_thread::yield();
+            }
+            if (channel) {
+                uint32_t index = next % TRACE_SERVER_BLOCKS;
+                channel_block.data = channel_data + (uint64_t)index * TRACE_BLOCK_SIZE;
+                channel_block.size = channel->block_size[index];
+                channel_block.end_of_trace = channel->end_of_trace[index];
+                current = &channel_block;
+                position = 0;
+            }
+        }
+
+        if (current == NULL) {
+            if (source->started.load(std::memory_order_acquire) == 0)
+                source->start();
+
+            uint64_t next = released.load(std::memory_order_relaxed);
+            while (source->filled.load(std::memory_order_acquire) == next) {
+                // a core that runs the same trace is a whole ring behind, it only catches up once this core
+                // moves on, so go on with a reader of its own instead of waiting
+                if ((source->attached_readers.load() > 1) && (next - source->released() >= source->num_blocks)) {
+                    detach(record_number);
+                    source->start();
+                    next = 0;
+                    continue;
+                }
+                std::this_thread::yield();
+            }
+            current = &source->block[next % source->num_blocks];
+            position = 0;
+        }
+
+        if (drop_records) {
+            uint64_t records = min(drop_records, (current->size - position) / record_size);
+            position += records * record_size;
+            drop_records -= records;
+        }
+
+        if ((drop_records == 0) && (position + record_size <= current->size)) {
+            memcpy(record, current->data + position, record_size);
+            position += record_size;
+            record_number++;
+            return 1;
+        }
+
+        // hand the block back to the reader thread, a wrap while dropping records goes unnoticed
+        uint8_t end_of_trace = current->end_of_trace;
+        current = NULL;
+        released.store(released.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        if (channel)
+            channel->client[channel_slot].released.store(released.load(std::memory_order_relaxed), std::memory_order_release);
+        if (end_of_trace && (drop_records == 0)) {
+            record_number = 0;
+            return 0;
+        }
+    }
+}
+
+uint8_t TRACE_READER::skip(uint64_t num_records)
+{
+    if (format == TRACE_MAPPED) {
+        record_number = (record_number + num_records) % map_records;
+        return 1;
+    }
+
+    // the server decodes for every client, this one drops the records from the ring or seeks on its own
+    if (channel) {
+        if (format == TRACE_COMPACT)
+            detach(record_number + num_records);
+        else {
+            record_number += num_records;
+            drop_records += num_records;
+        }
+        return 1;
+    }
+
+    if (source == NULL)
+        return 0;
+
+    // nothing decoded yet, the source starts at the first record any of its cores needs
+    if (source->started.load() == 0) {
+        record_number += num_records;
+        return 1;
+    }
+
+    if (format != TRACE_COMPACT)
+        return 0;
+
+    // the decoder wraps the position around the end of the trace, whatever was decoded ahead is dropped
+    detach(record_number + num_records);
+
+    return 1;
+}
@@ -0,0 +1,413 @@
+#include "trace_server.h"
+#include "trace_decoder.h"
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+char trace_server_name[256], serve_traces_name[256];
+
+#define TRACE_SERVER_RING_BYTES ((uint64_t)TRACE_SERVER_BLOCKS * TRACE_BLOCK_SIZE)
+
+static TRACE_SERVER_CONTROL *control = NULL;
+
+// a process that died holding the lock leaves nothing half done, the slots it held are swept by the server
+static void lock_control()
+{
+    if (pthread_mutex_lock(&control->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&control->lock);
+}
+
+static void unlock_control()
+{
+    pthread_mutex_unlock(&control->lock);
+}
+
+static uint8_t process_alive(int32_t pid)
+{
+    return (kill(pid, 0) == 0) || (errno == EPERM);
+}
+
+// blocks released by every client, a free slot holds nothing back
+uint64_t TRACE_CHANNEL::released()
+{
+    uint64_t slowest = filled.load(std::memory_order_relaxed);
+    for (uint32_t i=0; i<TRACE_SERVER_CLIENTS; i++) {
+        if (client[i].pid.load(std::memory_order_acquire))
+            slowest = min(slowest, client[i].released.load(std::memory_order_acquire));
+    }
+
+    return slowest;
+}
+
+uint8_t trace_server_alive()
+{
+    return control && control->server_pid && process_alive(control->server_pid);
+}
+
+static uint64_t modification_time(const struct stat *file_stat)
+{
+    return (uint64_t)file_stat->st_mtim.tv_sec * 1000000000 + file_stat->st_mtim.tv_nsec;
+}
+
+// the file behind the canonical path is still the one the client opened
+static uint8_t same_trace(TRACE_CHANNEL *channel, const struct stat *file_stat)
+{
+    return (channel->device == (uint64_t)file_stat->st_dev) && (channel->inode == (uint64_t)file_stat->st_ino)
+        && (channel->size == (uint64_t)file_stat->st_size) && (channel->mtime == modification_time(file_stat));
+}
+
+TRACE_CHANNEL *attach_channel(const char *name, uint8_t format, uint32_t record_size, uint32_t &slot, char *&data)
+{
+    // the server runs in a directory of its own, and traces of the same name in two directories are different traces
+    char file_name[PATH_MAX];
+    struct stat file_stat;
+    if ((realpath(name, file_name) == NULL) || (strlen(file_name) >= sizeof(control->channel[0].file_name)) || stat(file_name, &file_stat)) {
+        cout << "Trace server " << trace_server_name << " cannot resolve " << name << ", decoding it locally" << endl;
+        return NULL;
+    }
+
+    if (control == NULL) {
+        char control_name[300];
+        snprintf(control_name, sizeof(control_name), "/champsim-%s", trace_server_name);
+        int fd = shm_open(control_name, O_RDWR, 0);
+        if (fd >= 0) {
+            void *map = mmap(NULL, sizeof(TRACE_SERVER_CONTROL), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (map != MAP_FAILED)
+                control = (TRACE_SERVER_CONTROL *)map;
+        }
+    }
+    if (!trace_server_alive()) {
+        cout << "Trace server " << trace_server_name << " is not running, decoding " << file_name << " locally" << endl;
+        return NULL;
+    }
+
+    // join a channel of the same trace that still holds its first block, or ask for a new one
+    TRACE_CHANNEL *channel = NULL;
+    lock_control();
+    for (uint32_t i=0; (i<TRACE_SERVER_CHANNELS) && (channel == NULL); i++) {
+        TRACE_CHANNEL *candidate = &control->channel[i];
+        uint32_t state = candidate->state.load();
+        if (((state != CHANNEL_REQUESTED) && (state != CHANNEL_SERVING)) || candidate->recycled
+            || strcmp(candidate->file_name, file_name) || !same_trace(candidate, &file_stat) || (candidate->record_size != record_size))
+            continue;
+
+        for (slot=0; slot<TRACE_SERVER_CLIENTS; slot++) {
+            if (candidate->client[slot].pid.load() == 0) {
+                channel = candidate;
+                break;
+            }
+        }
+    }
+    for (uint32_t i=0; (i<TRACE_SERVER_CHANNELS) && (channel == NULL); i++) {
+        TRACE_CHANNEL *candidate = &control->channel[i];
+        if (candidate->state.load() != CHANNEL_FREE)
+            continue;
+
+        snprintf(candidate->file_name, sizeof(candidate->file_name), "%s", file_name);
+        candidate->device = file_stat.st_dev;
+        candidate->inode = file_stat.st_ino;
+        candidate->size = file_stat.st_size;
+        candidate->mtime = modification_time(&file_stat);
+        candidate->format = format;
+        candidate->record_size = record_size;
+        candidate->generation = ++control->generation;
+        candidate->recycled = 0;
+        candidate->filled = 0;
+        for (uint32_t j=0; j<TRACE_SERVER_CLIENTS; j++)
+            candidate->client[j].pid = 0;
+        candidate->state = CHANNEL_REQUESTED;
+
+        channel = candidate;
+        slot = 0;
+    }
+    if (channel) {
+        channel->client[slot].released = 0;
+        channel->client[slot].pid.store(getpid(), std::memory_order_release);
+    }
+    unlock_control();
+
+    if (channel == NULL) {
+        cout << "Trace server " << trace_server_name << " serves " << TRACE_SERVER_CHANNELS << " traces already, decoding " << file_name << " locally" << endl;
+        return NULL;
+    }
+
+    while ((channel->state.load() == CHANNEL_REQUESTED) && trace_server_alive())
+        usleep(1000);
+
+    data = NULL;
+    char data_name[300];
+    snprintf(data_name, sizeof(data_name), "/champsim-%s-%llu", trace_server_name, (unsigned long long)channel->generation);
+    if (channel->state.load() == CHANNEL_SERVING) {
+        int fd = shm_open(data_name, O_RDONLY, 0);
+        if (fd >= 0) {
+            void *map = mmap(NULL, TRACE_SERVER_RING_BYTES, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (map != MAP_FAILED)
+                data = (char *)map;
+        }
+    }
+    if (data == NULL) {
+        detach_channel(channel, slot, NULL);
+        cout << "Trace server " << trace_server_name << " cannot serve " << file_name << ", decoding it locally" << endl;
+        return NULL;
+    }
+
+    cout << "Trace server: " << file_name << " -> " << data_name << endl;
+    return channel;
+}
+
+void detach_channel(TRACE_CHANNEL *channel, uint32_t slot, char *data)
+{
+    if (data)
+        munmap(data, TRACE_SERVER_RING_BYTES);
+    channel->client[slot].pid.store(0, std::memory_order_release);
+}
+
+// server side
+
+class SERVED_CHANNEL {
+  public:
+    char data_name[300];
+    char *data;
+    std::thread decoder;
+    std::atomic<uint8_t> stop;
+};
+
+static volatile sig_atomic_t serve_stop = 0;
+static char serve_control_name[300];
+static SERVED_CHANNEL *served_channels = NULL;
+
+static void stop_serving(int signal)
+{
+    serve_stop = 1;
+}
+
+// the segments live on in /dev/shm after the process, so they go even when the server crashes
+static void crash_serving(int signal)
+{
+    if (served_channels) {
+        for (uint32_t i=0; i<TRACE_SERVER_CHANNELS; i++) {
+            if (served_channels[i].data)
+                shm_unlink(served_channels[i].data_name);
+        }
+    }
+    shm_unlink(serve_control_name);
+
+    // and the signal is raised again, e.g., for the core dump
+    ::signal(signal, SIG_DFL);
+    raise(signal);
+}
+
+// decoder thread of a channel, as TRACE_SOURCE::read_blocks() but for clients in other processes
+// a trace the server cannot read fails the channel, its clients go on decoding it themselves
+static void serve_channel(TRACE_CHANNEL *channel, char *data, std::atomic<uint8_t> *stop)
+{
+    TRACE_DECODER decoder(channel->format, channel->file_name, channel->record_size, 0, 1);
+    if (decoder.failed) {
+        cout << "Cannot serve: " << channel->file_name << endl;
+        channel->state = CHANNEL_FAILED;
+        return;
+    }
+    uint64_t block_size = TRACE_BLOCK_SIZE - (TRACE_BLOCK_SIZE % channel->record_size);
+
+    while (stop->load() == 0) {
+        uint64_t next = channel->filled.load(std::memory_order_relaxed);
+
+        // from now on a client that joins would miss the start of the trace
+        if ((next == TRACE_SERVER_BLOCKS) && !channel->recycled) {
+            lock_control();
+            channel->recycled = 1;
+            unlock_control();
+        }
+
+        if (next - channel->released() >= TRACE_SERVER_BLOCKS) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+
+        uint32_t index = next % TRACE_SERVER_BLOCKS;
+        char *fill = data + (uint64_t)index * TRACE_BLOCK_SIZE;
+        uint64_t size = 0;
+        channel->end_of_trace[index] = 0;
+        while (size < block_size) {
+            uint64_t bytes = decoder.decode(fill + size, block_size - size);
+            if (decoder.failed) {
+                cout << "Cannot serve: " << channel->file_name << endl;
+                channel->state = CHANNEL_FAILED;
+                return;
+            }
+            if (bytes == 0) {
+                // a truncated last record is dropped, as fread() would
+                size -= size % channel->record_size;
+                channel->end_of_trace[index] = 1;
+                decoder.rewind();
+                break;
+            }
+            size += bytes;
+        }
+        channel->block_size[index] = size;
+
+        channel->filled.store(next + 1, std::memory_order_release);
+    }
+}
+
+static void close_channel(TRACE_CHANNEL *channel, SERVED_CHANNEL *served)
+{
+    if (served->decoder.joinable()) {
+        served->stop = 1;
+        served->decoder.join();
+    }
+    if (served->data) {
+        munmap(served->data, TRACE_SERVER_RING_BYTES);
+        shm_unlink(served->data_name);
+        served->data = NULL;
+    }
+    channel->state = CHANNEL_FREE;
+}
+
+void serve_traces(const char *name)
+{
+    char *control_name = serve_control_name;
+    snprintf(control_name, sizeof(serve_control_name), "/champsim-%s", name);
+    snprintf(trace_server_name, sizeof(trace_server_name), "%s", name);
+
+    // a control segment left behind by a server that died is taken over
+    int fd = shm_open(control_name, O_RDWR, 0);
+    if (fd >= 0) {
+        control = (TRACE_SERVER_CONTROL *)mmap(NULL, sizeof(TRACE_SERVER_CONTROL), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if ((control != MAP_FAILED) && trace_server_alive()) {
+            cout << "Trace server " << name << " is already running, pid: " << control->server_pid << endl;
+            assert(0);
+        }
+        if (control != MAP_FAILED)
+            munmap(control, sizeof(TRACE_SERVER_CONTROL));
+        shm_unlink(control_name);
+    }
+
+    fd = shm_open(control_name, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if ((fd < 0) || ftruncate(fd, sizeof(TRACE_SERVER_CONTROL))) {
+        cerr << "*** Cannot create trace server " << control_name << ": " << strerror(errno) << " ***" << endl;
+        assert(0);
+    }
+    control = (TRACE_SERVER_CONTROL *)mmap(NULL, sizeof(TRACE_SERVER_CONTROL), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (control == MAP_FAILED) {
+        cerr << "*** Cannot map trace server " << control_name << ": " << strerror(errno) << " ***" << endl;
+        assert(0);
+    }
+
+    // a new segment is zero filled, which every channel and slot starts from
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&control->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    control->server_pid = getpid();
+
+    signal(SIGINT, stop_serving);
+    signal(SIGTERM, stop_serving);
+    signal(SIGHUP, stop_serving);
+    signal(SIGABRT, crash_serving);
+    signal(SIGSEGV, crash_serving);
+    signal(SIGBUS, crash_serving);
+    signal(SIGFPE, crash_serving);
+    cout << "Serving traces: " << name << " pid: " << getpid() << " ring: " << (TRACE_SERVER_RING_BYTES >> 20) << " MB per trace" << endl;
+
+    SERVED_CHANNEL *served = new SERVED_CHANNEL[TRACE_SERVER_CHANNELS];
+    served_channels = served;
+    uint8_t closing[TRACE_SERVER_CHANNELS];
+    for (uint32_t i=0; i<TRACE_SERVER_CHANNELS; i++) {
+        served[i].data = NULL;
+        closing[i] = 0;
+    }
+
+    while (!serve_stop) {
+        lock_control();
+        for (uint32_t i=0; i<TRACE_SERVER_CHANNELS; i++) {
+            TRACE_CHANNEL *channel = &control->channel[i];
+            uint32_t state = channel->state.load();
+            if (state == CHANNEL_FREE)
+                continue;
+
+            // clients that exited without closing their traces
+            uint32_t clients = 0;
+            for (uint32_t j=0; j<TRACE_SERVER_CLIENTS; j++) {
+                int32_t pid = channel->client[j].pid.load();
+                if (pid && !process_alive(pid))
+                    channel->client[j].pid = 0;
+                else if (pid)
+                    clients++;
+            }
+
+            // unused rings go right away (no client joins a failed channel, its decoder stops once the lock is
+            // released), new ones are refused when the host runs low on memory
+            if (clients == 0) {
+                if (state == CHANNEL_SERVING)
+                    cout << "Released: " << channel->file_name << endl;
+                channel->state = CHANNEL_FAILED;
+                closing[i] = 1;
+                continue;
+            }
+
+            // the client checked the trace just before, so a mismatch means the file was replaced in between
+            struct stat file_stat;
+            if ((state == CHANNEL_REQUESTED) && (stat(channel->file_name, &file_stat) || !same_trace(channel, &file_stat))) {
+                cout << "Cannot serve: " << channel->file_name << " changed" << endl;
+                channel->state = CHANNEL_FAILED;
+                continue;
+            }
+
+            if (state == CHANNEL_REQUESTED) {
+                uint64_t available = (uint64_t)sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+                snprintf(served[i].data_name, sizeof(served[i].data_name), "/champsim-%s-%llu", name, (unsigned long long)channel->generation);
+                fd = (available < 2 * TRACE_SERVER_RING_BYTES) ? -1 : shm_open(served[i].data_name, O_RDWR | O_CREAT | O_TRUNC, 0666);
+                if ((fd >= 0) && (ftruncate(fd, TRACE_SERVER_RING_BYTES) == 0)) {
+                    void *map = mmap(NULL, TRACE_SERVER_RING_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    if (map != MAP_FAILED)
+                        served[i].data = (char *)map;
+                }
+                if (fd >= 0)
+                    close(fd);
+
+                if (served[i].data == NULL) {
+                    cout << "Cannot serve: " << channel->file_name << " available memory: " << (available >> 20) << " MB" << endl;
+                    shm_unlink(served[i].data_name);
+                    channel->state = CHANNEL_FAILED;
+                    continue;
+                }
+
+                // serving before the decoder starts, which fails the channel if it cannot read the trace
+                served[i].stop = 0;
+                channel->state = CHANNEL_SERVING;
+                served[i].decoder = std::thread(serve_channel, channel, served[i].data, &served[i].stop);
+                cout << "Serving: " << channel->file_name << " -> " << served[i].data_name << endl;
+            }
+        }
+        unlock_control();
+
+        for (uint32_t i=0; i<TRACE_SERVER_CHANNELS; i++) {
+            if (closing[i])
+                close_channel(&control->channel[i], &served[i]);
+            closing[i] = 0;
+        }
+
+        usleep(10000);
+    }
+
+    // clients notice the server is gone and decode their traces themselves
+    for (uint32_t i=0; i<TRACE_SERVER_CHANNELS; i++) {
+        if (control->channel[i].state.load() != CHANNEL_FREE)
+            close_channel(&control->channel[i], &served[i]);
+    }
+    control->server_pid = 0;
+    shm_unlink(control_name);
+    served_channels = NULL;
+    delete[] served;
+    cout << "Stopped serving traces: " << name << endl;
+}
@@ -1,9 +1,63 @@
 #include "uncore.h"
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
 // uncore
-UNCORE uncore;
+UNCORE *uncore; // allocated once the configuration is known
+UNCORE_PORT uncore_port[NUM_CPUS];
+
+// core threads
+static std::atomic<uint32_t> uncore_turn(0);
+static std::recursive_mutex uncore_mutex;
+static thread_local uint8_t uncore_core_thread = 0;
 
 // constructor
 UNCORE::UNCORE() {
 
 }
+
+void uncore_enter(uint32_t cpu)
+{
+    // the main thread only runs while the core threads wait, e.g., functional warmup and sampling
+    if ((knob_threads == 0) || (uncore_core_thread == 0))
+        return;
+
+    if (sim_quantum == 1) {
+        while (uncore_turn.load() != cpu)
+            std::this_thread::yield();
+    }
+    else
+        uncore_mutex.lock();
+}
+
+void uncore_exit(uint32_t cpu)
+{
+    if ((knob_threads == 0) || (uncore_core_thread == 0))
+        return;
+
+    // in lock-step mode the turn is held until the core finishes its cycle
+    if (sim_quantum != 1)
+        uncore_mutex.unlock();
+}
+
+void uncore_pass(uint32_t cpu)
+{
+    if ((knob_threads == 0) || (sim_quantum != 1))
+        return;
+
+    // wait for the lower cores to finish this cycle, then hand the turn over
+    uncore_enter(cpu);
+    uncore_turn.store(cpu + 1);
+}
+
+void uncore_thread_begin()
+{
+    uncore_core_thread = 1;
+}
+
+void uncore_reset_turn()
+{
+    uncore_turn.store(0);
+}
@@ -0,0 +1,250 @@
+#include "variant.h"
+#include "config.h"
+#include "checkpoint.h"
+#include "simpoint.h"
+#include "compact_trace.h"
+#include "trace_server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+char variant_config[MAX_VARIANTS][1024];
+uint32_t num_variants = 0;
+int variant_trace_fd[NUM_CPUS];
+
+static void ignore_signal(int signal)
+{
+}
+
+// decompress every trace once and feed it to all variants until the last one closes its pipes
+static void fan_out_traces(char gunzip_command[NUM_CPUS][1024], int pipe_fd[MAX_VARIANTS][NUM_CPUS])
+{
+    FILE *trace_file[NUM_CPUS];
+    char *buffer[NUM_CPUS];
+    uint64_t head[NUM_CPUS], written[MAX_VARIANTS][NUM_CPUS];
+    uint32_t open_pipes = num_variants * NUM_CPUS;
+
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        trace_file[i] = popen(gunzip_command[i], "r");
+        if (trace_file[i] == NULL) {
+            cerr << "*** Cannot run: " << gunzip_command[i] << " ***" << endl;
+            assert(0);
+        }
+        buffer[i] = new char[VARIANT_BUFFER_SIZE];
+        head[i] = 0;
+        for (uint32_t v=0; v<num_variants; v++)
+            written[v][i] = 0;
+    }
+
+    // a byte stays buffered until every variant still reading that trace got it
+    while (open_pipes) {
+        struct pollfd fds[NUM_CPUS + MAX_VARIANTS*NUM_CPUS];
+        int trace_slot[NUM_CPUS], pipe_slot[MAX_VARIANTS][NUM_CPUS], num_fds = 0;
+
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            uint64_t tail = head[i];
+            uint32_t readers = 0;
+            for (uint32_t v=0; v<num_variants; v++) {
+                pipe_slot[v][i] = -1;
+                if (pipe_fd[v][i] < 0)
+                    continue;
+
+                readers++;
+                if (written[v][i] < tail)
+                    tail = written[v][i];
+                fds[num_fds].fd = pipe_fd[v][i];
+                fds[num_fds].events = (written[v][i] < head[i]) ? POLLOUT : 0; // errors are reported either way
+                pipe_slot[v][i] = num_fds++;
+            }
+
+            trace_slot[i] = -1;
+            if ((readers == 0) || (head[i] - tail == VARIANT_BUFFER_SIZE))
+                continue;
+            fds[num_fds].fd = fileno(trace_file[i]);
+            fds[num_fds].events = POLLIN;
+            trace_slot[i] = num_fds++;
+        }
+
+        if (poll(fds, num_fds, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            cerr << "*** Variant trace poll failed: " << strerror(errno) << " ***" << endl;
+            assert(0);
+        }
+
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            // read as much as fits behind the slowest variant, without wrapping
+            if ((trace_slot[i] >= 0) && fds[trace_slot[i]].revents) {
+                uint64_t tail = head[i];
+                for (uint32_t v=0; v<num_variants; v++) {
+                    if ((pipe_fd[v][i] >= 0) && (written[v][i] < tail))
+                        tail = written[v][i];
+                }
+                uint64_t offset = head[i] % VARIANT_BUFFER_SIZE,
+                         space = min(VARIANT_BUFFER_SIZE - (head[i] - tail), VARIANT_BUFFER_SIZE - offset);
+
+                ssize_t bytes = read(fileno(trace_file[i]), buffer[i] + offset, space);
+                if (bytes > 0)
+                    head[i] += bytes;
+                else if (bytes == 0) {
+                    cout << "*** Reached end of trace for Core: " << i << " Repeating trace: " << gunzip_command[i] << endl;
+
+                    pclose(trace_file[i]);
+                    trace_file[i] = popen(gunzip_command[i], "r");
+                    if (trace_file[i] == NULL) {
+                        cerr << endl << "*** CANNOT REOPEN TRACE FILE: " << gunzip_command[i] << " ***" << endl;
+                        assert(0);
+                    }
+                }
+                else if (errno != EINTR) {
+                    cerr << "*** Variant trace read failed: " << strerror(errno) << " ***" << endl;
+                    assert(0);
+                }
+            }
+
+            for (uint32_t v=0; v<num_variants; v++) {
+                if ((pipe_slot[v][i] < 0) || (fds[pipe_slot[v][i]].revents == 0))
+                    continue;
+
+                ssize_t bytes = -1;
+                if ((fds[pipe_slot[v][i]].revents & POLLOUT) && (written[v][i] < head[i])) {
+                    uint64_t offset = written[v][i] % VARIANT_BUFFER_SIZE;
+                    bytes = write(pipe_fd[v][i], buffer[i] + offset, min(head[i] - written[v][i], VARIANT_BUFFER_SIZE - offset));
+                    if (bytes > 0)
+                        written[v][i] += bytes;
+                    else if ((errno == EAGAIN) || (errno == EINTR))
+                        bytes = 0;
+                }
+
+                // the variant finished (or died) and closed its end of the pipe
+                if (bytes < 0) {
+                    close(pipe_fd[v][i]);
+                    pipe_fd[v][i] = -1;
+                    open_pipes--;
+                }
+            }
+        }
+    }
+
+    for (uint32_t i=0; i<NUM_CPUS; i++) {
+        pclose(trace_file[i]);
+        delete[] buffer[i];
+    }
+}
+
+void variant_fork(int argc, char** argv)
+{
+    if (checkpoint_out[0] || simpoint_profile_out[0] || convert_trace_out[0] || trace_cache_dir[0] || trace_server_name[0]) {
+        cout << "Variants cannot be combined with -checkpoint_out, -simpoint_profile, -convert_trace, -trace_cache or -trace_server!" << endl;
+        assert(0);
+    }
+
+    // the parent only needs the decompression command of every trace
+    char gunzip_command[NUM_CPUS][1024];
+    int found_traces = 0;
+    uint32_t count_traces = 0;
+    for (int i=0; i<argc; i++) {
+        if (found_traces) {
+            if (count_traces == NUM_CPUS) {
+                printf("\n*** Too many traces for the configured number of cores ***\n\n");
+                assert(0);
+            }
+
+            const char *last_dot = strrchr(argv[i], '.');
+            if (last_dot && (last_dot[1] == 'g')) // gzip format
+                snprintf(gunzip_command[count_traces], sizeof(gunzip_command[count_traces]), "gunzip -c %s", argv[i]);
+            else if (last_dot && (last_dot[1] == 'x')) // xz
+                snprintf(gunzip_command[count_traces], sizeof(gunzip_command[count_traces]), "xz -dc %s", argv[i]);
+            else if (last_dot && (last_dot[1] == 'z')) // zstd
+                snprintf(gunzip_command[count_traces], sizeof(gunzip_command[count_traces]), "zstd -dc %s", argv[i]);
+            else if (last_dot && (last_dot[1] == 'c')) { // compact traces have no decompression command to fan out
+                cout << "Variants cannot read compact traces, use the gz, xz or zst trace!" << endl;
+                assert(0);
+            }
+            else {
+                cout << "ChampSim does not support traces other than gz, xz or zst compression!" << endl;
+                assert(0);
+            }
+            count_traces++;
+        }
+        else if (strcmp(argv[i], "-traces") == 0)
+            found_traces = 1;
+    }
+    if (count_traces != NUM_CPUS) {
+        printf("\n*** Not enough traces for the configured number of cores ***\n\n");
+        assert(0);
+    }
+
+    // nothing buffered may be written twice by the children
+    cout.flush();
+    fflush(stdout);
+
+    int pipe_fd[MAX_VARIANTS][NUM_CPUS];
+    pid_t pid[MAX_VARIANTS];
+    for (uint32_t v=0; v<num_variants; v++) {
+        int fds[NUM_CPUS][2];
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            if (pipe(fds[i]) < 0) {
+                cerr << "*** Cannot create variant trace pipe: " << strerror(errno) << " ***" << endl;
+                assert(0);
+            }
+        }
+
+        pid[v] = fork();
+        if (pid[v] < 0) {
+            cerr << "*** Cannot fork variant: " << variant_config[v] << " ***" << endl;
+            assert(0);
+        }
+
+        if (pid[v] == 0) {
+            for (uint32_t u=0; u<v; u++) {
+                for (uint32_t i=0; i<NUM_CPUS; i++)
+                    close(pipe_fd[u][i]);
+            }
+            for (uint32_t i=0; i<NUM_CPUS; i++) {
+                close(fds[i][1]);
+                variant_trace_fd[i] = fds[i][0];
+            }
+
+            char output[1024+8];
+            snprintf(output, sizeof(output), "%s.out", variant_config[v]);
+            if (freopen(output, "w", stdout) == NULL) {
+                cerr << "*** Cannot write variant output: " << output << " ***" << endl;
+                assert(0);
+            }
+
+            cout << endl << "*** ChampSim Multicore Out-of-Order Simulator ***" << endl << endl;
+            cout << "Variant: " << v << endl;
+            read_config(variant_config[v]);
+            return;
+        }
+
+        for (uint32_t i=0; i<NUM_CPUS; i++) {
+            close(fds[i][0]);
+            pipe_fd[v][i] = fds[i][1];
+            fcntl(pipe_fd[v][i], F_SETFL, fcntl(pipe_fd[v][i], F_GETFL) | O_NONBLOCK);
+        }
+        cout << "Variant " << v << ": " << variant_config[v] << " pid: " << pid[v] << " output: " << variant_config[v] << ".out" << endl;
+    }
+
+    // a finished variant must not take the parent down, a handler (unlike SIG_IGN) is not inherited by the decompressors
+    signal(SIGPIPE, ignore_signal);
+
+    fan_out_traces(gunzip_command, pipe_fd);
+
+    int failed = 0;
+    for (uint32_t v=0; v<num_variants; v++) {
+        int status;
+        waitpid(pid[v], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            cout << "Variant " << v << ": " << variant_config[v] << " failed" << endl;
+            failed = 1;
+        }
+        else
+            cout << "Variant " << v << ": " << variant_config[v] << " completed" << endl;
+    }
+
+    exit(failed);
+}
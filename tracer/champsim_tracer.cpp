@@ -10,6 +10,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <deque>
+#include <map>
+#include <vector>
+
+// build with COMPRESS=xz or COMPRESS=zstd (see makefile.rules) to compress the trace in the tool,
+// the output file then gets the .xz or .zst extension ChampSim expects
+#if defined(TRACE_XZ)
+#include <lzma.h>
+#define TRACE_EXTENSION ".xz"
+#elif defined(TRACE_ZSTD)
+#include <zstd.h>
+#define TRACE_EXTENSION ".zst"
+#else
+#define TRACE_EXTENSION ""
+#endif
 
 #define NUM_INSTR_DESTINATIONS 2
 #define NUM_INSTR_SOURCES 4
@@ -27,18 +42,89 @@ typedef struct trace_instr_format {
     unsigned long long int source_memory[NUM_INSTR_SOURCES];           // input memory
 } trace_instr_format_t;
 
+#define BUFFER_RECORDS 65536 // records per buffer, every thread fills one while the writer drains the other
+#define OUTPUT_SIZE (1024*1024)
+
 /* ================================================================== */
 // Global variables 
 /* ================================================================== */
 
-UINT64 instrCount = 0;
+class THREAD_DATA;
+
+class OUTPUT_STREAM;
+
+// a full buffer on its way to the writer thread, last closes its stream
+class OUTPUT_BUFFER
+{
+  public:
+    THREAD_DATA *owner;
+    OUTPUT_STREAM *stream;
+    trace_instr_format_t *record;
+    UINT32 count;
+    bool last;
+};
+
+// one output file (the trace of a thread, or one slice of it), written by the writer thread only
+class OUTPUT_STREAM
+{
+  public:
+    FILE* out;
+    unsigned char *output;
+#if defined(TRACE_XZ)
+    lzma_stream xz;
+#elif defined(TRACE_ZSTD)
+    ZSTD_CStream *zstd;
+#endif
+
+    void Open(const string &fileName);
+    void Write(const void *data, size_t size);
+    void Close();
+};
+
+// everything the analysis routines touch is per thread, no locks on the instruction path
+class THREAD_DATA
+{
+  public:
+    THREADID tid;
+    UINT64 instrCount;
+    bool tracing_on;
+    trace_instr_format_t curr_instr;
+
+    trace_instr_format_t *buffer[2];
+    UINT32 current, count;
+    PIN_SEMAPHORE spare_free; // the writer is done with the other buffer
+
+    OUTPUT_STREAM *stream; // NULL once the trace or slice is handed to the writer for closing
+
+    // interval sampling, interval ends after instruction interval_end
+    UINT64 interval, interval_end;
+    std::vector<UINT64> slices; // intervals traced
+
+    // basic-block vector of the current interval
+    FILE *bbv_out;
+    std::vector<UINT64> bbv;
+    std::vector<UINT32> touched;
+
+    bool finished;
+};
+
+TLS_KEY tls_key;
+
+// writer thread queue
+std::deque<OUTPUT_BUFFER> write_queue;
+PIN_LOCK queue_lock;
+PIN_SEMAPHORE queue_ready;
+bool writer_stop = false, writer_stopped = false;
+PIN_THREAD_UID writer_uid;
 
-FILE* out;
+// every thread ever traced, their files are closed at exit
+std::deque<THREAD_DATA *> all_threads;
 
-bool output_file_closed = false;
-bool tracing_on = false;
+// SimPoint intervals of the main thread and their weights
+std::map<UINT64, double> simpoint_weight;
 
-trace_instr_format_t curr_instr;
+// basic block ids, assigned at instrumentation time
+std::map<ADDRINT, UINT32> block_id;
 
 /* ===================================================================== */
 // Command line switches
@@ -52,6 +138,24 @@ KNOB<UINT64> KnobSkipInstructions(KNOB_MODE_WRITEONCE, "pintool", "s", "0",
 KNOB<UINT64> KnobTraceInstructions(KNOB_MODE_WRITEONCE, "pintool", "t", "1000000", 
         "How many instructions to trace");
 
+KNOB<INT32> KnobCompressionLevel(KNOB_MODE_WRITEONCE, "pintool", "z", "3", 
+        "xz preset (0-9) or zstd level (1-19) when built with compression");
+
+KNOB<UINT64> KnobInterval(KNOB_MODE_WRITEONCE, "pintool", "interval", "0", 
+        "Instructions per interval, enables sampling in place of -s and -t");
+
+KNOB<UINT64> KnobPeriod(KNOB_MODE_WRITEONCE, "pintool", "period", "0", 
+        "Trace the first interval of every <period> intervals");
+
+KNOB<string> KnobSimpoints(KNOB_MODE_WRITEONCE, "pintool", "simpoints", "", 
+        "SimPoint .simpoints file, the intervals of the main thread to trace");
+
+KNOB<string> KnobWeights(KNOB_MODE_WRITEONCE, "pintool", "weights", "", 
+        "SimPoint .weights file that goes with -simpoints");
+
+KNOB<string> KnobBBVFile(KNOB_MODE_WRITEONCE, "pintool", "bbv", "", 
+        "Write the basic-block vector of every interval to this file");
+
 /* ===================================================================== */
 // Utilities
 /* ===================================================================== */
@@ -64,31 +168,316 @@ INT32 Usage()
     cerr << "This tool creates a register and memory access trace" << endl 
         << "Specify the output trace file with -o" << endl 
         << "Specify the number of instructions to skip before tracing with -s" << endl
-        << "Specify the number of instructions to trace with -t" << endl << endl;
+        << "Specify the number of instructions to trace with -t" << endl
+        << "Specify the compression level with -z" << endl
+        << "Specify the interval length with -interval, and the intervals to trace with -period or -simpoints and -weights" << endl
+        << "Specify the basic-block vector file with -bbv" << endl << endl;
 
     cerr << KNOB_BASE::StringKnobSummary() << endl;
 
     return -1;
 }
 
+/* ===================================================================== */
+// Output
+/* ===================================================================== */
+
+void OUTPUT_STREAM::Open(const string &fileName)
+{
+    out = fopen(fileName.c_str(), "ab");
+    if (!out) 
+    {
+        cout << "Couldn't open output trace file " << fileName << ". Exiting." << endl;
+        exit(1);
+    }
+
+    output = new unsigned char[OUTPUT_SIZE];
+#if defined(TRACE_XZ)
+    xz = LZMA_STREAM_INIT;
+    if(lzma_easy_encoder(&xz, KnobCompressionLevel.Value(), LZMA_CHECK_CRC64) != LZMA_OK)
+    {
+        cout << "Couldn't start the xz encoder. Exiting." << endl;
+        exit(1);
+    }
+#elif defined(TRACE_ZSTD)
+    zstd = ZSTD_createCStream();
+    ZSTD_initCStream(zstd, KnobCompressionLevel.Value());
+#endif
+}
+
+void OUTPUT_STREAM::Write(const void *data, size_t size)
+{
+#if defined(TRACE_XZ)
+    xz.next_in = (const uint8_t *)data;
+    xz.avail_in = size;
+    while(xz.avail_in)
+    {
+        xz.next_out = output;
+        xz.avail_out = OUTPUT_SIZE;
+        lzma_code(&xz, LZMA_RUN);
+        fwrite(output, 1, OUTPUT_SIZE - xz.avail_out, out);
+    }
+#elif defined(TRACE_ZSTD)
+    ZSTD_inBuffer input = {data, size, 0};
+    while(input.pos < input.size)
+    {
+        ZSTD_outBuffer compressed = {output, OUTPUT_SIZE, 0};
+        ZSTD_compressStream(zstd, &compressed, &input);
+        fwrite(output, 1, compressed.pos, out);
+    }
+#else
+    fwrite(data, 1, size, out);
+#endif
+}
+
+void OUTPUT_STREAM::Close()
+{
+#if defined(TRACE_XZ)
+    lzma_ret ret = LZMA_OK;
+    while(ret != LZMA_STREAM_END)
+    {
+        xz.next_out = output;
+        xz.avail_out = OUTPUT_SIZE;
+        ret = lzma_code(&xz, LZMA_FINISH);
+        fwrite(output, 1, OUTPUT_SIZE - xz.avail_out, out);
+    }
+    lzma_end(&xz);
+#elif defined(TRACE_ZSTD)
+    size_t remaining = 1;
+    while(remaining)
+    {
+        ZSTD_outBuffer compressed = {output, OUTPUT_SIZE, 0};
+        remaining = ZSTD_endStream(zstd, &compressed);
+        fwrite(output, 1, compressed.pos, out);
+    }
+    ZSTD_freeCStream(zstd);
+#endif
+    fclose(out);
+    delete[] output;
+}
+
+// thread 0 writes to the file given with -o, the others to -o.<thread id>
+string ThreadFileName(const string &fileName, THREADID tid)
+{
+    if(tid != 0)
+        return fileName + "." + decstr(tid);
+
+    return fileName;
+}
+
+string OutputFileName(THREADID tid)
+{
+    return ThreadFileName(KnobOutputFile.Value(), tid) + TRACE_EXTENSION;
+}
+
+// with sampling, interval <n> of a thread goes to <output file>.<n>
+string SliceFileName(THREADID tid, UINT64 interval)
+{
+    return ThreadFileName(KnobOutputFile.Value(), tid) + "." + decstr(interval) + TRACE_EXTENSION;
+}
+
+// writes a buffer and hands it back to its thread
+void WriteBuffer(const OUTPUT_BUFFER &full)
+{
+    full.stream->Write(full.record, full.count * sizeof(trace_instr_format_t));
+    if(full.last)
+    {
+        full.stream->Close();
+        delete full.stream;
+    }
+    PIN_SemaphoreSet(&full.owner->spare_free);
+}
+
+// once the writer thread is gone, called with the queue lock held
+void DrainQueue()
+{
+    while(!write_queue.empty())
+    {
+        WriteBuffer(write_queue.front());
+        write_queue.pop_front();
+    }
+}
+
+// hands the current buffer of a thread to the writer thread and continues in the other one
+void FlushBuffer(THREAD_DATA *t, bool last)
+{
+    if(t->stream == NULL)
+        return;
+
+    OUTPUT_BUFFER full;
+    full.owner = t;
+    full.stream = t->stream;
+    full.record = t->buffer[t->current];
+    full.count = t->count;
+    full.last = last;
+
+    // the writer thread stops at exit, whatever it left behind is written by the threads themselves
+    while(!PIN_SemaphoreTimedWait(&t->spare_free, 100))
+    {
+        PIN_GetLock(&queue_lock, t->tid + 1);
+        if(writer_stopped)
+            DrainQueue();
+        PIN_ReleaseLock(&queue_lock);
+    }
+    PIN_SemaphoreClear(&t->spare_free);
+
+    PIN_GetLock(&queue_lock, t->tid + 1);
+    if(writer_stopped)
+    {
+        DrainQueue();
+        WriteBuffer(full);
+    }
+    else
+    {
+        write_queue.push_back(full);
+        PIN_SemaphoreSet(&queue_ready);
+    }
+    PIN_ReleaseLock(&queue_lock);
+
+    t->current ^= 1;
+    t->count = 0;
+    if(last)
+        t->stream = NULL;
+}
+
+// compresses and writes the buffers of all threads in the order they were filled
+VOID WriterThread(VOID *arg)
+{
+    while(1)
+    {
+        PIN_SemaphoreWait(&queue_ready);
+
+        PIN_GetLock(&queue_lock, 0);
+        if(write_queue.empty())
+        {
+            PIN_SemaphoreClear(&queue_ready);
+            bool stop = writer_stop;
+            PIN_ReleaseLock(&queue_lock);
+            if(stop)
+                break;
+            continue;
+        }
+        OUTPUT_BUFFER full = write_queue.front();
+        write_queue.pop_front();
+        PIN_ReleaseLock(&queue_lock);
+
+        WriteBuffer(full);
+    }
+}
+
+/* ===================================================================== */
+// Interval sampling
+/* ===================================================================== */
+
+// SimPoint's .bb format, one line per interval, block ids start at 1
+void WriteBBV(THREAD_DATA *t)
+{
+    fprintf(t->bbv_out, "T");
+    for(size_t i=0; i<t->touched.size(); i++)
+    {
+        UINT32 id = t->touched[i];
+        fprintf(t->bbv_out, ":%u:%llu ", id + 1, (unsigned long long int)t->bbv[id]);
+        t->bbv[id] = 0;
+    }
+    fprintf(t->bbv_out, "\n");
+    t->touched.clear();
+}
+
+bool IntervalSelected(THREAD_DATA *t, UINT64 interval)
+{
+    if(!KnobSimpoints.Value().empty())
+        return (t->tid == 0) && simpoint_weight.count(interval);
+
+    return KnobPeriod.Value() && (interval % KnobPeriod.Value() == 0);
+}
+
+void StartInterval(THREAD_DATA *t)
+{
+    if(IntervalSelected(t, t->interval))
+    {
+        t->stream = new OUTPUT_STREAM;
+        t->stream->Open(SliceFileName(t->tid, t->interval));
+        t->slices.push_back(t->interval);
+        t->tracing_on = true;
+    }
+    // the last simulation point is traced and no vectors are wanted, the rest of the run is of no use
+    else if((t->tid == 0) && !simpoint_weight.empty() && KnobBBVFile.Value().empty() && (t->interval > simpoint_weight.rbegin()->first))
+        PIN_ExitApplication(0);
+}
+
+void NextInterval(THREAD_DATA *t)
+{
+    if(t->tracing_on)
+    {
+        FlushBuffer(t, true);
+        t->tracing_on = false;
+    }
+    if(t->bbv_out)
+        WriteBBV(t);
+
+    t->interval++;
+    t->interval_end += KnobInterval.Value();
+    StartInterval(t);
+}
+
+// slices traced by a thread and their weights, next to its trace files
+void WriteWeights(THREAD_DATA *t)
+{
+    if(t->slices.empty())
+        return;
+
+    string fileName = ThreadFileName(KnobOutputFile.Value(), t->tid) + ".weights";
+    FILE *weights = fopen(fileName.c_str(), "w");
+    if(!weights)
+    {
+        cout << "Couldn't open weights file " << fileName << "." << endl;
+        return;
+    }
+    for(size_t i=0; i<t->slices.size(); i++)
+    {
+        double weight = simpoint_weight.empty() ? 1.0 / t->slices.size() : simpoint_weight[t->slices[i]];
+        fprintf(weights, "%s %f\n", SliceFileName(t->tid, t->slices[i]).c_str(), weight);
+    }
+    fclose(weights);
+}
+
 /* ===================================================================== */
 // Analysis routines
 /* ===================================================================== */
 
-void BeginInstruction(VOID *ip, UINT32 op_code, VOID *opstring)
+void BeginInstruction(VOID *ip, UINT32 op_code, THREADID tid)
 {
-    instrCount++;
+    THREAD_DATA *t = static_cast<THREAD_DATA *>(PIN_GetThreadData(tls_key, tid));
+    trace_instr_format_t &curr_instr = t->curr_instr;
+
+    t->instrCount++;
     //printf("[%p %u %s ", ip, opcode, (char*)opstring);
 
-    if(instrCount > KnobSkipInstructions.Value()) 
+    if(KnobInterval.Value())
     {
-        tracing_on = true;
+        if(t->instrCount > t->interval_end)
+            NextInterval(t);
+    }
+    else if(t->instrCount > KnobSkipInstructions.Value()) 
+    {
+        t->tracing_on = true;
 
-        if(instrCount > (KnobTraceInstructions.Value()+KnobSkipInstructions.Value()))
-            tracing_on = false;
+        if(t->instrCount > (KnobTraceInstructions.Value()+KnobSkipInstructions.Value()))
+        {
+            t->tracing_on = false;
+            if(t->stream)
+            {
+                // close down the file, we're done tracing this thread
+                FlushBuffer(t, true);
+
+                // the trace of the main thread is the one asked for
+                if(tid == 0)
+                    PIN_ExitApplication(0);
+            }
+        }
     }
 
-    if(!tracing_on) 
+    if(!t->tracing_on) 
         return;
 
     // reset the current instruction
@@ -110,38 +499,37 @@ void BeginInstruction(VOID *ip, UINT32 op_code, VOID *opstring)
     }
 }
 
-void EndInstruction()
+void EndInstruction(THREADID tid)
 {
+    THREAD_DATA *t = static_cast<THREAD_DATA *>(PIN_GetThreadData(tls_key, tid));
+
     //printf("%d]\n", (int)instrCount);
 
     //printf("\n");
 
-    if(instrCount > KnobSkipInstructions.Value())
+    if(t->tracing_on)
     {
-        tracing_on = true;
+        t->buffer[t->current][t->count++] = t->curr_instr;
+        if(t->count == BUFFER_RECORDS)
+            FlushBuffer(t, false);
+    }
+}
 
-        if(instrCount <= (KnobTraceInstructions.Value()+KnobSkipInstructions.Value()))
-        {
-            // keep tracing
-            fwrite(&curr_instr, sizeof(trace_instr_format_t), 1, out);
-        }
-        else
-        {
-            tracing_on = false;
-            // close down the file, we're done tracing
-            if(!output_file_closed)
-            {
-                fclose(out);
-                output_file_closed = true;
-            }
+void CountBlock(UINT32 id, UINT32 instructions, THREADID tid)
+{
+    THREAD_DATA *t = static_cast<THREAD_DATA *>(PIN_GetThreadData(tls_key, tid));
 
-            exit(0);
-        }
-    }
+    if(id >= t->bbv.size())
+        t->bbv.resize(id + 1, 0);
+    if(t->bbv[id] == 0)
+        t->touched.push_back(id);
+    t->bbv[id] += instructions;
 }
 
-void BranchOrNot(UINT32 taken)
+void BranchOrNot(UINT32 taken, THREADID tid)
 {
+    trace_instr_format_t &curr_instr = static_cast<THREAD_DATA *>(PIN_GetThreadData(tls_key, tid))->curr_instr;
+
     //printf("[%d] ", taken);
 
     curr_instr.is_branch = 1;
@@ -151,9 +539,12 @@ void BranchOrNot(UINT32 taken)
     }
 }
 
-void RegRead(UINT32 i, UINT32 index)
+void RegRead(UINT32 i, UINT32 index, THREADID tid)
 {
-    if(!tracing_on) return;
+    THREAD_DATA *t = static_cast<THREAD_DATA *>(PIN_GetThreadData(tls_key, tid));
+    trace_instr_format_t &curr_instr = t->curr_instr;
+
+    if(!t->tracing_on) return;
 
     REG r = (REG)i;
 
@@ -193,9 +584,12 @@ void RegRead(UINT32 i, UINT32 index)
     }
 }
 
-void RegWrite(REG i, UINT32 index)
+void RegWrite(REG i, UINT32 index, THREADID tid)
 {
-    if(!tracing_on) return;
+    THREAD_DATA *t = static_cast<THREAD_DATA *>(PIN_GetThreadData(tls_key, tid));
+    trace_instr_format_t &curr_instr = t->curr_instr;
+
+    if(!t->tracing_on) return;
 
     REG r = (REG)i;
 
@@ -240,9 +634,12 @@ void RegWrite(REG i, UINT32 index)
        */
 }
 
-void MemoryRead(VOID* addr, UINT32 index, UINT32 read_size)
+void MemoryRead(VOID* addr, UINT32 index, UINT32 read_size, THREADID tid)
 {
-    if(!tracing_on) return;
+    THREAD_DATA *t = static_cast<THREAD_DATA *>(PIN_GetThreadData(tls_key, tid));
+    trace_instr_format_t &curr_instr = t->curr_instr;
+
+    if(!t->tracing_on) return;
 
     //printf("0x%llx,%u ", (unsigned long long int)addr, read_size);
 
@@ -269,9 +666,12 @@ void MemoryRead(VOID* addr, UINT32 index, UINT32 read_size)
     }
 }
 
-void MemoryWrite(VOID* addr, UINT32 index)
+void MemoryWrite(VOID* addr, UINT32 index, THREADID tid)
 {
-    if(!tracing_on) return;
+    THREAD_DATA *t = static_cast<THREAD_DATA *>(PIN_GetThreadData(tls_key, tid));
+    trace_instr_format_t &curr_instr = t->curr_instr;
+
+    if(!t->tracing_on) return;
 
     //printf("(0x%llx) ", (unsigned long long int) addr);
 
@@ -313,11 +713,11 @@ VOID Instruction(INS ins, VOID *v)
 {
     // begin each instruction with this function
     UINT32 opcode = INS_Opcode(ins);
-    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)BeginInstruction, IARG_INST_PTR, IARG_UINT32, opcode, IARG_END);
+    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)BeginInstruction, IARG_INST_PTR, IARG_UINT32, opcode, IARG_THREAD_ID, IARG_END);
 
     // instrument branch instructions
     if(INS_IsBranch(ins))
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)BranchOrNot, IARG_BRANCH_TAKEN, IARG_END);
+        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)BranchOrNot, IARG_BRANCH_TAKEN, IARG_THREAD_ID, IARG_END);
 
     // instrument register reads
     UINT32 readRegCount = INS_MaxNumRRegs(ins);
@@ -326,7 +726,7 @@ VOID Instruction(INS ins, VOID *v)
         UINT32 regNum = INS_RegR(ins, i);
 
         INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)RegRead,
-                IARG_UINT32, regNum, IARG_UINT32, i,
+                IARG_UINT32, regNum, IARG_UINT32, i, IARG_THREAD_ID,
                 IARG_END);
     }
 
@@ -337,7 +737,7 @@ VOID Instruction(INS ins, VOID *v)
         UINT32 regNum = INS_RegW(ins, i);
 
         INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)RegWrite,
-                IARG_UINT32, regNum, IARG_UINT32, i,
+                IARG_UINT32, regNum, IARG_UINT32, i, IARG_THREAD_ID,
                 IARG_END);
     }
 
@@ -352,19 +752,120 @@ VOID Instruction(INS ins, VOID *v)
             UINT32 read_size = INS_MemoryReadSize(ins);
 
             INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)MemoryRead,
-                    IARG_MEMORYOP_EA, memOp, IARG_UINT32, memOp, IARG_UINT32, read_size,
+                    IARG_MEMORYOP_EA, memOp, IARG_UINT32, memOp, IARG_UINT32, read_size, IARG_THREAD_ID,
                     IARG_END);
         }
         if (INS_MemoryOperandIsWritten(ins, memOp)) 
         {
             INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)MemoryWrite,
-                    IARG_MEMORYOP_EA, memOp, IARG_UINT32, memOp,
+                    IARG_MEMORYOP_EA, memOp, IARG_UINT32, memOp, IARG_THREAD_ID,
                     IARG_END);
         }
     }
 
     // finalize each instruction with this function
-    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)EndInstruction, IARG_END);
+    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)EndInstruction, IARG_THREAD_ID, IARG_END);
+}
+
+// Is called for every application thread before it runs its first instruction
+VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    THREAD_DATA *t = new THREAD_DATA;
+    t->tid = tid;
+    t->instrCount = 0;
+    t->tracing_on = false;
+    t->finished = false;
+    memset(&t->curr_instr, 0, sizeof(t->curr_instr));
+
+    t->buffer[0] = new trace_instr_format_t[BUFFER_RECORDS];
+    t->buffer[1] = new trace_instr_format_t[BUFFER_RECORDS];
+    t->current = 0;
+    t->count = 0;
+    PIN_SemaphoreInit(&t->spare_free);
+    PIN_SemaphoreSet(&t->spare_free);
+
+    t->stream = NULL;
+    t->bbv_out = NULL;
+    if(!KnobBBVFile.Value().empty())
+    {
+        string fileName = ThreadFileName(KnobBBVFile.Value(), tid);
+        t->bbv_out = fopen(fileName.c_str(), "w");
+        if(!t->bbv_out)
+        {
+            cout << "Couldn't open basic-block vector file " << fileName << ". Exiting." << endl;
+            exit(1);
+        }
+    }
+
+    if(KnobInterval.Value())
+    {
+        t->interval = 0;
+        t->interval_end = KnobInterval.Value();
+        StartInterval(t);
+    }
+    else
+    {
+        t->stream = new OUTPUT_STREAM;
+        t->stream->Open(OutputFileName(tid));
+    }
+
+    PIN_GetLock(&queue_lock, tid + 1);
+    all_threads.push_back(t);
+    PIN_ReleaseLock(&queue_lock);
+
+    PIN_SetThreadData(tls_key, t, tid);
+}
+
+// the partial interval at the end of a thread is written too, as SimPoint expects
+void FinishThread(THREAD_DATA *t)
+{
+    if(t->finished)
+        return;
+
+    FlushBuffer(t, true);
+    t->tracing_on = false;
+    if(t->bbv_out)
+    {
+        if(!t->touched.empty())
+            WriteBBV(t);
+        fclose(t->bbv_out);
+        t->bbv_out = NULL;
+    }
+    WriteWeights(t);
+    t->finished = true;
+}
+
+VOID ThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v)
+{
+    FinishThread(static_cast<THREAD_DATA *>(PIN_GetThreadData(tls_key, tid)));
+}
+
+// internal threads have to be gone before Fini, the writer drains the queue first
+VOID PrepareForFini(VOID *v)
+{
+    PIN_GetLock(&queue_lock, 0);
+    writer_stop = true;
+    PIN_SemaphoreSet(&queue_ready);
+    PIN_ReleaseLock(&queue_lock);
+
+    PIN_WaitForThreadTermination(writer_uid, PIN_INFINITE_TIMEOUT, NULL);
+
+    PIN_GetLock(&queue_lock, 0);
+    writer_stopped = true;
+    PIN_ReleaseLock(&queue_lock);
+}
+
+// Is called for every trace when basic-block vectors are written
+VOID Trace(TRACE trace, VOID *v)
+{
+    for(BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
+    {
+        std::map<ADDRINT, UINT32>::iterator block = block_id.insert(std::make_pair(BBL_Address(bbl), (UINT32)block_id.size())).first;
+
+        BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)CountBlock,
+                IARG_UINT32, block->second, IARG_UINT32, BBL_NumIns(bbl), IARG_THREAD_ID,
+                IARG_END);
+    }
 }
 
 /*!
@@ -376,12 +877,13 @@ VOID Instruction(INS ins, VOID *v)
  */
 VOID Fini(INT32 code, VOID *v)
 {
-    // close the file if it hasn't already been closed
-    if(!output_file_closed) 
-    {
-        fclose(out);
-        output_file_closed = true;
-    }
+    // close the files that haven't already been closed, the writer thread is gone by now
+    for(size_t i=0; i<all_threads.size(); i++)
+        FinishThread(all_threads[i]);
+
+    PIN_GetLock(&queue_lock, 0);
+    DrainQueue();
+    PIN_ReleaseLock(&queue_lock);
 }
 
 /*!
@@ -398,19 +900,55 @@ int main(int argc, char *argv[])
     if( PIN_Init(argc,argv) )
         return Usage();
 
-    const char* fileName = KnobOutputFile.Value().c_str();
+    // SimPoint writes "<interval> <cluster>" and "<weight> <cluster>" lines
+    if(!KnobSimpoints.Value().empty())
+    {
+        std::ifstream simpoints(KnobSimpoints.Value().c_str()), weights(KnobWeights.Value().c_str());
+        if(!KnobInterval.Value() || !simpoints.good() || !weights.good())
+        {
+            cout << "-simpoints needs -interval and a readable -weights file. Exiting." << endl;
+            exit(1);
+        }
 
-    out = fopen(fileName, "ab");
-    if (!out) 
+        std::map<UINT64, UINT64> cluster_interval;
+        UINT64 interval, cluster;
+        double weight;
+        while(simpoints >> interval >> cluster)
+            cluster_interval[cluster] = interval;
+        while(weights >> weight >> cluster)
+        {
+            if(cluster_interval.count(cluster))
+                simpoint_weight[cluster_interval[cluster]] = weight;
+        }
+        if(simpoint_weight.empty())
+        {
+            cout << "No simulation points in " << KnobSimpoints.Value() << ". Exiting." << endl;
+            exit(1);
+        }
+    }
+
+    tls_key = PIN_CreateThreadDataKey(NULL);
+    PIN_InitLock(&queue_lock);
+    PIN_SemaphoreInit(&queue_ready);
+
+    // compression and file writes run here, off the instruction path
+    if(PIN_SpawnInternalThread(WriterThread, NULL, 0, &writer_uid) == INVALID_THREADID)
     {
-        cout << "Couldn't open output trace file. Exiting." << endl;
+        cout << "Couldn't start the trace writer thread. Exiting." << endl;
         exit(1);
     }
 
     // Register function to be called to instrument instructions
     INS_AddInstrumentFunction(Instruction, 0);
+    if(!KnobBBVFile.Value().empty())
+        TRACE_AddInstrumentFunction(Trace, 0);
+
+    // every thread is traced into a file of its own
+    PIN_AddThreadStartFunction(ThreadStart, 0);
+    PIN_AddThreadFiniFunction(ThreadFini, 0);
 
     // Register function to be called when the application exits
+    PIN_AddPrepareForFiniFunction(PrepareForFini, 0);
     PIN_AddFiniFunction(Fini, 0);
 
     //cerr <<  "===============================================" << endl;